@@ -317,6 +317,21 @@ bool AtomicExpand::runOnFunction(Function &F) {
       }
     }
   }
+
+  // Operations smaller than the minimum cmpxchg size were expanded to a
+  // cmpxchg on the containing word, which isn't in the list gathered above.
+  // If the target expands cmpxchg to LL/SC, do that to these now.
+  if (TLI->getMinCmpXchgSizeInBits() > 8) {
+    SmallVector<AtomicCmpXchgInst *, 1> WordCASInsts;
+    for (Instruction &I : instructions(F))
+      if (auto *CASI = dyn_cast<AtomicCmpXchgInst>(&I))
+        if (TLI->shouldExpandAtomicCmpXchgInIR(CASI))
+          WordCASInsts.push_back(CASI);
+
+    for (auto *CASI : WordCASInsts)
+      MadeChange |= expandAtomicCmpXchg(CASI);
+  }
+
   return MadeChange;
 }
 
@@ -22,6 +22,7 @@ class FunctionPass;
 class NyuziTargetMachine;
 
 FunctionPass *createNyuziISelDag(NyuziTargetMachine &TM);
+FunctionPass *createNyuziEarlyIfConversionPass();
 
 } // end namespace llvm;
 
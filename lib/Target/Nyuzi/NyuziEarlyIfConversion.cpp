@@ -0,0 +1,474 @@
+//===-- NyuziEarlyIfConversion.cpp - Predicate small vector branches ------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Nyuzi can execute almost every vector instruction under a lane mask, but
+// instruction selection only uses the masked forms for explicit vector_mix
+// operations. This pass removes small triangles and diamonds whose
+// conditional blocks only compute vector values:
+//
+//   Head:  bnz %cond, TBB        Head:  <FBB instructions>
+//   FBB:   ...                         <TBB instructions, predicated>
+//   TBB:   ...               =>  Tail:  ...
+//   Tail:  %r = phi ...
+//
+// The conditional blocks are speculatively executed in Head. Each value
+// that reaches a PHI in Tail is merged by converting the instruction that
+// defines it to its masked form, with the value from the other path as the
+// previous contents of the destination. When that isn't possible, a masked
+// move merges the two values instead. The branch condition is a scalar, so
+// the mask is all ones or all zeroes; it is computed with a vector compare
+// against the splatted condition.
+//
+// Inner branches are converted before the branches that enclose them, so
+// a nested if whose inner branch is removed can be converted as well.
+//
+//===----------------------------------------------------------------------===//
+
+#include "MCTargetDesc/NyuziMCTargetDesc.h"
+#include "Nyuzi.h"
+#include "NyuziInstrInfo.h"
+#include "NyuziSubtarget.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/CodeGen/MachineDominators.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineLoopInfo.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/TargetSchedule.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "nyuzi-early-ifcvt"
+
+static cl::opt<unsigned> ExtraCycleLimit(
+    "nyuzi-ifcvt-limit", cl::Hidden, cl::init(0),
+    cl::desc("Maximum extra cycles to spend executing both sides of a "
+             "vector branch (0 = derive from the machine model)"));
+
+STATISTIC(NumConverted, "Number of vector branches if-converted");
+STATISTIC(NumPredicated, "Number of instructions converted to masked forms");
+
+namespace {
+
+class NyuziEarlyIfConversion : public MachineFunctionPass {
+public:
+  static char ID;
+
+  NyuziEarlyIfConversion() : MachineFunctionPass(ID) {}
+
+  bool runOnMachineFunction(MachineFunction &MF) override;
+  void getAnalysisUsage(AnalysisUsage &AU) const override;
+
+  StringRef getPassName() const override {
+    return "Nyuzi early if-conversion";
+  }
+
+private:
+  // How a PHI in the tail block is resolved once the branch is removed.
+  enum MergeKind {
+    MergeSame,      // Both paths provide the same value.
+    MergeTrueDef,   // Predicate the true path's definition.
+    MergeFalseDef,  // Predicate the false path's definition.
+    MergeMove       // Insert a masked move.
+  };
+
+  struct PhiMerge {
+    MachineInstr *Phi;
+    unsigned TrueReg;
+    unsigned FalseReg;
+    MergeKind Kind;
+  };
+
+  bool tryConvert(MachineBasicBlock *Head);
+  bool canSpeculate(const MachineBasicBlock *MBB,
+                    const MachineBasicBlock *Tail) const;
+  bool canPredicate(unsigned Reg, const MachineBasicBlock *Arm) const;
+  unsigned estimateCycles(ArrayRef<MachineBasicBlock *> Blocks) const;
+  void predicate(MachineInstr &MI, unsigned Mask, unsigned OldValue);
+  void removeBlocks(MachineBasicBlock *Head, ArrayRef<MachineBasicBlock *> Arms,
+                    MachineBasicBlock *Tail);
+
+  const NyuziInstrInfo *TII;
+  MachineRegisterInfo *MRI;
+  MachineDominatorTree *DomTree;
+  MachineLoopInfo *Loops;
+  TargetSchedModel SchedModel;
+};
+
+} // end anonymous namespace
+
+char NyuziEarlyIfConversion::ID = 0;
+
+void NyuziEarlyIfConversion::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<MachineDominatorTree>();
+  AU.addPreserved<MachineDominatorTree>();
+  AU.addRequired<MachineLoopInfo>();
+  AU.addPreserved<MachineLoopInfo>();
+  MachineFunctionPass::getAnalysisUsage(AU);
+}
+
+// A conditional block can be speculated if it has no side effects, only
+// defines virtual registers, and ends with at most a branch to the tail.
+bool NyuziEarlyIfConversion::canSpeculate(
+    const MachineBasicBlock *MBB, const MachineBasicBlock *Tail) const {
+  if (MBB->pred_size() != 1 || MBB->succ_size() != 1 ||
+      *MBB->succ_begin() != Tail || MBB->hasAddressTaken() || MBB->isEHPad())
+    return false;
+
+  for (const MachineInstr &MI : *MBB) {
+    if (MI.isDebugValue())
+      continue;
+
+    if (MI.isTerminator()) {
+      if (!MI.isUnconditionalBranch())
+        return false;
+
+      continue;
+    }
+
+    if (MI.isPHI() || MI.mayLoadOrStore() || MI.isCall() ||
+        MI.hasUnmodeledSideEffects() || MI.isInlineAsm())
+      return false;
+
+    for (const MachineOperand &MO : MI.operands()) {
+      if (MO.isReg() && MO.isDef() &&
+          !TargetRegisterInfo::isVirtualRegister(MO.getReg()))
+        return false;
+    }
+  }
+
+  return true;
+}
+
+// Return true if the instruction that defines Reg in Arm can be converted to
+// a masked form that merges with another value.
+bool NyuziEarlyIfConversion::canPredicate(unsigned Reg,
+                                          const MachineBasicBlock *Arm) const {
+  const MachineInstr *Def = MRI->getVRegDef(Reg);
+  if (!Def || Def->getParent() != Arm || !MRI->hasOneNonDBGUse(Reg) ||
+      Def->getDesc().getNumDefs() != 1)
+    return false;
+
+  if (Nyuzi::getMaskedOpcode(Def->getOpcode()) == -1)
+    return false;
+
+  // The masked immediate forms have a narrower immediate field.
+  for (const MachineOperand &MO : Def->explicit_uses()) {
+    if (MO.isImm() && !isInt<8>(MO.getImm()))
+      return false;
+  }
+
+  return true;
+}
+
+// Estimate the number of cycles to run the given blocks back to back on the
+// in-order pipeline: each instruction issues one cycle after the previous
+// one, or when the operands it depends on are ready, whichever is later.
+unsigned NyuziEarlyIfConversion::estimateCycles(
+    ArrayRef<MachineBasicBlock *> Blocks) const {
+  DenseMap<unsigned, unsigned> ReadyCycle;
+  unsigned IssueCycle = 0;
+  unsigned DoneCycle = 0;
+  for (const MachineBasicBlock *MBB : Blocks) {
+    for (const MachineInstr &MI : *MBB) {
+      if (MI.isDebugValue() || MI.isTerminator())
+        continue;
+
+      unsigned Cycle = IssueCycle;
+      for (const MachineOperand &MO : MI.uses()) {
+        if (MO.isReg() && ReadyCycle.count(MO.getReg()))
+          Cycle = std::max(Cycle, ReadyCycle[MO.getReg()]);
+      }
+
+      unsigned Ready = Cycle + SchedModel.computeInstrLatency(&MI);
+      for (const MachineOperand &MO : MI.defs())
+        ReadyCycle[MO.getReg()] = Ready;
+
+      DoneCycle = std::max(DoneCycle, Ready);
+      IssueCycle = Cycle + 1;
+    }
+  }
+
+  return DoneCycle;
+}
+
+// Replace MI, which defines a vector register, with its masked form. Lanes
+// that are not enabled in Mask get OldValue.
+void NyuziEarlyIfConversion::predicate(MachineInstr &MI, unsigned Mask,
+                                       unsigned OldValue) {
+  MachineBasicBlock &MBB = *MI.getParent();
+  MachineInstrBuilder MIB =
+      BuildMI(MBB, MI, MI.getDebugLoc(),
+              TII->get(Nyuzi::getMaskedOpcode(MI.getOpcode())),
+              MI.getOperand(0).getReg())
+          .addReg(Mask);
+  for (const MachineOperand &MO : MI.explicit_uses())
+    MIB.add(MO);
+
+  MIB.addReg(OldValue);
+  MI.eraseFromParent();
+  ++NumPredicated;
+}
+
+// Remove the now empty conditional blocks. If the tail has no other
+// predecessors and follows the head in the layout, join the two. Keep the
+// dominator tree and loop info up to date.
+void NyuziEarlyIfConversion::removeBlocks(MachineBasicBlock *Head,
+                                          ArrayRef<MachineBasicBlock *> Arms,
+                                          MachineBasicBlock *Tail) {
+  SmallVector<MachineBasicBlock *, 3> Removed;
+  for (MachineBasicBlock *Arm : Arms) {
+    Head->removeSuccessor(Arm);
+    Arm->removeSuccessor(Tail);
+    Removed.push_back(Arm);
+    Arm->eraseFromParent();
+  }
+
+  if (!Head->isSuccessor(Tail))
+    Head->addSuccessor(Tail);
+
+  if (Tail->pred_size() == 1 && Head->isLayoutSuccessor(Tail) &&
+      !Tail->hasAddressTaken() && !Tail->isEHPad()) {
+    // Each PHI has a single input now.
+    while (!Tail->empty() && Tail->front().isPHI()) {
+      MachineInstr &Phi = Tail->front();
+      BuildMI(*Head, Head->end(), Phi.getDebugLoc(),
+              TII->get(TargetOpcode::COPY), Phi.getOperand(0).getReg())
+          .addReg(Phi.getOperand(1).getReg());
+      Phi.eraseFromParent();
+    }
+
+    Head->removeSuccessor(Tail);
+    Head->splice(Head->end(), Tail, Tail->begin(), Tail->end());
+    Head->transferSuccessorsAndUpdatePHIs(Tail);
+    Removed.push_back(Tail);
+    Tail->eraseFromParent();
+  } else
+    TII->insertBranch(*Head, Tail, nullptr, None, DebugLoc(), nullptr);
+
+  MachineDomTreeNode *HeadNode = DomTree->getNode(Head);
+  for (MachineBasicBlock *MBB : Removed) {
+    MachineDomTreeNode *Node = DomTree->getNode(MBB);
+    while (Node->getNumChildren())
+      DomTree->changeImmediateDominator(Node->getChildren().back(), HeadNode);
+
+    DomTree->eraseNode(MBB);
+    Loops->removeBlock(MBB);
+  }
+}
+
+bool NyuziEarlyIfConversion::tryConvert(MachineBasicBlock *Head) {
+  MachineBasicBlock *TBB = nullptr;
+  MachineBasicBlock *FBB = nullptr;
+  SmallVector<MachineOperand, 4> Cond;
+  if (Head->succ_size() != 2 || TII->analyzeBranch(*Head, TBB, FBB, Cond) ||
+      Cond.empty())
+    return false;
+
+  // A conditional branch without an unconditional branch falls through to
+  // the other successor.
+  if (!FBB)
+    FBB = *Head->succ_begin() == TBB ? *std::next(Head->succ_begin())
+                                     : *Head->succ_begin();
+
+  if (TBB == FBB)
+    return false;
+
+  // Identify the shape. In a triangle, one side branches directly to the
+  // tail.
+  MachineBasicBlock *Tail;
+  MachineBasicBlock *TrueArm = nullptr;
+  MachineBasicBlock *FalseArm = nullptr;
+  if (TBB->succ_size() == 1 && *TBB->succ_begin() == FBB) {
+    Tail = FBB;
+    TrueArm = TBB;
+  } else if (FBB->succ_size() == 1 && *FBB->succ_begin() == TBB) {
+    Tail = TBB;
+    FalseArm = FBB;
+  } else if (TBB->succ_size() == 1 && FBB->succ_size() == 1 &&
+             *TBB->succ_begin() == *FBB->succ_begin()) {
+    Tail = *TBB->succ_begin();
+    TrueArm = TBB;
+    FalseArm = FBB;
+  } else
+    return false;
+
+  if (Tail == Head || (TrueArm && !canSpeculate(TrueArm, Tail)) ||
+      (FalseArm && !canSpeculate(FalseArm, Tail)))
+    return false;
+
+  // The false side is spliced first, so predicated instructions on the true
+  // side can use values from either side.
+  SmallVector<MachineBasicBlock *, 2> Arms;
+  if (FalseArm)
+    Arms.push_back(FalseArm);
+  if (TrueArm)
+    Arms.push_back(TrueArm);
+
+  MachineBasicBlock *TruePred = TrueArm ? TrueArm : Head;
+  MachineBasicBlock *FalsePred = FalseArm ? FalseArm : Head;
+
+  // Only merge vector values. There is no scalar conditional move.
+  SmallVector<PhiMerge, 4> Merges;
+  bool NeedTrueMask = false;
+  bool NeedFalseMask = false;
+  unsigned NumMoves = 0;
+  for (MachineInstr &Phi : *Tail) {
+    if (!Phi.isPHI())
+      break;
+
+    PhiMerge Merge = {&Phi, 0, 0, MergeSame};
+    for (unsigned I = 1, E = Phi.getNumOperands(); I != E; I += 2) {
+      MachineBasicBlock *Pred = Phi.getOperand(I + 1).getMBB();
+      if (Pred == TruePred)
+        Merge.TrueReg = Phi.getOperand(I).getReg();
+      else if (Pred == FalsePred)
+        Merge.FalseReg = Phi.getOperand(I).getReg();
+    }
+
+    if (Merge.TrueReg != Merge.FalseReg) {
+      if (MRI->getRegClass(Phi.getOperand(0).getReg()) !=
+          &Nyuzi::VR512RegClass)
+        return false;
+
+      const MachineInstr *TrueDef = MRI->getVRegDef(Merge.TrueReg);
+      if (TrueArm && canPredicate(Merge.TrueReg, TrueArm)) {
+        Merge.Kind = MergeTrueDef;
+        NeedTrueMask = true;
+      } else if (FalseArm && canPredicate(Merge.FalseReg, FalseArm) &&
+                 (!TrueArm || !TrueDef || TrueDef->getParent() != TrueArm)) {
+        Merge.Kind = MergeFalseDef;
+        NeedFalseMask = true;
+      } else {
+        Merge.Kind = MergeMove;
+        NeedTrueMask = true;
+        ++NumMoves;
+      }
+    }
+
+    Merges.push_back(Merge);
+  }
+
+  // Compare the cost of running both sides against the cost of the branch.
+  // The branch condition is often different in each lane, so assume the
+  // branch mispredicts as often as not.
+  unsigned BranchCycles = std::max(TrueArm ? estimateCycles(TrueArm) : 0,
+                                   FalseArm ? estimateCycles(FalseArm) : 0);
+  unsigned MergedCycles = estimateCycles(Arms) + 1 + NeedTrueMask +
+                          NeedFalseMask + NumMoves;
+  unsigned Limit = ExtraCycleLimit;
+  if (Limit == 0)
+    Limit = SchedModel.getMCSchedModel()->MispredictPenalty + Arms.size();
+
+  DEBUG(dbgs() << "If-convert BB#" << Head->getNumber() << ": "
+               << MergedCycles << " cycles vs " << BranchCycles
+               << " (limit +" << Limit << ")\n");
+  if (MergedCycles > BranchCycles + Limit)
+    return false;
+
+  // Compute the masks before the speculated instructions, which may use
+  // them. The condition register is nonzero when BNZ branches to TBB.
+  MachineBasicBlock::iterator InsertPt = Head->getFirstTerminator();
+  DebugLoc DL = InsertPt->getDebugLoc();
+  unsigned CondReg = Cond[1].getReg();
+  bool BranchIfNonZero = Cond[0].getImm() == Nyuzi::BNZ;
+  unsigned SplatReg = MRI->createVirtualRegister(&Nyuzi::VR512RegClass);
+  BuildMI(*Head, InsertPt, DL, TII->get(Nyuzi::MOVEVSI), SplatReg)
+      .addReg(CondReg);
+
+  auto BuildMask = [&](bool NonZero) {
+    unsigned Mask = MRI->createVirtualRegister(&Nyuzi::GPR32RegClass);
+    BuildMI(*Head, InsertPt, DL,
+            TII->get(NonZero ? Nyuzi::SNESIVI : Nyuzi::SEQSIVI), Mask)
+        .addReg(SplatReg)
+        .addImm(0);
+    return Mask;
+  };
+
+  unsigned TrueMask = NeedTrueMask ? BuildMask(BranchIfNonZero) : 0;
+  unsigned FalseMask = NeedFalseMask ? BuildMask(!BranchIfNonZero) : 0;
+
+  TII->removeBranch(*Head, nullptr);
+  for (MachineBasicBlock *Arm : Arms)
+    Head->splice(Head->end(), Arm, Arm->begin(), Arm->getFirstTerminator());
+
+  // Merge the values and rewrite the PHIs to take a single value from the
+  // head block.
+  for (PhiMerge &Merge : Merges) {
+    unsigned Result = Merge.TrueReg;
+    switch (Merge.Kind) {
+    case MergeSame:
+      break;
+
+    case MergeTrueDef:
+      predicate(*MRI->getVRegDef(Merge.TrueReg), TrueMask, Merge.FalseReg);
+      break;
+
+    case MergeFalseDef:
+      predicate(*MRI->getVRegDef(Merge.FalseReg), FalseMask, Merge.TrueReg);
+      Result = Merge.FalseReg;
+      break;
+
+    case MergeMove:
+      Result = MRI->createVirtualRegister(&Nyuzi::VR512RegClass);
+      BuildMI(*Head, Head->end(), DL, TII->get(Nyuzi::MOVEVVMI), Result)
+          .addReg(TrueMask)
+          .addReg(Merge.TrueReg)
+          .addReg(Merge.FalseReg);
+      break;
+    }
+
+    MachineInstr *Phi = Merge.Phi;
+    for (unsigned I = Phi->getNumOperands() - 1; I > 0; I -= 2) {
+      MachineBasicBlock *Pred = Phi->getOperand(I).getMBB();
+      if (Pred == Head || is_contained(Arms, Pred)) {
+        Phi->RemoveOperand(I);
+        Phi->RemoveOperand(I - 1);
+      }
+    }
+
+    Phi->addOperand(MachineOperand::CreateReg(Result, false));
+    Phi->addOperand(MachineOperand::CreateMBB(Head));
+  }
+
+  removeBlocks(Head, Arms, Tail);
+  ++NumConverted;
+  return true;
+}
+
+bool NyuziEarlyIfConversion::runOnMachineFunction(MachineFunction &MF) {
+  if (skipFunction(*MF.getFunction()))
+    return false;
+
+  const NyuziSubtarget &ST = MF.getSubtarget<NyuziSubtarget>();
+  TII = ST.getInstrInfo();
+  MRI = &MF.getRegInfo();
+  DomTree = &getAnalysis<MachineDominatorTree>();
+  Loops = &getAnalysis<MachineLoopInfo>();
+  SchedModel.init(ST.getSchedModel(), &ST, TII);
+
+  // Visit blocks in post order of the dominator tree, so inner branches are
+  // removed before the branches that enclose them. Only blocks dominated by
+  // the current one are erased, and these have already been visited.
+  bool Changed = false;
+  for (MachineDomTreeNode *Node : post_order(DomTree)) {
+    while (tryConvert(Node->getBlock()))
+      Changed = true;
+  }
+
+  return Changed;
+}
+
+FunctionPass *llvm::createNyuziEarlyIfConversionPass() {
+  return new NyuziEarlyIfConversion();
+}
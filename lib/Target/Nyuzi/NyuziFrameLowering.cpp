@@ -47,9 +47,9 @@ void NyuziFrameLowering::emitPrologue(MachineFunction &MF,
   // to determine the end of the prologue.
   DebugLoc DL;
 
-  // Compute stack size to allocate, keeping SP 64 byte aligned so we
-  // can do block vector load/stores
-  int StackSize = alignTo(MFI.getStackSize(), getStackAlignment());
+  // PEI has already rounded the frame size: to 64 bytes if this function
+  // makes calls, otherwise only to the alignment of its largest object.
+  int StackSize = MFI.getStackSize();
 
   // Bail if there is no stack allocation
   if (StackSize == 0 && !MFI.adjustsStack())
@@ -85,8 +85,7 @@ void NyuziFrameLowering::emitPrologue(MachineFunction &MF,
 
   // fp = sp
   if (hasFP(MF)) {
-    BuildMI(MBB, MBBI, DL, TII.get(Nyuzi::MOVESS))
-        .addReg(Nyuzi::FP_REG)
+    BuildMI(MBB, MBBI, DL, TII.get(Nyuzi::MOVESS), Nyuzi::FP_REG)
         .addReg(Nyuzi::SP_REG);
 
     // emit ".cfi_def_cfa_register $fp" (debug information)
@@ -114,12 +113,11 @@ void NyuziFrameLowering::emitEpilogue(MachineFunction &MF,
     for (unsigned i = 0; i < MFI.getCalleeSavedInfo().size(); ++i)
       --I;
 
-    BuildMI(MBB, I, DL, TII.get(Nyuzi::MOVESS))
-        .addReg(Nyuzi::SP_REG)
+    BuildMI(MBB, I, DL, TII.get(Nyuzi::MOVESS), Nyuzi::SP_REG)
         .addReg(Nyuzi::FP_REG);
   }
 
-  uint64_t StackSize = alignTo(MFI.getStackSize(), getStackAlignment());
+  uint64_t StackSize = MFI.getStackSize();
   if (!StackSize)
     return;
 
@@ -159,12 +157,18 @@ void NyuziFrameLowering::determineCalleeSaves(MachineFunction &MF,
   if (hasFP(MF))
     SavedRegs.set(Nyuzi::FP_REG);
 
+  // Calls overwrite the link register. The generic code usually saves it
+  // because it is callee saved, but it skips all callee saved registers for
+  // local functions when interprocedural register allocation is enabled.
+  if (MF.getFrameInfo().hasCalls())
+    SavedRegs.set(Nyuzi::RA_REG);
+
   // The register scavenger allows us to allocate virtual registers during
   // epilogue/prologue insertion, after register allocation has run. We only
   // need to do this if the frame is too large to be addressed by immediate
   // offsets. If it isn't, don't bother creating a stack slot for it.  Note
   // that we may in some cases create the scavenge slot when it isn't needed.
-  if (getWorstCaseStackSize(MF) < 0x2000)
+  if (getWorstCaseStackSize(MF) < (1u << (getMaxFrameOffsetBits(MF) - 1)))
     return;
 
   const TargetRegisterClass *RC = &Nyuzi::GPR32RegClass;
@@ -188,6 +192,51 @@ bool NyuziFrameLowering::hasReservedCallFrame(const MachineFunction &MF) const {
   return !MF.getFrameInfo().hasVarSizedObjects();
 }
 
+// Place the most strictly aligned objects (vector spill slots and locals)
+// next to each other at the top of the frame, so the padding needed to align
+// them is paid once rather than between each pair of scalar slots. The sort
+// is stable to keep the allocator's order within each alignment class.
+void NyuziFrameLowering::orderFrameObjects(
+    const MachineFunction &MF, SmallVectorImpl<int> &ObjectsToAllocate) const {
+  const MachineFrameInfo &MFI = MF.getFrameInfo();
+  std::stable_sort(ObjectsToAllocate.begin(), ObjectsToAllocate.end(),
+                   [&MFI](int A, int B) {
+                     return MFI.getObjectAlignment(A) >
+                            MFI.getObjectAlignment(B);
+                   });
+}
+
+// Allow scalar slots to be placed in the padding between the callee saved
+// registers and the vector area. There is no padding if nothing is saved,
+// and PEI would index out of range walking an empty callee saved range.
+bool NyuziFrameLowering::enableStackSlotScavenging(
+    const MachineFunction &MF) const {
+  return !MF.getFrameInfo().getCalleeSavedInfo().empty();
+}
+
+// Return the width of the narrowest offset field that will be used to
+// address a stack object. eliminateFrameIndex needs a scratch register for
+// any offset that doesn't fit.
+unsigned
+NyuziFrameLowering::getMaxFrameOffsetBits(const MachineFunction &MF) const {
+  const NyuziInstrInfo &TII =
+      *static_cast<const NyuziInstrInfo *>(MF.getSubtarget().getInstrInfo());
+  unsigned OffsetBits = 13;
+  for (const MachineBasicBlock &MBB : MF) {
+    for (const MachineInstr &MI : MBB) {
+      for (const MachineOperand &MO : MI.operands()) {
+        if (MO.isFI()) {
+          OffsetBits =
+              std::min(OffsetBits, TII.getMemoryOffsetBits(MI.getOpcode()));
+          break;
+        }
+      }
+    }
+  }
+
+  return OffsetBits;
+}
+
 uint64_t
 NyuziFrameLowering::getWorstCaseStackSize(const MachineFunction &MF) const {
   const MachineFrameInfo &MFI = MF.getFrameInfo();
@@ -19,8 +19,11 @@ class NyuziFrameLowering : public TargetFrameLowering {
 public:
   static const NyuziFrameLowering *create(const NyuziSubtarget &ST);
 
+  // The stack pointer is 64 byte aligned at call boundaries so vector
+  // arguments and locals can use block loads/stores. Leaf functions only
+  // need to keep it aligned to their largest stack object.
   explicit NyuziFrameLowering(const NyuziSubtarget &ST)
-      : TargetFrameLowering(TargetFrameLowering::StackGrowsDown, 64, 0, 64) {}
+      : TargetFrameLowering(TargetFrameLowering::StackGrowsDown, 64, 0, 4) {}
 
   void emitPrologue(MachineFunction &MF, MachineBasicBlock &MBB) const override;
   void emitEpilogue(MachineFunction &MF, MachineBasicBlock &MBB) const override;
@@ -31,9 +34,13 @@ public:
                             RegScavenger *RS) const override;
   bool hasFP(const MachineFunction &MF) const override;
   bool hasReservedCallFrame(const MachineFunction &MF) const override;
+  void orderFrameObjects(const MachineFunction &MF,
+                         SmallVectorImpl<int> &ObjectsToAllocate) const override;
+  bool enableStackSlotScavenging(const MachineFunction &MF) const override;
 
 private:
   uint64_t getWorstCaseStackSize(const MachineFunction &MF) const;
+  unsigned getMaxFrameOffsetBits(const MachineFunction &MF) const;
 };
 
 } // End llvm namespace
@@ -20,6 +20,7 @@
 #include "NyuziTargetMachine.h"
 #include "NyuziTargetObjectFile.h"
 #include "llvm/CodeGen/CallingConvLower.h"
+#include "llvm/CodeGen/MachineConstantPool.h"
 #include "llvm/CodeGen/MachineFrameInfo.h"
 #include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
@@ -29,8 +30,11 @@
 #include "llvm/CodeGen/TargetLoweringObjectFileImpl.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
 #include "llvm/IR/Intrinsics.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
@@ -39,8 +43,36 @@ using namespace llvm;
 
 #include "NyuziGenCallingConv.inc"
 
+namespace {
+enum VectorMathMode { VectorMathLibcall, VectorMathAccurate, VectorMathFast };
+}
+
+// There are no hardware instructions for these, and scalarizing a vector
+// operation into 16 library calls forces all live vector registers to be
+// spilled around them.
+static cl::opt<VectorMathMode> VectorMath(
+    "nyuzi-vector-math", cl::Hidden,
+    cl::desc("How to compute v16f32 sqrt, sin, cos, exp, log and floor"),
+    cl::init(VectorMathAccurate),
+    cl::values(clEnumValN(VectorMathLibcall, "libcall",
+                          "Call the scalar library function for each lane"),
+               clEnumValN(VectorMathAccurate, "accurate",
+                          "Inline code, within a few ulps of the library"),
+               clEnumValN(VectorMathFast, "fast",
+                          "Shorter inline code, with at least 8 bits of "
+                          "precision")));
+
 namespace {
 
+// Constants that take more instructions than this to build are loaded from
+// the constant pool instead.
+const unsigned kMaxImmediateCost = 3;
+
+// Bounds, in spin loop iterations, of the delay after a failed store_sync in
+// functions with the "nyuzi-atomic-backoff" attribute.
+const unsigned kMinAtomicBackoff = 16;
+const unsigned kMaxAtomicBackoff = 2048;
+
 // isSplatVector - Returns true if N is a BUILD_VECTOR node whose elements are
 // all the same.
 bool isSplatVector(SDNode *N) {
@@ -155,6 +187,790 @@ SDValue expandVectorComparison(SDValue Op, SelectionDAG &DAG) {
       TrueVal, FalseVal);
 }
 
+// Block vector loads and stores require the address to be aligned to the
+// size of the vector. Return a vector of lane addresses for a gather or
+// scatter that accesses the same memory one element at a time.
+SDValue getLaneAddresses(SDValue Ptr, const SDLoc &DL, SelectionDAG &DAG) {
+  SmallVector<SDValue, 16> Offsets;
+  for (int Lane = 0; Lane < 16; Lane++)
+    Offsets.push_back(DAG.getConstant(Lane * 4, DL, MVT::i32));
+
+  return DAG.getNode(ISD::ADD, DL, MVT::v16i32,
+                     DAG.getNode(NyuziISD::SPLAT, DL, MVT::v16i32, Ptr),
+                     DAG.getBuildVector(MVT::v16i32, DL, Offsets));
+}
+
+// Returns true if N is a SPLAT of the constant Value.
+bool isSplatOfConstant(SDValue N, uint64_t Value) {
+  if (N.getOpcode() != NyuziISD::SPLAT)
+    return false;
+
+  ConstantSDNode *C = dyn_cast<ConstantSDNode>(N.getOperand(0));
+  return C && C->getZExtValue() == (Value & 0xffffffff);
+}
+
+// The generic masked memory operations take a vector of booleans, but the
+// hardware takes a scalar bitmask with one bit per lane. Convert the former to
+// the latter.
+SDValue getScalarMask(SDValue VectorMask, const SDLoc &DL, SelectionDAG &DAG) {
+  // A vector comparison has already been expanded to a mix of all ones and
+  // zeroes based on a native compare mask (see expandVectorComparison). Use
+  // that mask directly.
+  if (VectorMask.getOpcode() == ISD::INTRINSIC_WO_CHAIN &&
+      VectorMask.getConstantOperandVal(0) == Intrinsic::nyuzi_vector_mixi &&
+      isSplatOfConstant(VectorMask.getOperand(2), 0xffffffff) &&
+      isSplatOfConstant(VectorMask.getOperand(3), 0))
+    return VectorMask.getOperand(1);
+
+  // The mask was promoted from i1, so only the low bit of each lane is
+  // defined.
+  SDValue LowBits =
+      DAG.getNode(ISD::AND, DL, MVT::v16i32, VectorMask,
+                  DAG.getNode(NyuziISD::SPLAT, DL, MVT::v16i32,
+                              DAG.getConstant(1, DL, MVT::i32)));
+  return DAG.getNode(ISD::INTRINSIC_WO_CHAIN, DL, MVT::i32,
+                     DAG.getConstant(Intrinsic::nyuzi_mask_cmpi_ne, DL,
+                                     MVT::i32),
+                     LowBits,
+                     DAG.getNode(NyuziISD::SPLAT, DL, MVT::v16i32,
+                                 DAG.getConstant(0, DL, MVT::i32)));
+}
+
+// Masked loads leave the inactive lanes undefined. If the operation has a
+// pass through value, mix that into the inactive lanes.
+SDValue mergePassThru(SDValue Value, SDValue PassThru, SDValue Mask,
+                      const SDLoc &DL, SelectionDAG &DAG) {
+  if (PassThru.isUndef())
+    return Value;
+
+  MVT VT = Value.getValueType().getSimpleVT();
+  Intrinsic::ID IntrinsicID = VT.isFloatingPoint()
+                                  ? Intrinsic::nyuzi_vector_mixf
+                                  : Intrinsic::nyuzi_vector_mixi;
+  return DAG.getNode(ISD::INTRINSIC_WO_CHAIN, DL, VT,
+                     DAG.getConstant(IntrinsicID, DL, MVT::i32), Mask, Value,
+                     PassThru);
+}
+
+// Compute the lane addresses for a generic masked gather or scatter. If the
+// base is zero, the index vector contains the addresses. Otherwise the index
+// is in elements from the base pointer. The node doesn't record the GEP
+// scale, but the GEP has a single index, so the element it steps over is the
+// element being accessed.
+SDValue getGatherScatterAddresses(MaskedGatherScatterSDNode *N,
+                                  const SDLoc &DL, SelectionDAG &DAG) {
+  SDValue Index = N->getIndex();
+  if (isNullConstant(N->getBasePtr()))
+    return Index;
+
+  assert(Index.getValueType() == MVT::v16i32 &&
+         "gather/scatter index should have been normalized");
+  unsigned ElementBytes = N->getMemoryVT().getScalarSizeInBits() / 8;
+  SDValue Offsets =
+      DAG.getNode(ISD::SHL, DL, MVT::v16i32, Index,
+                  DAG.getNode(NyuziISD::SPLAT, DL, MVT::v16i32,
+                              DAG.getConstant(Log2_32(ElementBytes), DL,
+                                              MVT::i32)));
+  return DAG.getNode(
+      ISD::ADD, DL, MVT::v16i32,
+      DAG.getNode(NyuziISD::SPLAT, DL, MVT::v16i32, N->getBasePtr()), Offsets);
+}
+
+// A GEP with i64 (or narrow, sign extended) indices produces an index vector
+// that isn't 32 bits per lane. The type legalizer would split the index
+// without splitting the data, so convert it to the native width first.
+// Addresses are 32 bits, so truncating doesn't change them.
+SDValue normalizeGatherScatterIndex(MaskedGatherScatterSDNode *N,
+                                    TargetLowering::DAGCombinerInfo &DCI) {
+  SDValue Index = N->getIndex();
+  EVT IndexVT = Index.getValueType();
+  MVT VT = N->getValue().getSimpleValueType();
+  if ((VT != MVT::v16i32 && VT != MVT::v16f32) || IndexVT == MVT::v16i32)
+    return SDValue();
+
+  SelectionDAG &DAG = DCI.DAG;
+  unsigned ExtOpcode = IndexVT.getScalarSizeInBits() > 32 ? ISD::TRUNCATE
+                                                          : ISD::SIGN_EXTEND;
+  SmallVector<SDValue, 5> Ops(N->op_begin(), N->op_end());
+  Ops[4] = DAG.getNode(ExtOpcode, SDLoc(N), MVT::v16i32, Index);
+  return SDValue(DAG.UpdateNodeOperands(N, Ops), 0);
+}
+
+// Get the operands of a scalar operation that may be part of a horizontal
+// reduction. Min and max are SELECT_CC nodes whose compare operands are also
+// the selected values. These are normalized so the result is
+// (LHS CC RHS) ? LHS : RHS, and all nodes in a reduction must use the same
+// condition.
+bool getReductionOperands(SDValue N, unsigned Opcode, bool AllowFPReassoc,
+                          ISD::CondCode &CC, SDValue &LHS, SDValue &RHS) {
+  if (N.getOpcode() != Opcode)
+    return false;
+
+  if (Opcode == ISD::FADD || Opcode == ISD::FMUL) {
+    const SDNodeFlags *Flags = N->getFlags();
+    if (!AllowFPReassoc && !(Flags && Flags->hasUnsafeAlgebra()))
+      return false;
+  }
+
+  if (Opcode != ISD::SELECT_CC) {
+    LHS = N.getOperand(0);
+    RHS = N.getOperand(1);
+    return true;
+  }
+
+  ISD::CondCode NodeCC = cast<CondCodeSDNode>(N.getOperand(4))->get();
+  if (N.getOperand(2) == N.getOperand(0) &&
+      N.getOperand(3) == N.getOperand(1)) {
+    LHS = N.getOperand(0);
+    RHS = N.getOperand(1);
+  } else if (N.getOperand(2) == N.getOperand(1) &&
+             N.getOperand(3) == N.getOperand(0)) {
+    LHS = N.getOperand(1);
+    RHS = N.getOperand(0);
+    NodeCC = ISD::getSetCCSwappedOperands(NodeCC);
+  } else
+    return false;
+
+  switch (NodeCC) {
+  case ISD::SETLT:
+  case ISD::SETLE:
+  case ISD::SETGT:
+  case ISD::SETGE:
+  case ISD::SETULT:
+  case ISD::SETULE:
+  case ISD::SETUGT:
+  case ISD::SETUGE:
+  case ISD::SETOLT:
+  case ISD::SETOLE:
+  case ISD::SETOGT:
+  case ISD::SETOGE:
+    break;
+
+  default:
+    return false; // Not a min or max
+  }
+
+  if (CC == ISD::SETCC_INVALID)
+    CC = NodeCC;
+
+  return CC == NodeCC;
+}
+
+// Walk a tree of scalar operations whose leaves are extracts from a single
+// vector. Set a bit in Lanes for each lane that is used. Fail if a lane is
+// used more than once, or if the tree contains anything else. Interior nodes
+// must not have users other than Parent, since the partial results would not
+// be computed anymore. A min or max uses each operand twice, once in the
+// compare and once as a selected value.
+bool collectReductionLanes(SDValue N, SDNode *Parent, unsigned Opcode,
+                           bool AllowFPReassoc, ISD::CondCode &CC,
+                           SDValue &Source, unsigned &Lanes,
+                           unsigned &NodeCount) {
+  // A full reduction has 16 leaves and 15 operations
+  if (++NodeCount > 31)
+    return false;
+
+  if (N.getOpcode() == ISD::EXTRACT_VECTOR_ELT) {
+    ConstantSDNode *Index = dyn_cast<ConstantSDNode>(N.getOperand(1));
+    if (!Index || Index->getZExtValue() > 15)
+      return false;
+
+    if (!Source)
+      Source = N.getOperand(0);
+    else if (Source != N.getOperand(0))
+      return false;
+
+    unsigned LaneBit = 1 << Index->getZExtValue();
+    if (Lanes & LaneBit)
+      return false;
+
+    Lanes |= LaneBit;
+    return true;
+  }
+
+  SDValue LHS;
+  SDValue RHS;
+  if (!Parent->isOnlyUserOf(N.getNode()) ||
+      !getReductionOperands(N, Opcode, AllowFPReassoc, CC, LHS, RHS))
+    return false;
+
+  return collectReductionLanes(LHS, N.getNode(), Opcode, AllowFPReassoc, CC,
+                               Source, Lanes, NodeCount) &&
+         collectReductionLanes(RHS, N.getNode(), Opcode, AllowFPReassoc, CC,
+                               Source, Lanes, NodeCount);
+}
+
+// Compute a horizontal reduction of all lanes of Vec in log2(16) steps. Each
+// step combines every lane with the lane Distance away from it, so after the
+// last step every lane contains the result.
+SDValue buildReduction(SDValue Vec, unsigned Opcode, ISD::CondCode CC,
+                       const SDLoc &DL, SelectionDAG &DAG) {
+  EVT VT = Vec.getValueType();
+  for (int Distance = 8; Distance > 0; Distance >>= 1) {
+    int ShuffleMask[16];
+    for (int Lane = 0; Lane < 16; Lane++)
+      ShuffleMask[Lane] = Lane ^ Distance;
+
+    SDValue Swapped =
+        DAG.getVectorShuffle(VT, DL, Vec, DAG.getUNDEF(VT), ShuffleMask);
+    if (Opcode == ISD::SELECT_CC) {
+      // Min/max: compare, then take the lanes from Vec where the condition is
+      // true.
+      bool IsFloat = VT.isFloatingPoint();
+      SDValue Mask =
+          DAG.getNode(ISD::INTRINSIC_WO_CHAIN, DL, MVT::i32,
+                      DAG.getConstant(intrinsicForVectorCompare(CC, IsFloat),
+                                      DL, MVT::i32),
+                      Vec, Swapped);
+      Intrinsic::ID MixID = IsFloat ? Intrinsic::nyuzi_vector_mixf
+                                    : Intrinsic::nyuzi_vector_mixi;
+      Vec = DAG.getNode(ISD::INTRINSIC_WO_CHAIN, DL, VT,
+                        DAG.getConstant(MixID, DL, MVT::i32), Mask, Vec,
+                        Swapped);
+    } else
+      Vec = DAG.getNode(Opcode, DL, VT, Vec, Swapped);
+  }
+
+  return DAG.getNode(ISD::EXTRACT_VECTOR_ELT, DL, VT.getVectorElementType(),
+                     Vec, DAG.getConstant(0, DL, MVT::i32));
+}
+
+// Returns true if every defined lane of a shuffle reads from the lane computed
+// by Func. Undefined lanes (-1) match anything.
+template <typename LaneFunc>
+bool matchShuffleIndices(const int LaneIndices[16], LaneFunc Func) {
+  for (int Lane = 0; Lane < 16; Lane++) {
+    if (LaneIndices[Lane] >= 0 && LaneIndices[Lane] != Func(Lane))
+      return false;
+  }
+
+  return true;
+}
+
+SDValue getSplatConstant(int Value, const SDLoc &DL, SelectionDAG &DAG) {
+  return DAG.getNode(NyuziISD::SPLAT, DL, MVT::v16i32,
+                     DAG.getConstant(Value, DL, MVT::i32));
+}
+
+// Build the vector of lane indices for a native shuffle instruction. Common
+// permutations are computed from a vector containing the lane numbers
+// <0, 1, ... 15> with a single vector-scalar instruction or two. That vector
+// is the same for all shuffles, so it is loaded from the constant pool once
+// per function rather than loading a different index vector for each shuffle.
+// Other permutations load their index vector from the constant pool.
+SDValue getShuffleIndexVector(const int LaneIndices[16], const SDLoc &DL,
+                              SelectionDAG &DAG) {
+  SmallVector<SDValue, 16> LaneIds;
+  for (int Lane = 0; Lane < 16; Lane++)
+    LaneIds.push_back(DAG.getConstant(Lane, DL, MVT::i32));
+
+  SDValue LaneIdVector = DAG.getBuildVector(MVT::v16i32, DL, LaneIds);
+
+  // Reverse (15) and butterfly patterns: lane ^ K
+  for (int K = 1; K < 16; K++) {
+    if (matchShuffleIndices(LaneIndices,
+                            [K](int Lane) { return Lane ^ K; }))
+      return DAG.getNode(ISD::XOR, DL, MVT::v16i32, LaneIdVector,
+                         getSplatConstant(K, DL, DAG));
+  }
+
+  // Rotate: (lane + K) & 15
+  for (int K = 1; K < 16; K++) {
+    if (matchShuffleIndices(LaneIndices,
+                            [K](int Lane) { return (Lane + K) & 15; }))
+      return DAG.getNode(
+          ISD::AND, DL, MVT::v16i32,
+          DAG.getNode(ISD::ADD, DL, MVT::v16i32, LaneIdVector,
+                      getSplatConstant(K, DL, DAG)),
+          getSplatConstant(15, DL, DAG));
+  }
+
+  // Interleave the low or high halves: (lane >> 1) + {0, 8}
+  for (int Half = 0; Half < 16; Half += 8) {
+    if (matchShuffleIndices(LaneIndices,
+                            [Half](int Lane) { return (Lane >> 1) + Half; })) {
+      SDValue Indices = DAG.getNode(ISD::SRL, DL, MVT::v16i32, LaneIdVector,
+                                    getSplatConstant(1, DL, DAG));
+      if (Half != 0)
+        Indices = DAG.getNode(ISD::ADD, DL, MVT::v16i32, Indices,
+                              getSplatConstant(Half, DL, DAG));
+
+      return Indices;
+    }
+  }
+
+  // Deinterleave even or odd lanes: ((lane << 1) + {0, 1}) & 15
+  for (int Odd = 0; Odd < 2; Odd++) {
+    if (matchShuffleIndices(LaneIndices, [Odd](int Lane) {
+          return ((Lane << 1) + Odd) & 15;
+        })) {
+      SDValue Indices = DAG.getNode(ISD::SHL, DL, MVT::v16i32, LaneIdVector,
+                                    getSplatConstant(1, DL, DAG));
+      if (Odd)
+        Indices = DAG.getNode(ISD::ADD, DL, MVT::v16i32, Indices,
+                              getSplatConstant(1, DL, DAG));
+
+      return DAG.getNode(ISD::AND, DL, MVT::v16i32, Indices,
+                         getSplatConstant(15, DL, DAG));
+    }
+  }
+
+  // Arbitrary permutation. Undefined lanes keep their own value, which makes
+  // identical index vectors more likely.
+  Constant *ShuffleIndexValues[16];
+  for (int Lane = 0; Lane < 16; Lane++) {
+    ShuffleIndexValues[Lane] = ConstantInt::get(
+        Type::getInt32Ty(*DAG.getContext()),
+        LaneIndices[Lane] < 0 ? Lane : LaneIndices[Lane]);
+  }
+
+  Constant *ShuffleConstVector = ConstantVector::get(ShuffleIndexValues);
+  SDValue ShuffleVectorCP =
+      DAG.getTargetConstantPool(ShuffleConstVector, MVT::v16i32);
+  return DAG.getLoad(
+      MVT::v16i32, DL, DAG.getEntryNode(), ShuffleVectorCP,
+      MachinePointerInfo::getConstantPool(DAG.getMachineFunction()), 64,
+      MachineMemOperand::MOInvariant);
+}
+
+// Compute 1/Operand from the hardware reciprocal estimate. The estimate has
+// 6 bits of precision and each Newton-Raphson iteration doubles that, so two
+// iterations are required to get an accurate 23 bit significand.
+SDValue buildReciprocal(SDValue Operand, int RefinementSteps,
+                        SelectionDAG &DAG) {
+  SDLoc DL(Operand);
+  EVT VT = Operand.getValueType();
+  SDValue Two = DAG.getConstantFP(2.0, DL, VT);
+  SDValue Estimate = DAG.getNode(NyuziISD::RECIPROCAL_EST, DL, VT, Operand);
+  for (int i = 0; i < RefinementSteps; i++) {
+    // Trial = x * Estimate (our target is for x * 1/x to be 1.0)
+    // Error = 2.0 - Trial
+    // Estimate = Estimate * Error
+    SDValue Trial = DAG.getNode(ISD::FMUL, DL, VT, Estimate, Operand);
+    SDValue Error = DAG.getNode(ISD::FSUB, DL, VT, Two, Trial);
+    Estimate = DAG.getNode(ISD::FMUL, DL, VT, Estimate, Error);
+  }
+
+  return Estimate;
+}
+
+// Helper to build inline vector math functions. Values are v16f32 or
+// v16i32. Comparisons return a scalar bitmask, which is used to select lanes
+// with a predicated move.
+class VectorMathBuilder {
+public:
+  VectorMathBuilder(SelectionDAG &DAG, const SDLoc &DL) : DAG(DAG), DL(DL) {}
+
+  SDValue splat(float Value) {
+    return DAG.getNode(NyuziISD::SPLAT, DL, MVT::v16f32,
+                       DAG.getConstantFP(Value, DL, MVT::f32));
+  }
+
+  SDValue splatInt(uint32_t Value) {
+    return DAG.getNode(NyuziISD::SPLAT, DL, MVT::v16i32,
+                       DAG.getConstant(Value, DL, MVT::i32));
+  }
+
+  SDValue fadd(SDValue A, SDValue B) { return node(ISD::FADD, A, B); }
+  SDValue fsub(SDValue A, SDValue B) { return node(ISD::FSUB, A, B); }
+  SDValue fmul(SDValue A, SDValue B) { return node(ISD::FMUL, A, B); }
+  SDValue iadd(SDValue A, SDValue B) { return node(ISD::ADD, A, B); }
+  SDValue isub(SDValue A, SDValue B) { return node(ISD::SUB, A, B); }
+  SDValue iand(SDValue A, SDValue B) { return node(ISD::AND, A, B); }
+  SDValue ior(SDValue A, SDValue B) { return node(ISD::OR, A, B); }
+  SDValue ixor(SDValue A, SDValue B) { return node(ISD::XOR, A, B); }
+  SDValue imul(SDValue A, SDValue B) { return node(ISD::MUL, A, B); }
+  SDValue mulhu(SDValue A, SDValue B) { return node(ISD::MULHU, A, B); }
+  SDValue shl(SDValue A, int Amount) {
+    return node(ISD::SHL, A, splatInt(Amount));
+  }
+  SDValue srl(SDValue A, int Amount) {
+    return node(ISD::SRL, A, splatInt(Amount));
+  }
+  SDValue sra(SDValue A, int Amount) {
+    return node(ISD::SRA, A, splatInt(Amount));
+  }
+
+  SDValue fabs(SDValue A) {
+    return DAG.getNode(ISD::FABS, DL, MVT::v16f32, A);
+  }
+
+  // Convert to integer, rounding toward zero
+  SDValue toInt(SDValue A) {
+    return DAG.getNode(ISD::FP_TO_SINT, DL, MVT::v16i32, A);
+  }
+
+  SDValue toFloat(SDValue A) {
+    return DAG.getNode(ISD::SINT_TO_FP, DL, MVT::v16f32, A);
+  }
+
+  SDValue asInt(SDValue A) {
+    return DAG.getNode(ISD::BITCAST, DL, MVT::v16i32, A);
+  }
+
+  SDValue asFloat(SDValue A) {
+    return DAG.getNode(ISD::BITCAST, DL, MVT::v16f32, A);
+  }
+
+  SDValue compare(Intrinsic::ID ID, SDValue A, SDValue B) {
+    return DAG.getNode(ISD::INTRINSIC_WO_CHAIN, DL, MVT::i32,
+                       DAG.getConstant(ID, DL, MVT::i32), A, B);
+  }
+
+  SDValue maskOr(SDValue A, SDValue B) {
+    return DAG.getNode(ISD::OR, DL, MVT::i32, A, B);
+  }
+
+  SDValue maskNot(SDValue A) {
+    return DAG.getNode(ISD::XOR, DL, MVT::i32, A,
+                       DAG.getConstant(0xffff, DL, MVT::i32));
+  }
+
+  // Take lanes from A where the mask bit is set, otherwise from B.
+  SDValue select(SDValue Mask, SDValue A, SDValue B) {
+    Intrinsic::ID MixID = A.getValueType() == MVT::v16f32
+                              ? Intrinsic::nyuzi_vector_mixf
+                              : Intrinsic::nyuzi_vector_mixi;
+    return DAG.getNode(ISD::INTRINSIC_WO_CHAIN, DL, A.getValueType(),
+                       DAG.getConstant(MixID, DL, MVT::i32), Mask, A, B);
+  }
+
+  // Evaluate a polynomial with Horner's method. Coefficients are in order of
+  // decreasing degree.
+  SDValue poly(SDValue X, ArrayRef<float> Coefficients) {
+    SDValue Result = splat(Coefficients[0]);
+    for (float C : Coefficients.drop_front())
+      Result = fadd(fmul(Result, X), splat(C));
+
+    return Result;
+  }
+
+  SDValue floor(SDValue X);
+  SDValue sqrt(SDValue X, bool Fast);
+  SDValue sinCos(SDValue X, bool IsCos, bool Fast);
+  SDValue exp(SDValue X, bool Fast);
+  SDValue exp2(SDValue X, bool Fast);
+  SDValue log(SDValue X, bool Fast);
+  SDValue log2(SDValue X, bool Fast);
+  void udivrem(SDValue X, SDValue Y, SDValue &Quotient, SDValue &Remainder);
+  void sdivrem(SDValue X, SDValue Y, SDValue &Quotient, SDValue &Remainder);
+
+private:
+  SDValue node(unsigned Opcode, SDValue A, SDValue B) {
+    return DAG.getNode(Opcode, DL, A.getValueType(), A, B);
+  }
+
+  SDValue clamp(SDValue X, float Min, float Max);
+  SDValue scaleByPowerOf2(SDValue X, SDValue N);
+  SDValue logSignificand(SDValue X, bool Fast, SDValue &M, SDValue &E);
+  SDValue logSpecialCases(SDValue X, SDValue Result);
+
+  SelectionDAG &DAG;
+  const SDLoc &DL;
+};
+
+SDValue VectorMathBuilder::floor(SDValue X) {
+  // Converting to an integer rounds toward zero, so subtract one from negative
+  // values that have a fractional part.
+  SDValue Truncated = toFloat(toInt(X));
+  SDValue Floor =
+      select(compare(Intrinsic::nyuzi_mask_cmpf_gt, Truncated, X),
+             fsub(Truncated, splat(1.0f)), Truncated);
+
+  // Values with a magnitude of 2^23 or more (or NaN) are already integers,
+  // and may not fit in an int.
+  return select(compare(Intrinsic::nyuzi_mask_cmpf_lt, fabs(X),
+                        splat(8388608.0f)),
+                Floor, X);
+}
+
+SDValue VectorMathBuilder::sqrt(SDValue X, bool Fast) {
+  // Estimate 1/sqrt(x), with a relative error of about 3.4%, then refine with
+  // Newton-Raphson iterations, each of which roughly doubles the precision:
+  // Est = Est * (1.5 - x / 2 * Est * Est)
+  SDValue Estimate = asFloat(isub(splatInt(0x5f3759df), srl(asInt(X), 1)));
+  SDValue HalfX = fmul(X, splat(0.5f));
+  for (int i = 0, Steps = Fast ? 2 : 3; i < Steps; i++)
+    Estimate = fmul(Estimate,
+                    fsub(splat(1.5f), fmul(HalfX, fmul(Estimate, Estimate))));
+
+  SDValue Result = fmul(X, Estimate);
+
+  // sqrt(0) = 0 and sqrt(inf) = inf, but the estimate is not accurate for
+  // these.
+  SDValue Unchanged = compare(Intrinsic::nyuzi_mask_cmpf_eq, X, splat(0.0f));
+  if (!Fast) {
+    Unchanged =
+        maskOr(Unchanged, compare(Intrinsic::nyuzi_mask_cmpf_eq, X,
+                                  asFloat(splatInt(0x7f800000))));
+    Result = select(compare(Intrinsic::nyuzi_mask_cmpf_lt, X, splat(0.0f)),
+                    asFloat(splatInt(0x7fc00000)), Result);
+  }
+
+  return select(Unchanged, X, Result);
+}
+
+// Polynomial approximations and range reduction are from the Cephes math
+// library. Inputs are reduced to the range [-pi/4, pi/4]. This loses
+// precision for magnitudes above about 8192.
+SDValue VectorMathBuilder::sinCos(SDValue X, bool IsCos, bool Fast) {
+  // J is the octant, rounded up to an even number
+  SDValue AbsX = fabs(X);
+  SDValue J = toInt(fmul(AbsX, splat(1.27323954473516f))); // 4 / pi
+  J = iadd(J, iand(J, splatInt(1)));
+  SDValue Y = toFloat(J);
+
+  // Extended precision modular arithmetic
+  SDValue R = fsub(fsub(fsub(AbsX, fmul(Y, splat(0.78515625f))),
+                        fmul(Y, splat(2.4187564849853515625e-4f))),
+                   fmul(Y, splat(3.77489497744594108e-8f)));
+  SDValue Z = fmul(R, R);
+
+  SDValue SinPoly;
+  SDValue CosPoly;
+  if (Fast) {
+    SinPoly = fadd(fmul(fmul(poly(Z, {8.3321608736E-3f, -1.6666654611E-1f}),
+                             Z),
+                        R),
+                   R);
+    CosPoly = fadd(fsub(fmul(fmul(splat(4.166664568298827E-2f), Z), Z),
+                        fmul(splat(0.5f), Z)),
+                   splat(1.0f));
+  } else {
+    SinPoly = fadd(
+        fmul(fmul(poly(Z, {-1.9515295891E-4f, 8.3321608736E-3f,
+                           -1.6666654611E-1f}),
+                  Z),
+             R),
+        R);
+    CosPoly = fadd(fsub(fmul(fmul(poly(Z, {2.443315711809948E-5f,
+                                           -1.388731625493765E-3f,
+                                           4.166664568298827E-2f}),
+                                  Z),
+                             Z),
+                        fmul(splat(0.5f), Z)),
+                   splat(1.0f));
+  }
+
+  // Octants 2 and 6 use the other polynomial. Octants 4 and 6 negate the
+  // result for sin. For cos, octants 2 and 4 do.
+  SDValue UseOtherPoly =
+      compare(Intrinsic::nyuzi_mask_cmpi_ne, iand(J, splatInt(2)),
+              splatInt(0));
+  SDValue Result;
+  SDValue Sign;
+  if (IsCos) {
+    Result = select(UseOtherPoly, SinPoly, CosPoly);
+    Sign = shl(ixor(J, shl(J, 1)), 29);
+  } else {
+    Result = select(UseOtherPoly, CosPoly, SinPoly);
+    Sign = shl(J, 29);
+
+    // sin(-x) = -sin(x)
+    Sign = ixor(Sign, asInt(X));
+  }
+
+  return asFloat(
+      ixor(asInt(Result), iand(Sign, splatInt(0x80000000))));
+}
+
+SDValue VectorMathBuilder::clamp(SDValue X, float Min, float Max) {
+  SDValue Clamped = select(compare(Intrinsic::nyuzi_mask_cmpf_gt, X,
+                                   splat(Max)),
+                           splat(Max), X);
+  return select(compare(Intrinsic::nyuzi_mask_cmpf_lt, Clamped, splat(Min)),
+                splat(Min), Clamped);
+}
+
+// Multiply X by 2^N, where N is an integral float in the range of normal
+// exponents, by building 2^N in the exponent field.
+SDValue VectorMathBuilder::scaleByPowerOf2(SDValue X, SDValue N) {
+  SDValue Scale = asFloat(shl(iadd(toInt(N), splatInt(127)), 23));
+  return fmul(X, Scale);
+}
+
+SDValue VectorMathBuilder::exp(SDValue X, bool Fast) {
+  const float MaxLog = 88.72283905206835f;
+  const float MinLog = -87.33654475055310f;
+  SDValue Clamped = clamp(X, MinLog, MaxLog);
+
+  // exp(x) = 2^n * exp(r), where n = round(x / ln(2)) and
+  // r = x - n * ln(2), which is in the range [-ln(2) / 2, ln(2) / 2].
+  SDValue N =
+      floor(fadd(fmul(Clamped, splat(1.44269504088896341f)), splat(0.5f)));
+  SDValue R = fsub(fsub(Clamped, fmul(N, splat(0.693359375f))),
+                   fmul(N, splat(-2.12194440e-4f)));
+
+  SDValue ExpR;
+  if (Fast)
+    ExpR = poly(R, {1.6666666666E-1f, 0.5f, 1.0f, 1.0f});
+  else {
+    ExpR = fadd(fadd(fmul(poly(R, {1.9875691500E-4f, 1.3981999507E-3f,
+                                   8.3334519073E-3f, 4.1665795894E-2f,
+                                   1.6666665459E-1f, 5.0000001201E-1f}),
+                          fmul(R, R)),
+                     R),
+                splat(1.0f));
+  }
+
+  SDValue Result = scaleByPowerOf2(ExpR, N);
+
+  // Underflow
+  return select(compare(Intrinsic::nyuzi_mask_cmpf_lt, X, splat(MinLog)),
+                splat(0.0f), Result);
+}
+
+// This is evaluated directly rather than as exp(x * ln(2)), which would round
+// the scaled argument, so integer inputs give exact results. The polynomial
+// is from the Cephes math library.
+SDValue VectorMathBuilder::exp2(SDValue X, bool Fast) {
+  // The smallest result is the smallest normal number.
+  const float MaxExp = 127.0f;
+  const float MinExp = -126.0f;
+  SDValue Clamped = clamp(X, MinExp, MaxExp);
+
+  // 2^x = 2^n * 2^r, where n = round(x) and r = x - n, which is exact and in
+  // the range [-0.5, 0.5].
+  SDValue N = floor(fadd(Clamped, splat(0.5f)));
+  SDValue R = fsub(Clamped, N);
+
+  SDValue ExpR;
+  if (Fast) {
+    ExpR = poly(R, {5.550332471162809E-2f, 2.402264791363012E-1f,
+                    6.931472028550421E-1f});
+  } else {
+    ExpR = poly(R, {1.535336188319500E-4f, 1.339887440266574E-3f,
+                    9.618437357674640E-3f, 5.550332471162809E-2f,
+                    2.402264791363012E-1f, 6.931472028550421E-1f});
+  }
+
+  SDValue Result = scaleByPowerOf2(fadd(fmul(ExpR, R), splat(1.0f)), N);
+
+  // Underflow
+  return select(compare(Intrinsic::nyuzi_mask_cmpf_lt, X, splat(MinExp)),
+                splat(0.0f), Result);
+}
+
+// Split X into an exponent E and a significand in the range
+// [sqrt(0.5), sqrt(2)), and set M to the significand minus one. Returns
+// log(1 + M) - M, which the callers add to M last for precision.
+SDValue VectorMathBuilder::logSignificand(SDValue X, bool Fast, SDValue &M,
+                                          SDValue &E) {
+  SDValue Bits = asInt(X);
+  SDValue IntE = isub(iand(srl(Bits, 23), splatInt(0xff)), splatInt(126));
+  M = asFloat(ior(iand(Bits, splatInt(0x807fffff)), splatInt(0x3f000000)));
+  SDValue IsSmall =
+      compare(Intrinsic::nyuzi_mask_cmpf_lt, M, splat(0.707106781186547524f));
+  E = toFloat(select(IsSmall, isub(IntE, splatInt(1)), IntE));
+  M = fsub(select(IsSmall, fadd(M, M), M), splat(1.0f));
+  SDValue Z = fmul(M, M);
+
+  if (Fast)
+    return fmul(poly(M, {-0.25f, 3.3333333333E-1f, -0.5f}), Z);
+
+  SDValue Y = fmul(fmul(poly(M, {7.0376836292E-2f, -1.1514610310E-1f,
+                                 1.1676998740E-1f, -1.2420140846E-1f,
+                                 1.4249322787E-1f, -1.6668057665E-1f,
+                                 2.0000714765E-1f, -2.4999993993E-1f,
+                                 3.3333331174E-1f}),
+                        M),
+                   Z);
+  return fsub(Y, fmul(Z, splat(0.5f)));
+}
+
+// log(negative or NaN) = NaN, log(0) = -inf, log(inf) = inf
+SDValue VectorMathBuilder::logSpecialCases(SDValue X, SDValue Result) {
+  SDValue Inf = asFloat(splatInt(0x7f800000));
+  Result = select(maskNot(compare(Intrinsic::nyuzi_mask_cmpf_gt, X,
+                                  splat(0.0f))),
+                  asFloat(splatInt(0x7fc00000)), Result);
+  Result = select(compare(Intrinsic::nyuzi_mask_cmpf_eq, X, splat(0.0f)),
+                  asFloat(splatInt(0xff800000)), Result);
+  return select(compare(Intrinsic::nyuzi_mask_cmpf_eq, X, Inf), Inf, Result);
+}
+
+// log(x) = log(1 + M) + e * ln(2)
+SDValue VectorMathBuilder::log(SDValue X, bool Fast) {
+  SDValue M;
+  SDValue E;
+  SDValue Y = logSignificand(X, Fast, M, E);
+  if (Fast) {
+    return logSpecialCases(
+        X, fadd(fadd(M, Y), fmul(E, splat(0.693147180559945f))));
+  }
+
+  // ln(2) is split into two parts so e * ln(2) keeps full precision.
+  Y = fadd(Y, fmul(E, splat(-2.12194440e-4f)));
+  return logSpecialCases(
+      X, fadd(fadd(M, Y), fmul(E, splat(0.693359375f))));
+}
+
+// log2(x) = log(1 + M) * log2(e) + e. This is evaluated directly rather than
+// as log(x) / ln(2), and e is added last, so powers of two give exact results.
+SDValue VectorMathBuilder::log2(SDValue X, bool Fast) {
+  SDValue M;
+  SDValue E;
+  SDValue Y = logSignificand(X, Fast, M, E);
+  if (Fast) {
+    return logSpecialCases(
+        X, fadd(fmul(fadd(M, Y), splat(1.44269504088896341f)), E));
+  }
+
+  // log2(e) is split into 1 + 0.44269..., so the larger part of the product
+  // is exact.
+  SDValue Log2EMinus1 = splat(0.44269504088896340736f);
+  SDValue Result = fadd(fmul(Y, Log2EMinus1), fmul(M, Log2EMinus1));
+  Result = fadd(fadd(Result, Y), M);
+  return logSpecialCases(X, fadd(Result, E));
+}
+
+// There is no integer divider. Estimate 2^32 / Y using the floating point
+// reciprocal, refine it with integer arithmetic, and then correct the
+// quotient. This is the same approach as in AMDGPU's 32-bit division
+// expansion.
+void VectorMathBuilder::udivrem(SDValue X, SDValue Y, SDValue &Quotient,
+                                SDValue &Remainder) {
+  // Convert Y to float. The conversion instruction is signed, so convert
+  // the upper 31 bits and the low bit separately.
+  SDValue FloatY = fadd(fmul(toFloat(srl(Y, 1)), splat(2.0f)),
+                        toFloat(iand(Y, splatInt(1))));
+  SDValue Recip = buildReciprocal(FloatY, 2, DAG);
+
+  // Scale to a 32 bit fixed point value. The reciprocal may be off by a few
+  // ulps. Scaling by slightly less than 2^31 ensures the result is an
+  // underestimate, which the next step requires, and that it fits in a signed
+  // integer. Double it after converting.
+  SDValue Z = shl(toInt(fmul(Recip, splat(2147482624.0f))), 1);
+
+  // One Newton-Raphson iteration in integer arithmetic:
+  // Z = Z + Z * (2^32 - Y * Z) / 2^32
+  SDValue NegYZ = imul(isub(splatInt(0), Y), Z);
+  Z = iadd(Z, mulhu(Z, NegYZ));
+
+  // The resulting quotient is low by at most two.
+  Quotient = mulhu(X, Z);
+  Remainder = isub(X, imul(Quotient, Y));
+  for (int i = 0; i < 2; i++) {
+    SDValue TooSmall =
+        compare(Intrinsic::nyuzi_mask_cmpi_uge, Remainder, Y);
+    Quotient = select(TooSmall, iadd(Quotient, splatInt(1)), Quotient);
+    Remainder = select(TooSmall, isub(Remainder, Y), Remainder);
+  }
+}
+
+// Divide the magnitudes, then fix the signs. The remainder has the sign of
+// the dividend.
+void VectorMathBuilder::sdivrem(SDValue X, SDValue Y, SDValue &Quotient,
+                                SDValue &Remainder) {
+  SDValue SignX = sra(X, 31);
+  SDValue SignY = sra(Y, 31);
+  udivrem(isub(ixor(X, SignX), SignX), isub(ixor(Y, SignY), SignY), Quotient,
+          Remainder);
+  SDValue SignQ = ixor(SignX, SignY);
+  Quotient = isub(ixor(Quotient, SignQ), SignQ);
+  Remainder = isub(ixor(Remainder, SignX), SignX);
+}
+
 // Return a SETCC node with the same operands as the passed one, but
 // a different comparison type
 SDValue morphSETCCNode(SDValue Op, ISD::CondCode code, SelectionDAG &DAG) {
@@ -215,6 +1031,18 @@ NyuziTargetLowering::NyuziTargetLowering(const TargetMachine &TM,
   setOperationAction(ISD::FRAMEADDR, MVT::i32, Custom);
   setOperationAction(ISD::RETURNADDR, MVT::i32, Custom);
   setOperationAction(ISD::SIGN_EXTEND_INREG, MVT::v16i1, Custom);
+  setOperationAction(ISD::LOAD, MVT::v16i32, Custom);
+  setOperationAction(ISD::LOAD, MVT::v16f32, Custom);
+  setOperationAction(ISD::STORE, MVT::v16i32, Custom);
+  setOperationAction(ISD::STORE, MVT::v16f32, Custom);
+  setOperationAction(ISD::MLOAD, MVT::v16i32, Custom);
+  setOperationAction(ISD::MLOAD, MVT::v16f32, Custom);
+  setOperationAction(ISD::MSTORE, MVT::v16i32, Custom);
+  setOperationAction(ISD::MSTORE, MVT::v16f32, Custom);
+  setOperationAction(ISD::MGATHER, MVT::v16i32, Custom);
+  setOperationAction(ISD::MGATHER, MVT::v16f32, Custom);
+  setOperationAction(ISD::MSCATTER, MVT::v16i32, Custom);
+  setOperationAction(ISD::MSCATTER, MVT::v16f32, Custom);
   setOperationAction(ISD::VASTART, MVT::Other, Custom);
   setOperationAction(ISD::FABS, MVT::f32, Custom);
   setOperationAction(ISD::FABS, MVT::v16f32, Custom);
@@ -223,7 +1051,11 @@ NyuziTargetLowering::NyuziTargetLowering(const TargetMachine &TM,
   setOperationAction(ISD::BRCOND, MVT::i32, Expand);
   setOperationAction(ISD::BRCOND, MVT::f32, Expand);
   setOperationAction(ISD::SIGN_EXTEND_INREG, MVT::i1, Expand);
+  setOperationAction(ISD::SIGN_EXTEND_INREG, MVT::v16i8, Expand);
+  setOperationAction(ISD::SIGN_EXTEND_INREG, MVT::v16i16, Expand);
   setOperationAction(ISD::CTPOP, MVT::i32, Expand);
+  setOperationAction(ISD::VSELECT, MVT::v16i32, Custom);
+  setOperationAction(ISD::VSELECT, MVT::v16f32, Custom);
   setOperationAction(ISD::SELECT, MVT::i32, Expand);
   setOperationAction(ISD::SELECT, MVT::v16i32, Expand);
   setOperationAction(ISD::SELECT, MVT::f32, Expand);
@@ -252,19 +1084,9 @@ NyuziTargetLowering::NyuziTargetLowering(const TargetMachine &TM,
   setOperationAction(ISD::VAARG, MVT::Other, Expand);
   setOperationAction(ISD::VACOPY, MVT::Other, Expand);
   setOperationAction(ISD::VAEND, MVT::Other, Expand);
-  setOperationAction(ISD::ATOMIC_LOAD, MVT::i32, Expand);
-  setOperationAction(ISD::ATOMIC_LOAD, MVT::i64, Expand);
-  setOperationAction(ISD::ATOMIC_STORE, MVT::i32, Expand);
-  setOperationAction(ISD::ATOMIC_STORE, MVT::i64, Expand);
 
   setCondCodeAction(ISD::SETO, MVT::f32, Custom);
   setCondCodeAction(ISD::SETUO, MVT::f32, Custom);
-  setCondCodeAction(ISD::SETUEQ, MVT::f32, Custom);
-  setCondCodeAction(ISD::SETUNE, MVT::f32, Custom);
-  setCondCodeAction(ISD::SETUGT, MVT::f32, Custom);
-  setCondCodeAction(ISD::SETUGE, MVT::f32, Custom);
-  setCondCodeAction(ISD::SETULT, MVT::f32, Custom);
-  setCondCodeAction(ISD::SETULE, MVT::f32, Custom);
   setCondCodeAction(ISD::SETUEQ, MVT::v16f32, Custom);
   setCondCodeAction(ISD::SETUNE, MVT::v16f32, Custom);
   setCondCodeAction(ISD::SETUGT, MVT::v16f32, Custom);
@@ -274,7 +1096,13 @@ NyuziTargetLowering::NyuziTargetLowering(const TargetMachine &TM,
 
   setOperationAction(ISD::FCOPYSIGN, MVT::f32, Expand);
   setOperationAction(ISD::FFLOOR, MVT::f32, Expand);
-  setOperationAction(ISD::FFLOOR, MVT::v16f32, Expand);
+  // Inline vector math (see LowerVectorMath). These default to legal for
+  // vector types, so they must be expanded explicitly otherwise.
+  for (auto Opcode : {ISD::FFLOOR, ISD::FSQRT, ISD::FSIN, ISD::FCOS, ISD::FEXP,
+                      ISD::FEXP2, ISD::FLOG, ISD::FLOG2}) {
+    setOperationAction(Opcode, MVT::v16f32,
+                       VectorMath == VectorMathLibcall ? Expand : Custom);
+  }
 
   // Hardware does not have an integer divider, so convert these to
   // library calls
@@ -283,11 +1111,41 @@ NyuziTargetLowering::NyuziTargetLowering(const TargetMachine &TM,
   setOperationAction(ISD::SDIV, MVT::i32, Expand); // __divsi3
   setOperationAction(ISD::SREM, MVT::i32, Expand); // __modsi3
 
+  // Vector division is expanded inline (see LowerVectorDivRem). Division by
+  // a constant uses a multiply with a magic number instead.
+  setOperationAction(ISD::UDIV, MVT::v16i32, Custom);
+  setOperationAction(ISD::UREM, MVT::v16i32, Custom);
+  setOperationAction(ISD::SDIV, MVT::v16i32, Custom);
+  setOperationAction(ISD::SREM, MVT::v16i32, Custom);
+
+  // Only data read prefetches do anything (see LowerPREFETCH)
+  setOperationAction(ISD::PREFETCH, MVT::Other, Custom);
+
   setOperationAction(ISD::FSQRT, MVT::f32, Expand); // sqrtf
   setOperationAction(ISD::FSIN, MVT::f32, Expand);  // sinf
   setOperationAction(ISD::FCOS, MVT::f32, Expand);  // cosf
   setOperationAction(ISD::FSINCOS, MVT::f32, Expand);
 
+  // Horizontal reductions (see PerformDAGCombine)
+  setTargetDAGCombine(ISD::ADD);
+  setTargetDAGCombine(ISD::MUL);
+  setTargetDAGCombine(ISD::AND);
+  setTargetDAGCombine(ISD::OR);
+  setTargetDAGCombine(ISD::XOR);
+  setTargetDAGCombine(ISD::FADD);
+  setTargetDAGCombine(ISD::FMUL);
+  setTargetDAGCombine(ISD::SELECT_CC);
+
+  // Index width of generic gathers and scatters (see
+  // normalizeGatherScatterIndex)
+  setTargetDAGCombine(ISD::MGATHER);
+  setTargetDAGCombine(ISD::MSCATTER);
+
+  // Atomic operations are expanded by AtomicExpandPass (see
+  // shouldExpandAtomicRMWInIR)
+  setMaxAtomicSizeInBitsSupported(32);
+  setMinCmpXchgSizeInBits(32);
+
   setStackPointerRegisterToSaveRestore(Nyuzi::SP_REG);
   setMinFunctionAlignment(2);
 
@@ -309,6 +1167,8 @@ SDValue NyuziTargetLowering::LowerOperation(SDValue Op,
     return LowerSCALAR_TO_VECTOR(Op, DAG);
   case ISD::SELECT_CC:
     return LowerSELECT_CC(Op, DAG);
+  case ISD::VSELECT:
+    return LowerVSELECT(Op, DAG);
   case ISD::SETCC:
     return LowerSETCC(Op, DAG);
   case ISD::ConstantPool:
@@ -327,6 +1187,8 @@ SDValue NyuziTargetLowering::LowerOperation(SDValue Op,
     return LowerBlockAddress(Op, DAG);
   case ISD::VASTART:
     return LowerVASTART(Op, DAG);
+  case ISD::PREFETCH:
+    return LowerPREFETCH(Op, DAG);
   case ISD::CTLZ_ZERO_UNDEF:
     return LowerCTLZ_ZERO_UNDEF(Op, DAG);
   case ISD::CTTZ_ZERO_UNDEF:
@@ -339,11 +1201,111 @@ SDValue NyuziTargetLowering::LowerOperation(SDValue Op,
     return LowerRETURNADDR(Op, DAG);
   case ISD::SIGN_EXTEND_INREG:
     return LowerSIGN_EXTEND_INREG(Op, DAG);
+  case ISD::LOAD:
+    return LowerLOAD(Op, DAG);
+  case ISD::STORE:
+    return LowerSTORE(Op, DAG);
+  case ISD::MLOAD:
+    return LowerMLOAD(Op, DAG);
+  case ISD::MSTORE:
+    return LowerMSTORE(Op, DAG);
+  case ISD::MGATHER:
+    return LowerMGATHER(Op, DAG);
+  case ISD::MSCATTER:
+    return LowerMSCATTER(Op, DAG);
+  case ISD::UDIV:
+  case ISD::UREM:
+  case ISD::SDIV:
+  case ISD::SREM:
+    return LowerVectorDivRem(Op, DAG);
+  case ISD::FFLOOR:
+  case ISD::FSQRT:
+  case ISD::FSIN:
+  case ISD::FCOS:
+  case ISD::FEXP:
+  case ISD::FEXP2:
+  case ISD::FLOG:
+  case ISD::FLOG2:
+    return LowerVectorMath(Op, DAG);
   default:
     llvm_unreachable("Should not custom lower this!");
   }
 }
 
+// Recognize a scalar reduction of all lanes of a vector, for example:
+// (add (add (extract_vector_elt v, 0), (extract_vector_elt v, 1)), ...)
+// Extracting each lane and combining the results serially takes 31
+// instructions. Instead, combine the vector with shuffled copies of itself.
+SDValue NyuziTargetLowering::PerformDAGCombine(SDNode *N,
+                                               DAGCombinerInfo &DCI) const {
+  if (!DCI.isBeforeLegalizeOps())
+    return SDValue();
+
+  // This is also called for all target specific nodes.
+  unsigned Opcode = N->getOpcode();
+  switch (Opcode) {
+  case ISD::ADD:
+  case ISD::MUL:
+  case ISD::AND:
+  case ISD::OR:
+  case ISD::XOR:
+  case ISD::FADD:
+  case ISD::FMUL:
+  case ISD::SELECT_CC:
+    break;
+
+  case ISD::MGATHER:
+  case ISD::MSCATTER:
+    return normalizeGatherScatterIndex(cast<MaskedGatherScatterSDNode>(N),
+                                       DCI);
+
+  default:
+    return SDValue();
+  }
+
+  SelectionDAG &DAG = DCI.DAG;
+  const TargetOptions &Options = DAG.getTarget().Options;
+  bool IsFloat = N->getValueType(0).isFloatingPoint();
+  bool AllowFPReassoc = Options.UnsafeFPMath;
+  if (Opcode == ISD::SELECT_CC && IsFloat && !AllowFPReassoc &&
+      !Options.NoNaNsFPMath)
+    return SDValue();
+
+  ISD::CondCode CC = ISD::SETCC_INVALID;
+  SDValue LHS;
+  SDValue RHS;
+  if (!getReductionOperands(SDValue(N, 0), Opcode, AllowFPReassoc, CC, LHS,
+                            RHS))
+    return SDValue();
+
+  SDValue Source;
+  unsigned Lanes = 0;
+  unsigned NodeCount = 1;
+  if (!collectReductionLanes(LHS, N, Opcode, AllowFPReassoc, CC, Source,
+                             Lanes, NodeCount) ||
+      !collectReductionLanes(RHS, N, Opcode, AllowFPReassoc, CC, Source,
+                             Lanes, NodeCount) ||
+      Lanes != 0xffff) {
+    // The combiner converts selects to SELECT_CC starting at the root of the
+    // tree, so the root is visited before the nodes below it are converted.
+    // Revisit the parent each time a node below it changes, so the root is
+    // checked again once the whole tree has been converted.
+    if (Opcode == ISD::SELECT_CC && !N->use_empty()) {
+      SDNode *User = *N->use_begin();
+      if (User->getOpcode() == ISD::SELECT_CC && User->isOnlyUserOf(N))
+        DCI.AddToWorklist(User);
+    }
+
+    return SDValue();
+  }
+
+  MVT VT = Source.getValueType().getSimpleVT();
+  if (VT != MVT::v16i32 && VT != MVT::v16f32)
+    return SDValue();
+
+  return buildReduction(Source, Opcode, CC, SDLoc(N), DAG);
+}
+
 SDValue
 NyuziTargetLowering::LowerReturn(SDValue Chain, CallingConv::ID CallConv,
                                  bool IsVarArg,
@@ -687,43 +1649,9 @@ NyuziTargetLowering::EmitInstrWithCustomInserter(MachineInstr &MI,
   case Nyuzi::SELECTVF:
     return EmitSelectCC(MI, BB);
 
-  case Nyuzi::ATOMIC_LOAD_ADDR:
-    return EmitAtomicBinary(MI, BB, Nyuzi::ADDISSS);
-
-  case Nyuzi::ATOMIC_LOAD_ADDI:
-    return EmitAtomicBinary(MI, BB, Nyuzi::ADDISSI);
-
-  case Nyuzi::ATOMIC_LOAD_SUBR:
-    return EmitAtomicBinary(MI, BB, Nyuzi::SUBISSS);
-
-  case Nyuzi::ATOMIC_LOAD_SUBI:
-    return EmitAtomicBinary(MI, BB, Nyuzi::SUBISSI);
-
-  case Nyuzi::ATOMIC_LOAD_ANDR:
-    return EmitAtomicBinary(MI, BB, Nyuzi::ANDSSS);
-
-  case Nyuzi::ATOMIC_LOAD_ANDI:
-    return EmitAtomicBinary(MI, BB, Nyuzi::ANDSSI);
-
-  case Nyuzi::ATOMIC_LOAD_ORR:
-    return EmitAtomicBinary(MI, BB, Nyuzi::ORSSS);
-
-  case Nyuzi::ATOMIC_LOAD_ORI:
-    return EmitAtomicBinary(MI, BB, Nyuzi::ORSSI);
-
-  case Nyuzi::ATOMIC_LOAD_XORR:
-    return EmitAtomicBinary(MI, BB, Nyuzi::XORSSS);
-
-  case Nyuzi::ATOMIC_LOAD_XORI:
-    return EmitAtomicBinary(MI, BB, Nyuzi::XORSSI);
-
-  // XXX ATOMIC_LOAD_NAND is not supported
-
-  case Nyuzi::ATOMIC_SWAP:
-    return EmitAtomicBinary(MI, BB, 0);
-
-  case Nyuzi::ATOMIC_CMP_SWAP:
-    return EmitAtomicCmpSwap(MI, BB);
+  case Nyuzi::SCATTER_ATOMIC_ADDI:
+  case Nyuzi::SCATTER_ATOMIC_ADDF:
+    return EmitScatterAtomicAdd(MI, BB);
 
   default:
     llvm_unreachable("unknown atomic operation");
@@ -830,6 +1758,187 @@ bool NyuziTargetLowering::shouldInsertFencesForAtomic(
   return true;
 }
 
+// load_sync/store_sync only operate on 32-bit words. AtomicExpandPass builds
+// smaller operations from a masked compare-and-swap on the containing word,
+// then expands that compare-and-swap with emitLoadLinked and
+// emitStoreConditional like any other 32-bit one.
+TargetLowering::AtomicExpansionKind
+NyuziTargetLowering::shouldExpandAtomicRMWInIR(AtomicRMWInst *AI) const {
+  unsigned Size = AI->getType()->getPrimitiveSizeInBits();
+  return Size < 32 ? AtomicExpansionKind::CmpXChg : AtomicExpansionKind::LLSC;
+}
+
+bool NyuziTargetLowering::shouldExpandAtomicCmpXchgInIR(
+    AtomicCmpXchgInst *AI) const {
+  const DataLayout &DL = AI->getModule()->getDataLayout();
+  return DL.getTypeStoreSizeInBits(AI->getCompareOperand()->getType()) >= 32;
+}
+
+Value *NyuziTargetLowering::emitLoadLinked(IRBuilder<> &Builder, Value *Addr,
+                                           AtomicOrdering Ord) const {
+  Module *M = Builder.GetInsertBlock()->getModule();
+  Function *LoadSync = Intrinsic::getDeclaration(M, Intrinsic::nyuzi_load_sync);
+  Addr = Builder.CreateBitCast(Addr, Builder.getInt8PtrTy());
+  return Builder.CreateCall(LoadSync, Addr);
+}
+
+// AtomicExpandPass expects zero on success, which is the inverse of what
+// store_sync returns.
+//
+// If the function has the "nyuzi-atomic-backoff" attribute, a failed store
+// also waits before the caller retries, so many hardware threads contending
+// for one lock don't keep stealing the cache line from each other. The delay
+// starts small and doubles on each failure, up to a limit. It is kept in one
+// stack slot per function, initialized on entry, which carries it across
+// iterations of the retry loop (AtomicExpandPass hasn't built the loop yet,
+// so it can't be a PHI). It isn't reset when a store succeeds: a thread that
+// keeps losing the line keeps waiting longer for the rest of the call, and a
+// store that succeeds first time costs nothing extra.
+Value *NyuziTargetLowering::emitStoreConditional(IRBuilder<> &Builder,
+                                                 Value *Val, Value *Addr,
+                                                 AtomicOrdering Ord) const {
+  Module *M = Builder.GetInsertBlock()->getModule();
+  Function *StoreSync =
+      Intrinsic::getDeclaration(M, Intrinsic::nyuzi_store_sync);
+  Addr = Builder.CreateBitCast(Addr, Builder.getInt8PtrTy());
+  Value *Success = Builder.CreateCall(StoreSync, {Val, Addr});
+  Value *Failed = Builder.CreateICmpEQ(Success, Builder.getInt32(0));
+
+  BasicBlock *BB = Builder.GetInsertBlock();
+  Function *F = BB->getParent();
+  if (F->hasFnAttribute("nyuzi-atomic-backoff")) {
+    LLVMContext &Ctx = F->getContext();
+    Type *Int32Ty = Builder.getInt32Ty();
+    AllocaInst *DelaySlot = getAtomicBackoffSlot(*F);
+
+    // AtomicExpandPass hasn't terminated this block yet; it will add the
+    // branch back to the load linked after this returns. Wait on the failure
+    // path first, then continue in a new block where it can put that branch.
+    BasicBlock *WaitBB =
+        BasicBlock::Create(Ctx, "backoff.wait", F, BB->getNextNode());
+    BasicBlock *SpinBB =
+        BasicBlock::Create(Ctx, "backoff.spin", F, BB->getNextNode());
+    BasicBlock *ContBB =
+        BasicBlock::Create(Ctx, "backoff.cont", F, BB->getNextNode());
+    Builder.CreateCondBr(Failed, WaitBB, ContBB);
+
+    Builder.SetInsertPoint(WaitBB);
+    Value *Delay = Builder.CreateLoad(DelaySlot);
+    Value *Grown = Builder.CreateShl(Delay, 1);
+    Value *MaxDelay = Builder.getInt32(kMaxAtomicBackoff);
+    Builder.CreateStore(Builder.CreateSelect(
+                            Builder.CreateICmpULT(Grown, MaxDelay), Grown,
+                            MaxDelay),
+                        DelaySlot);
+    Builder.CreateBr(SpinBB);
+
+    Builder.SetInsertPoint(SpinBB);
+    PHINode *Count = Builder.CreatePHI(Int32Ty, 2);
+    Count->addIncoming(Delay, WaitBB);
+    Value *Remaining = Builder.CreateSub(Count, Builder.getInt32(1));
+    Count->addIncoming(Remaining, SpinBB);
+    Builder.CreateCondBr(Builder.CreateICmpEQ(Remaining, Builder.getInt32(0)),
+                         ContBB, SpinBB);
+
+    Builder.SetInsertPoint(ContBB);
+  }
+
+  return Builder.CreateZExt(Failed, Builder.getInt32Ty());
+}
+
+// Returns the stack slot holding the current backoff delay for atomic
+// operations in F, creating it the first time. It is tagged with metadata so
+// it can be found again without relying on value names, which may have been
+// discarded.
+AllocaInst *NyuziTargetLowering::getAtomicBackoffSlot(Function &F) const {
+  LLVMContext &Ctx = F.getContext();
+  unsigned SlotKind = Ctx.getMDKindID("nyuzi.atomic.backoff");
+  BasicBlock &Entry = F.getEntryBlock();
+  for (Instruction &I : Entry) {
+    if (I.getMetadata(SlotKind))
+      return cast<AllocaInst>(&I);
+  }
+
+  IRBuilder<> EntryBuilder(&*Entry.getFirstInsertionPt());
+  AllocaInst *DelaySlot =
+      EntryBuilder.CreateAlloca(EntryBuilder.getInt32Ty(), nullptr,
+                                "backoff.delay");
+  DelaySlot->setMetadata(SlotKind, MDNode::get(Ctx, None));
+  EntryBuilder.CreateStore(EntryBuilder.getInt32(kMinAtomicBackoff),
+                           DelaySlot);
+  return DelaySlot;
+}
+
+// There is no hardware divider, so dividing by the same value more than once
+// is worth replacing with a multiplication by its reciprocal.
+unsigned NyuziTargetLowering::combineRepeatedFPDivisors() const { return 2; }
+
+// Called by the combiner for unsafe math or when -mrecip enables estimates.
+// Two refinement steps are used unless the "reciprocal-estimates" function
+// attribute (-mrecip) requests fewer. Unsafe math alone doesn't reduce them:
+// one step only gives 12 bits.
+SDValue NyuziTargetLowering::getRecipEstimate(SDValue Operand,
+                                              SelectionDAG &DAG, int Enabled,
+                                              int &RefinementSteps) const {
+  EVT VT = Operand.getValueType();
+  if (VT != MVT::f32 && VT != MVT::v16f32)
+    return SDValue();
+
+  if (Enabled == ReciprocalEstimate::Disabled)
+    return SDValue();
+
+  if (RefinementSteps == ReciprocalEstimate::Unspecified)
+    RefinementSteps = 2;
+
+  SDValue Estimate = buildReciprocal(Operand, RefinementSteps, DAG);
+
+  // The refinement is done, so the caller doesn't need to do any more.
+  RefinementSteps = 0;
+  return Estimate;
+}
+
+// There is no square root instruction, so compute an initial estimate of
+// 1/sqrt(x) with integer operations on the bits of the floating point
+// value: 0x5f3759df - (bits >> 1). This has a relative error of about 3.4%.
+// The generic combiner refines it with Newton-Raphson iterations, each of
+// which roughly doubles the precision, so three are required for the full
+// significand. This is only used with unsafe math, unless -mrecip disables
+// it; otherwise sqrtf is a library call.
+SDValue NyuziTargetLowering::getSqrtEstimate(SDValue Operand,
+                                             SelectionDAG &DAG, int Enabled,
+                                             int &RefinementSteps,
+                                             bool &UseOneConstNR,
+                                             bool Reciprocal) const {
+  EVT VT = Operand.getValueType();
+  if (VT != MVT::f32 && VT != MVT::v16f32)
+    return SDValue();
+
+  if (Enabled == ReciprocalEstimate::Disabled)
+    return SDValue();
+
+  if (RefinementSteps == ReciprocalEstimate::Unspecified)
+    RefinementSteps = 3;
+
+  UseOneConstNR = true;
+
+  SDLoc DL(Operand);
+  EVT IntVT = VT.changeTypeToInteger();
+  SDValue Bits = DAG.getNode(ISD::BITCAST, DL, IntVT, Operand);
+  SDValue HalfBits = DAG.getNode(ISD::SRL, DL, IntVT, Bits,
+                                 DAG.getConstant(1, DL, IntVT));
+  SDValue Estimate = DAG.getNode(
+      ISD::BITCAST, DL, VT,
+      DAG.getNode(ISD::SUB, DL, IntVT, DAG.getConstant(0x5f3759df, DL, IntVT),
+                  HalfBits));
+
+  // The refinement multiplies by the operand to convert the reciprocal to
+  // a square root. If there is no refinement, do that here.
+  if (!Reciprocal && RefinementSteps == 0)
+    Estimate = DAG.getNode(ISD::FMUL, DL, VT, Estimate, Operand);
+
+  return Estimate;
+}
+
 // Global addresses are stored in the per-function constant pool.
 // This is hard coded for a static linking model and does not support PIC.
 SDValue NyuziTargetLowering::LowerGlobalAddress(SDValue Op,
@@ -863,42 +1972,58 @@ SDValue NyuziTargetLowering::LowerVECTOR_SHUFFLE(SDValue Op,
   ShuffleVectorSDNode *ShuffleNode = dyn_cast<ShuffleVectorSDNode>(Op);
   SDLoc DL(Op);
 
-  // Analyze the vector indices.
+  // Analyze the vector indices. Undefined lanes (-1) can take any value, so
+  // they don't prevent any of the patterns below from matching.
   unsigned int Mask = 0;
+  unsigned int DefinedMask = 0;
   bool IsIdentityShuffle = true;
   bool IsSplat = true;
-  int SplatIndex = 0;
-  Constant *ShuffleIndexValues[16];
+  int SplatIndex = -1;
+  int LaneIndices[16];
 
   for (int SourceLane = 0; SourceLane < 16; SourceLane++) {
     int DestLaneIndex = ShuffleNode->getMaskElt(SourceLane);
-    // If this is undef (-1), set to zero. There is potential for optimizations
-    // here, although this is rare.
-    if (DestLaneIndex < 0)
-      DestLaneIndex = 0;
-
     Mask <<= 1;
+    DefinedMask <<= 1;
+    if (DestLaneIndex < 0) {
+      LaneIndices[SourceLane] = -1;
+      continue;
+    }
+
+    DefinedMask |= 1;
     if (DestLaneIndex > 15)
       Mask |= 1;
 
     if ((DestLaneIndex & 15) != SourceLane)
       IsIdentityShuffle = false;
 
-    if (SourceLane == 0)
+    if (SplatIndex < 0)
       SplatIndex = DestLaneIndex;
     else if (SplatIndex != DestLaneIndex)
       IsSplat = false;
 
-    ShuffleIndexValues[SourceLane] = ConstantInt::get(
-        Type::getInt32Ty(*DAG.getContext()), DestLaneIndex & 15);
+    LaneIndices[SourceLane] = DestLaneIndex & 15;
   }
 
+  if (DefinedMask == 0)
+    return DAG.getUNDEF(VT);
+
+  // If the defined lanes all come from one vector, the undefined lanes can
+  // too.
+  if ((Mask & DefinedMask) == 0)
+    Mask = 0;
+  else if ((Mask & DefinedMask) == DefinedMask)
+    Mask = 0xffff;
+
   // Check if the operands are equal
   if (Op.getOperand(0) == Op.getOperand(1))
     Mask = 0;
 
-  // XXX could check if either operand is undef and change the mask
-  // accordingly...
+  // If one operand is undefined, take every lane from the other one.
+  if (Op.getOperand(1).isUndef())
+    Mask = 0;
+  else if (Op.getOperand(0).isUndef())
+    Mask = 0xffff;
 
   // scalar_to_vector loads a scalar element into the lowest lane of the vector.
   // The higher lanes are undefined (which means we can load the same value into
@@ -912,30 +2037,25 @@ SDValue NyuziTargetLowering::LowerVECTOR_SHUFFLE(SDValue Op,
     // %single = insertelement <16 x i32> (don't care), i32 %value, i32 <index>
     // %vector = shufflevector <16 x i32> %single, <16 x i32> (don't care),
     //                         <16 x i32> <...index...>
-    if (Op.getOperand(0).getOpcode() == ISD::INSERT_VECTOR_ELT &&
-        SplatIndex ==
-            dyn_cast<ConstantSDNode>(Op.getOperand(0).getOperand(2))
-                ->getSExtValue()) {
-      return DAG.getNode(NyuziISD::SPLAT, DL, VT,
-                         Op.getOperand(0).getOperand(1));
+    SDValue SplatSource = SplatIndex < 16 ? Op.getOperand(0) : Op.getOperand(1);
+    if (SplatSource.getOpcode() == ISD::INSERT_VECTOR_ELT &&
+        isa<ConstantSDNode>(SplatSource.getOperand(2)) &&
+        SplatIndex % 16 == cast<ConstantSDNode>(SplatSource.getOperand(2))
+                               ->getSExtValue()) {
+      return DAG.getNode(NyuziISD::SPLAT, DL, VT, SplatSource.getOperand(1));
     }
 
     // This is a splat where the element is taken from another vector that
     // we don't know the value of. First extract element, then broadcast it.
-    SDValue SourceVector =
-        SplatIndex < 16 ? Op.getOperand(0) : Op.getOperand(1);
     SDValue LaneIndexValue = DAG.getConstant(SplatIndex % 16, DL, MVT::i32);
     SDValue LaneValue = DAG.getNode(ISD::EXTRACT_VECTOR_ELT, DL, MVT::i32,
-                                    SourceVector, LaneIndexValue);
+                                    SplatSource, LaneIndexValue);
     return DAG.getNode(NyuziISD::SPLAT, DL, VT, LaneValue);
   }
 
-  Constant *ShuffleConstVector = ConstantVector::get(ShuffleIndexValues);
-  SDValue ShuffleVectorCP =
-      DAG.getTargetConstantPool(ShuffleConstVector, MVT::v16i32);
-  SDValue ShuffleVector = DAG.getLoad(
-      MVT::v16i32, DL, DAG.getEntryNode(), ShuffleVectorCP,
-      MachinePointerInfo::getConstantPool(DAG.getMachineFunction()), 64);
+  SDValue ShuffleVector;
+  if (!IsIdentityShuffle)
+    ShuffleVector = getShuffleIndexVector(LaneIndices, DL, DAG);
 
   SDValue NativeShuffleIntr =
       DAG.getConstant(Intrinsic::nyuzi_shufflei, DL, MVT::i32);
@@ -998,9 +2118,7 @@ SDValue NyuziTargetLowering::LowerSCALAR_TO_VECTOR(SDValue Op,
 }
 
 // This architecture does not support conditional moves for scalar registers.
-// We must convert this into a set of conditional branches. We do this by
-// creating a pseudo-instruction SEL_COND_RESULT, which will later be
-// transformed.
+// Compute the predicate and select between the values with buildSelect.
 SDValue NyuziTargetLowering::LowerSELECT_CC(SDValue Op,
                                             SelectionDAG &DAG) const {
   SDLoc DL(Op);
@@ -1010,8 +2128,66 @@ SDValue NyuziTargetLowering::LowerSELECT_CC(SDValue Op,
                                                      *DAG.getContext(), Ty),
                   Op.getOperand(0), Op.getOperand(1), Op.getOperand(4));
 
-  return DAG.getNode(NyuziISD::SEL_COND_RESULT, DL, Op.getValueType(), Pred,
-                     Op.getOperand(2), Op.getOperand(3));
+  return buildSelect(DL, Pred, Op.getOperand(2), Op.getOperand(3), DAG);
+}
+
+// Select TrueVal if the scalar predicate Pred is set, otherwise FalseVal.
+// Vectors use a predicated move with an all-ones or all-zeroes mask.
+// Scalars use mask arithmetic:
+//   mask = (pred << 31) >> 31 (arithmetic)
+//   result = falseval ^ ((trueval ^ falseval) & mask)
+// This is five instructions (shl, ashr, xor, and, xor), fewer when one of the
+// values is zero. It has no branch to mispredict, but is always used, not
+// chosen by cost. When optimizing for size, emit the SEL_COND_RESULT pseudo
+// instead, which EmitSelectCC expands into a diamond of conditional
+// branches.
+SDValue NyuziTargetLowering::buildSelect(const SDLoc &DL, SDValue Pred,
+                                         SDValue TrueVal, SDValue FalseVal,
+                                         SelectionDAG &DAG) const {
+  EVT VT = TrueVal.getValueType();
+  if (!VT.isVector() && DAG.getMachineFunction().getFunction()->optForSize())
+    return DAG.getNode(NyuziISD::SEL_COND_RESULT, DL, VT, Pred, TrueVal,
+                       FalseVal);
+
+  // Setcc results only have a defined low bit. Shift it into the sign bit
+  // and back to replicate it to all bits.
+  SDValue Mask = DAG.getNode(
+      ISD::SRA, DL, MVT::i32,
+      DAG.getNode(ISD::SHL, DL, MVT::i32, Pred,
+                  DAG.getConstant(31, DL, MVT::i32)),
+      DAG.getConstant(31, DL, MVT::i32));
+
+  if (VT.isVector()) {
+    Intrinsic::ID MixIntrinsic = VT.isFloatingPoint()
+                                     ? Intrinsic::nyuzi_vector_mixf
+                                     : Intrinsic::nyuzi_vector_mixi;
+    return DAG.getNode(ISD::INTRINSIC_WO_CHAIN, DL, VT,
+                       DAG.getConstant(MixIntrinsic, DL, MVT::i32), Mask,
+                       TrueVal, FalseVal);
+  }
+
+  SDValue TrueBits = DAG.getNode(ISD::BITCAST, DL, MVT::i32, TrueVal);
+  SDValue FalseBits = DAG.getNode(ISD::BITCAST, DL, MVT::i32, FalseVal);
+  SDValue Diff = DAG.getNode(ISD::XOR, DL, MVT::i32, TrueBits, FalseBits);
+  SDValue Result = DAG.getNode(
+      ISD::XOR, DL, MVT::i32, FalseBits,
+      DAG.getNode(ISD::AND, DL, MVT::i32, Diff, Mask));
+  return DAG.getNode(ISD::BITCAST, DL, VT, Result);
+}
+
+// VSELECT(mask, truevalue, falsevalue)
+// Convert the vector of booleans to a scalar bitmask and do a predicated
+// move.
+SDValue NyuziTargetLowering::LowerVSELECT(SDValue Op,
+                                          SelectionDAG &DAG) const {
+  SDLoc DL(Op);
+  MVT VT = Op.getValueType().getSimpleVT();
+  Intrinsic::ID MixID = VT.isFloatingPoint() ? Intrinsic::nyuzi_vector_mixf
+                                             : Intrinsic::nyuzi_vector_mixi;
+  return DAG.getNode(ISD::INTRINSIC_WO_CHAIN, DL, VT,
+                     DAG.getConstant(MixID, DL, MVT::i32),
+                     getScalarMask(Op.getOperand(0), DL, DAG),
+                     Op.getOperand(1), Op.getOperand(2));
 }
 
 SDValue NyuziTargetLowering::LowerSETCC(SDValue Op, SelectionDAG &DAG) const {
@@ -1022,14 +2198,14 @@ SDValue NyuziTargetLowering::LowerSETCC(SDValue Op, SelectionDAG &DAG) const {
   if (Op.getValueType().getSimpleVT() == MVT::v16i32)
     return expandVectorComparison(Op, DAG);
 
-  // Convert unordered or don't-care floating point comparisions to ordered
+  // Convert don't-care floating point comparisions to ordered
   // - Two comparison values are ordered if neither operand is NaN, otherwise
   //   they are unordered.
   // - An ordered comparison *operation* is always false if either operand is
   //   NaN. Unordered is always true if either operand is NaN.
-  // - The hardware implements ordered comparisons.
+  // - The hardware implements ordered comparisons. Other unordered
+  //   comparisons are matched by patterns (see InvertedFloatCompare).
   // - Clang usually emits ordered comparisons.
-  ISD::CondCode ComplementCompare;
   switch (CC) {
   // Return this node unchanged
   default:
@@ -1050,49 +2226,27 @@ SDValue NyuziTargetLowering::LowerSETCC(SDValue Op, SelectionDAG &DAG) const {
   case ISD::SETNE:
     return morphSETCCNode(Op, ISD::SETONE, DAG);
 
-  // Check for ordered and unordered values by using ordered equality
-  // (which will only be false if the values are unordered)
+  // A value is only unordered with itself if it is NaN, so check each
+  // operand with ordered equality (or unordered inequality for SETUO). The
+  // second operand is often a constant for isnan(), which doesn't need a
+  // check.
   case ISD::SETO:
   case ISD::SETUO: {
+    MVT VT = Op.getValueType().getSimpleVT();
+    ISD::CondCode SelfCC = CC == ISD::SETO ? ISD::SETOEQ : ISD::SETUNE;
     SDValue Op0 = Op.getOperand(0);
-    SDValue IsOrdered =
-        DAG.getNode(ISD::SETCC, DL, Op.getValueType().getSimpleVT(), Op0, Op0,
-                    DAG.getCondCode(ISD::SETOEQ));
-    if (CC == ISD::SETO)
-      return IsOrdered;
-
-    // SETUO
-    return DAG.getNode(ISD::XOR, DL, Op.getValueType().getSimpleVT(), IsOrdered,
-                       DAG.getConstant(0xffff, DL, MVT::i32));
+    SDValue Op1 = Op.getOperand(1);
+    SDValue Result =
+        DAG.getNode(ISD::SETCC, DL, VT, Op0, Op0, DAG.getCondCode(SelfCC));
+    ConstantFPSDNode *C = dyn_cast<ConstantFPSDNode>(Op1);
+    if (C && !C->isNaN())
+      return Result;
+
+    return DAG.getNode(CC == ISD::SETO ? ISD::AND : ISD::OR, DL, VT, Result,
+                       DAG.getNode(ISD::SETCC, DL, VT, Op1, Op1,
+                                   DAG.getCondCode(SelfCC)));
   }
-
-  // Convert unordered comparisions to ordered by explicitly checking for NaN
-  case ISD::SETUEQ:
-    ComplementCompare = ISD::SETONE;
-    break;
-  case ISD::SETUGT:
-    ComplementCompare = ISD::SETOLE;
-    break;
-  case ISD::SETUGE:
-    ComplementCompare = ISD::SETOLT;
-    break;
-  case ISD::SETULT:
-    ComplementCompare = ISD::SETOGE;
-    break;
-  case ISD::SETULE:
-    ComplementCompare = ISD::SETOGT;
-    break;
-  case ISD::SETUNE:
-    ComplementCompare = ISD::SETOEQ;
-    break;
   }
-
-  // Take the complementary comparision and invert the result. This will
-  // be the same for ordered values, but will always be true for unordered
-  // values.
-  SDValue Comp2 = morphSETCCNode(Op, ComplementCompare, DAG);
-  return DAG.getNode(ISD::XOR, DL, Op.getValueType().getSimpleVT(), Comp2,
-                     DAG.getConstant(0xffff, DL, MVT::i32));
 }
 
 SDValue NyuziTargetLowering::LowerConstantPool(SDValue Op,
@@ -1112,32 +2266,40 @@ SDValue NyuziTargetLowering::LowerConstantPool(SDValue Op,
   return Res;
 }
 
-//
-// XXX The intent of this function is to check if the immediate will fit in the
-// instruction or needs to be loaded from the constant pool. However, other
-// backends don't seem to need to do this. This may be overkill (it also
-// doens't work quite correctly, since we don't know which instruction this
-// will be used for, and thus don't know the capacity).
-//
+// Decide how an integer constant that instruction selection can't fold into
+// an immediate operand is put in a register. Uses that have an immediate field
+// (13 bits for most instructions) are matched directly by the instruction
+// patterns and never read the register. For the rest, a value that takes at
+// most kMaxImmediateCost move/shl/or instructions is selected as MOVESimm32.
+// Larger values are loaded from the constant pool. Both forms are
+// rematerializable, so the register allocator can recompute the value next
+// to a use instead of spilling it, and MachineCSE and MachineLICM can share
+// them between uses and hoist them out of loops.
 SDValue NyuziTargetLowering::LowerConstant(SDValue Op,
                                            SelectionDAG &DAG) const {
   SDLoc DL(Op);
   ConstantSDNode *C = cast<ConstantSDNode>(Op);
 
-  const int kMaxImmediateSize = 13;
-
-  if (C->getAPIntValue().abs().ult((1 << (kMaxImmediateSize - 1)) - 1)) {
-    // Don't need to convert to constant pool reference.  This will fit in
-    // the immediate field of a single instruction, sign extended.
+  int32_t Value = static_cast<int32_t>(C->getSExtValue());
+  if (Subtarget.getInstrInfo()->getImmediateCost(Value) <= kMaxImmediateCost)
     return Op;
-  }
 
-  // XXX New versions of LLVM will expand to a constant pool as the expand
-  // action, so this is probably unnecessary.
+  // Otherwise, load from the constant pool. This load is invariant, so
+  // MachineCSE and MachineLICM can share and hoist it.
   SDValue CPIdx = DAG.getConstantPool(C->getConstantIntValue(), MVT::i32);
   return DAG.getLoad(
       MVT::i32, DL, DAG.getEntryNode(), CPIdx,
-      MachinePointerInfo::getConstantPool(DAG.getMachineFunction()), 4);
+      MachinePointerInfo::getConstantPool(DAG.getMachineFunction()), 4,
+      MachineMemOperand::MOInvariant | MachineMemOperand::MODereferenceable);
+}
+
+bool NyuziTargetLowering::isFPImmLegal(const APFloat &Imm, EVT VT) const {
+  if (VT != MVT::f32)
+    return false;
+
+  int32_t Bits = static_cast<int32_t>(Imm.bitcastToAPInt().getZExtValue());
+  return Subtarget.getInstrInfo()->getImmediateCost(Bits) <=
+         kMaxImmediateCost;
 }
 
 // There is no native floating point division, but we can convert this to a
@@ -1148,24 +2310,20 @@ SDValue NyuziTargetLowering::LowerFDIV(SDValue Op, SelectionDAG &DAG) const {
 
   EVT Type = Op.getOperand(1).getValueType();
 
-  SDValue Two = DAG.getConstantFP(2.0, DL, Type);
-  SDValue Denominator = Op.getOperand(1);
-  SDValue Estimate =
-      DAG.getNode(NyuziISD::RECIPROCAL_EST, DL, Type, Denominator);
+  // Compute 1/divisor. Without a divide instruction this is needed even when
+  // estimates are disabled, but then it is always refined to full precision.
+  // A -mrecip step count is only honored when estimates are enabled for this
+  // type, either explicitly or by unsafe math, as the combiner does.
+  MachineFunction &MF = DAG.getMachineFunction();
+  int Enabled = getRecipEstimateDivEnabled(Type, MF);
+  int RefinementSteps = getDivRefinementSteps(Type, MF);
+  if (RefinementSteps == ReciprocalEstimate::Unspecified ||
+      Enabled == ReciprocalEstimate::Disabled ||
+      (Enabled == ReciprocalEstimate::Unspecified &&
+       !DAG.getTarget().Options.UnsafeFPMath))
+    RefinementSteps = 2;
 
-  // Perform a series of Newton Raphson refinements to determine 1/divisor. Each
-  // iteration doubles the precision of the result. The initial estimate has 6
-  // bits of precision, so two iterations results in 24 bits, which is larger
-  // than the (23 bit) significand.
-
-  for (int i = 0; i < 2; i++) {
-    // Trial = x * Estimate (our target is for x * 1/x to be 1.0)
-    // Error = 2.0 - Trial
-    // Estimate = Estimate * Error
-    SDValue Trial = DAG.getNode(ISD::FMUL, DL, Type, Estimate, Denominator);
-    SDValue Error = DAG.getNode(ISD::FSUB, DL, Type, Two, Trial);
-    Estimate = DAG.getNode(ISD::FMUL, DL, Type, Estimate, Error);
-  }
+  SDValue Estimate = buildReciprocal(Op.getOperand(1), RefinementSteps, DAG);
 
   // Check if the first parameter is constant 1.0.  If so, we don't need
   // to multiply by the dividend.
@@ -1257,6 +2415,21 @@ SDValue NyuziTargetLowering::LowerVASTART(SDValue Op, SelectionDAG &DAG) const {
                       MachinePointerInfo(SV));
 }
 
+// A data read prefetch is a load whose result is never used (see PREFETCH in
+// NyuziInstrInfo.td). Stores are written through to the L2 cache whether or
+// not the line is present in the L1 cache, so there is nothing to gain from a
+// write prefetch, and there is no way to load into the instruction cache.
+// Drop those.
+SDValue NyuziTargetLowering::LowerPREFETCH(SDValue Op,
+                                           SelectionDAG &DAG) const {
+  bool IsWrite = cast<ConstantSDNode>(Op.getOperand(2))->getZExtValue() != 0;
+  bool IsData = cast<ConstantSDNode>(Op.getOperand(4))->getZExtValue() != 0;
+  if (IsWrite || !IsData)
+    return Op.getOperand(0);
+
+  return Op;
+}
+
 SDValue NyuziTargetLowering::LowerCTLZ_ZERO_UNDEF(SDValue Op,
                                                   SelectionDAG &DAG) const {
   SDLoc DL(Op);
@@ -1323,8 +2496,7 @@ SDValue NyuziTargetLowering::LowerUINT_TO_FP(SDValue Op,
                      RVal, DAG.getConstant(0, DL, MVT::i32), ISD::SETLT);
     SDValue Adjusted =
         DAG.getNode(ISD::FADD, DL, MVT::f32, SignedVal, AdjustReg);
-    return DAG.getNode(NyuziISD::SEL_COND_RESULT, DL, MVT::f32, IsNegative,
-                       Adjusted, SignedVal);
+    return buildSelect(DL, IsNegative, Adjusted, SignedVal, DAG);
   }
 }
 
@@ -1377,6 +2549,140 @@ SDValue NyuziTargetLowering::LowerSIGN_EXTEND_INREG(SDValue Op,
   return expandVectorComparison(SetCcOp, DAG);
 }
 
+// Vector loads that are not known to be aligned can't use a block load. The
+// vectorizers generate these for contiguous array accesses.
+SDValue NyuziTargetLowering::LowerLOAD(SDValue Op, SelectionDAG &DAG) const {
+  LoadSDNode *Load = cast<LoadSDNode>(Op);
+  if (Load->getAlignment() >= 64 ||
+      Load->getExtensionType() != ISD::NON_EXTLOAD)
+    return SDValue(); // Legal
+
+  SDLoc DL(Op);
+  MVT VT = Op.getValueType().getSimpleVT();
+  Intrinsic::ID IntrinsicID = VT.isFloatingPoint()
+                                  ? Intrinsic::nyuzi_gather_loadf
+                                  : Intrinsic::nyuzi_gather_loadi;
+  SDValue Ops[] = {Load->getChain(), DAG.getConstant(IntrinsicID, DL, MVT::i32),
+                   getLaneAddresses(Load->getBasePtr(), DL, DAG)};
+  return DAG.getMemIntrinsicNode(ISD::INTRINSIC_W_CHAIN, DL,
+                                 DAG.getVTList(VT, MVT::Other), Ops,
+                                 Load->getMemoryVT(), Load->getMemOperand());
+}
+
+SDValue NyuziTargetLowering::LowerSTORE(SDValue Op, SelectionDAG &DAG) const {
+  StoreSDNode *Store = cast<StoreSDNode>(Op);
+  if (Store->getAlignment() >= 64 || Store->isTruncatingStore())
+    return SDValue(); // Legal
+
+  SDLoc DL(Op);
+  SDValue Value = Store->getValue();
+  Intrinsic::ID IntrinsicID = Value.getValueType().isFloatingPoint()
+                                  ? Intrinsic::nyuzi_scatter_storef
+                                  : Intrinsic::nyuzi_scatter_storei;
+  SDValue Ops[] = {Store->getChain(), DAG.getConstant(IntrinsicID, DL, MVT::i32),
+                   getLaneAddresses(Store->getBasePtr(), DL, DAG), Value};
+  return DAG.getMemIntrinsicNode(ISD::INTRINSIC_VOID, DL,
+                                 DAG.getVTList(MVT::Other), Ops,
+                                 Store->getMemoryVT(), Store->getMemOperand());
+}
+
+// Masked loads use a masked block load if the address is aligned and a masked
+// gather of consecutive addresses if it isn't.
+SDValue NyuziTargetLowering::LowerMLOAD(SDValue Op, SelectionDAG &DAG) const {
+  MaskedLoadSDNode *Load = cast<MaskedLoadSDNode>(Op);
+  assert(Load->getExtensionType() == ISD::NON_EXTLOAD &&
+         !Load->isExpandingLoad() && "unsupported masked load");
+
+  SDLoc DL(Op);
+  MVT VT = Op.getValueType().getSimpleVT();
+  SDValue Mask = getScalarMask(Load->getMask(), DL, DAG);
+  SDValue Ops[4] = {Load->getChain()};
+  if (Load->getAlignment() >= 64) {
+    Ops[1] = DAG.getConstant(VT.isFloatingPoint()
+                                 ? Intrinsic::nyuzi_block_loadf_masked
+                                 : Intrinsic::nyuzi_block_loadi_masked,
+                             DL, MVT::i32);
+    Ops[2] = Load->getBasePtr();
+  } else {
+    Ops[1] = DAG.getConstant(VT.isFloatingPoint()
+                                 ? Intrinsic::nyuzi_gather_loadf_masked
+                                 : Intrinsic::nyuzi_gather_loadi_masked,
+                             DL, MVT::i32);
+    Ops[2] = getLaneAddresses(Load->getBasePtr(), DL, DAG);
+  }
+
+  Ops[3] = Mask;
+  SDValue Result = DAG.getMemIntrinsicNode(
+      ISD::INTRINSIC_W_CHAIN, DL, DAG.getVTList(VT, MVT::Other), Ops,
+      Load->getMemoryVT(), Load->getMemOperand());
+  SDValue Merged = mergePassThru(Result, Load->getSrc0(), Mask, DL, DAG);
+  return DAG.getMergeValues({Merged, Result.getValue(1)}, DL);
+}
+
+SDValue NyuziTargetLowering::LowerMSTORE(SDValue Op, SelectionDAG &DAG) const {
+  MaskedStoreSDNode *Store = cast<MaskedStoreSDNode>(Op);
+  assert(!Store->isTruncatingStore() && !Store->isCompressingStore() &&
+         "unsupported masked store");
+
+  SDLoc DL(Op);
+  SDValue Value = Store->getValue();
+  bool IsFloat = Value.getValueType().isFloatingPoint();
+  SDValue Ops[5] = {Store->getChain()};
+  if (Store->getAlignment() >= 64) {
+    Ops[1] = DAG.getConstant(IsFloat ? Intrinsic::nyuzi_block_storef_masked
+                                     : Intrinsic::nyuzi_block_storei_masked,
+                             DL, MVT::i32);
+    Ops[2] = Store->getBasePtr();
+  } else {
+    Ops[1] = DAG.getConstant(IsFloat ? Intrinsic::nyuzi_scatter_storef_masked
+                                     : Intrinsic::nyuzi_scatter_storei_masked,
+                             DL, MVT::i32);
+    Ops[2] = getLaneAddresses(Store->getBasePtr(), DL, DAG);
+  }
+
+  Ops[3] = Value;
+  Ops[4] = getScalarMask(Store->getMask(), DL, DAG);
+  return DAG.getMemIntrinsicNode(ISD::INTRINSIC_VOID, DL,
+                                 DAG.getVTList(MVT::Other), Ops,
+                                 Store->getMemoryVT(), Store->getMemOperand());
+}
+
+SDValue NyuziTargetLowering::LowerMGATHER(SDValue Op, SelectionDAG &DAG) const {
+  MaskedGatherSDNode *Gather = cast<MaskedGatherSDNode>(Op);
+  SDLoc DL(Op);
+  MVT VT = Op.getValueType().getSimpleVT();
+  SDValue Mask = getScalarMask(Gather->getMask(), DL, DAG);
+  Intrinsic::ID IntrinsicID = VT.isFloatingPoint()
+                                  ? Intrinsic::nyuzi_gather_loadf_masked
+                                  : Intrinsic::nyuzi_gather_loadi_masked;
+  SDValue Ops[] = {Gather->getChain(),
+                   DAG.getConstant(IntrinsicID, DL, MVT::i32),
+                   getGatherScatterAddresses(Gather, DL, DAG), Mask};
+  SDValue Result = DAG.getMemIntrinsicNode(
+      ISD::INTRINSIC_W_CHAIN, DL, DAG.getVTList(VT, MVT::Other), Ops,
+      Gather->getMemoryVT(), Gather->getMemOperand());
+  SDValue Merged = mergePassThru(Result, Gather->getValue(), Mask, DL, DAG);
+  return DAG.getMergeValues({Merged, Result.getValue(1)}, DL);
+}
+
+SDValue NyuziTargetLowering::LowerMSCATTER(SDValue Op,
+                                           SelectionDAG &DAG) const {
+  MaskedScatterSDNode *Scatter = cast<MaskedScatterSDNode>(Op);
+  SDLoc DL(Op);
+  SDValue Value = Scatter->getValue();
+  Intrinsic::ID IntrinsicID = Value.getValueType().isFloatingPoint()
+                                  ? Intrinsic::nyuzi_scatter_storef_masked
+                                  : Intrinsic::nyuzi_scatter_storei_masked;
+  SDValue Ops[] = {Scatter->getChain(),
+                   DAG.getConstant(IntrinsicID, DL, MVT::i32),
+                   getGatherScatterAddresses(Scatter, DL, DAG), Value,
+                   getScalarMask(Scatter->getMask(), DL, DAG)};
+  return DAG.getMemIntrinsicNode(ISD::INTRINSIC_VOID, DL,
+                                 DAG.getVTList(MVT::Other), Ops,
+                                 Scatter->getMemoryVT(),
+                                 Scatter->getMemOperand());
+}
+
 MachineBasicBlock *
 NyuziTargetLowering::EmitSelectCC(MachineInstr &MI,
                                   MachineBasicBlock *BB) const {
@@ -1443,26 +2749,43 @@ NyuziTargetLowering::EmitSelectCC(MachineInstr &MI,
   return BB;
 }
 
+// Atomically add each lane of a vector to the address in the corresponding
+// lane of a pointer vector. Lanes that have the same address (for example,
+// pixels that fall into the same histogram bucket) are summed in registers
+// first, so there is only one load_sync/store_sync loop per unique address.
 MachineBasicBlock *
-NyuziTargetLowering::EmitAtomicBinary(MachineInstr &MI, MachineBasicBlock *BB,
-                                      unsigned Opcode) const {
+NyuziTargetLowering::EmitScatterAtomicAdd(MachineInstr &MI,
+                                          MachineBasicBlock *BB) const {
+  MachineFunction *MF = BB->getParent();
+  MachineRegisterInfo &MRI = MF->getRegInfo();
   const TargetInstrInfo *TII = Subtarget.getInstrInfo();
-
-  unsigned Dest = MI.getOperand(0).getReg();
-  unsigned Ptr = MI.getOperand(1).getReg();
   DebugLoc DL = MI.getDebugLoc();
-  MachineRegisterInfo &MRI = BB->getParent()->getRegInfo();
-  unsigned OldValue = MRI.createVirtualRegister(&Nyuzi::GPR32RegClass);
-  unsigned Success = MRI.createVirtualRegister(&Nyuzi::GPR32RegClass);
+  bool IsFloat = MI.getOpcode() == Nyuzi::SCATTER_ATOMIC_ADDF;
+  unsigned VectorAddOp = IsFloat ? Nyuzi::ADDFVVV : Nyuzi::ADDIVVV;
+  unsigned ScalarAddOp = IsFloat ? Nyuzi::ADDFSSS : Nyuzi::ADDISSS;
 
-  const BasicBlock *LLVM_BB = BB->getBasicBlock();
-  MachineFunction *MF = BB->getParent();
-  MachineFunction::iterator It = BB->getIterator();
-  ++It;
+  unsigned Ptrs = MI.getOperand(0).getReg();
+  unsigned Values = MI.getOperand(1).getReg();
+
+  auto NewScalarReg = [&MRI]() {
+    return MRI.createVirtualRegister(&Nyuzi::GPR32RegClass);
+  };
+  auto NewVectorReg = [&MRI]() {
+    return MRI.createVirtualRegister(&Nyuzi::VR512RegClass);
+  };
 
+  // insert new blocks after the current block
+  MachineBasicBlock *ThisMBB = BB;
+  const BasicBlock *LLVM_BB = BB->getBasicBlock();
+  MachineBasicBlock *HeaderMBB = MF->CreateMachineBasicBlock(LLVM_BB);
   MachineBasicBlock *LoopMBB = MF->CreateMachineBasicBlock(LLVM_BB);
+  MachineBasicBlock *TailMBB = MF->CreateMachineBasicBlock(LLVM_BB);
   MachineBasicBlock *ExitMBB = MF->CreateMachineBasicBlock(LLVM_BB);
+  MachineFunction::iterator It = BB->getIterator();
+  ++It;
+  MF->insert(It, HeaderMBB);
   MF->insert(It, LoopMBB);
+  MF->insert(It, TailMBB);
   MF->insert(It, ExitMBB);
 
   // Transfer the remainder of BB and its successor edges to ExitMBB.
@@ -1470,112 +2793,169 @@ NyuziTargetLowering::EmitAtomicBinary(MachineInstr &MI, MachineBasicBlock *BB,
                   std::next(MachineBasicBlock::iterator(MI)), BB->end());
   ExitMBB->transferSuccessorsAndUpdatePHIs(BB);
 
-  //  ThisMBB:
-  BB->addSuccessor(LoopMBB);
+  BB->addSuccessor(HeaderMBB);
+  HeaderMBB->addSuccessor(LoopMBB);
+  LoopMBB->addSuccessor(LoopMBB);
+  LoopMBB->addSuccessor(TailMBB);
+  TailMBB->addSuccessor(HeaderMBB);
+  TailMBB->addSuccessor(ExitMBB);
+
+  // ThisMBB:
+  //   Load the lane numbers <0, 1, ... 15> and compute the butterfly shuffle
+  //   indices (lane ^ 8, lane ^ 4, lane ^ 2, lane ^ 1) used to sum a group.
+  SmallVector<Constant *, 16> LaneIdValues;
+  for (int Lane = 0; Lane < 16; Lane++)
+    LaneIdValues.push_back(
+        ConstantInt::get(Type::getInt32Ty(MF->getFunction()->getContext()),
+                         Lane));
+
+  unsigned LaneIdCPI = MF->getConstantPool()->getConstantPoolIndex(
+      ConstantVector::get(LaneIdValues), 64);
+  unsigned LaneIds = NewVectorReg();
+  BuildMI(BB, DL, TII->get(Nyuzi::BLOCK_LOADI), LaneIds)
+      .addConstantPoolIndex(LaneIdCPI)
+      .addImm(0)
+      .addMemOperand(MF->getMachineMemOperand(
+          MachinePointerInfo::getConstantPool(*MF),
+          MachineMemOperand::MOLoad | MachineMemOperand::MOInvariant, 64,
+          64));
+
+  unsigned ButterflyIndices[4];
+  for (int Step = 0; Step < 4; Step++) {
+    ButterflyIndices[Step] = NewVectorReg();
+    BuildMI(BB, DL, TII->get(Nyuzi::XORVVI), ButterflyIndices[Step])
+        .addReg(LaneIds)
+        .addImm(8 >> Step);
+  }
 
-  //  LoopMBB:
-  BB = LoopMBB;
-  BuildMI(BB, DL, TII->get(Nyuzi::LOAD_SYNC), OldValue).addReg(Ptr).addImm(0);
-  BuildMI(BB, DL, TII->get(Nyuzi::MOVESS), Dest).addReg(OldValue);
-
-  unsigned NewValue;
-  if (Opcode != 0) {
-    // Perform an operation
-    NewValue = MRI.createVirtualRegister(&Nyuzi::GPR32RegClass);
-    if (MI.getOperand(2).getType() == MachineOperand::MO_Register)
-      BuildMI(BB, DL, TII->get(Opcode), NewValue)
-          .addReg(OldValue)
-          .addReg(MI.getOperand(2).getReg());
-    else if (MI.getOperand(2).getType() == MachineOperand::MO_Immediate)
-      BuildMI(BB, DL, TII->get(Opcode), NewValue)
-          .addReg(OldValue)
-          .addImm(MI.getOperand(2).getImm());
-    else
-      llvm_unreachable("Unknown operand type");
-  } else
-    NewValue = OldValue; // This is just swap: use old value
+  unsigned Zero = NewVectorReg();
+  BuildMI(BB, DL, TII->get(Nyuzi::MOVEVimm), Zero).addImm(0);
+  unsigned AllLanes = NewScalarReg();
+  BuildMI(BB, DL, TII->get(Nyuzi::MOVESimm32), AllLanes).addImm(0xffff);
+
+  // HeaderMBB:
+  //   Pick the highest numbered remaining lane: mask bit 15 corresponds to
+  //   lane 0, so the lowest set bit (count trailing zeroes) is the last
+  //   lane, and xoring the bit index with 15 gives the lane number.
+  //   Find all remaining lanes with the same address and sum their values.
+  unsigned Remaining = NewScalarReg();
+  unsigned NewRemaining = NewScalarReg();
+  unsigned Bit = NewScalarReg();
+  unsigned Lane = NewScalarReg();
+  unsigned Addr = NewScalarReg();
+  unsigned SameAddr = NewScalarReg();
+  unsigned Group = NewScalarReg();
+  BB = HeaderMBB;
+  BuildMI(BB, DL, TII->get(Nyuzi::PHI), Remaining)
+      .addReg(AllLanes)
+      .addMBB(ThisMBB)
+      .addReg(NewRemaining)
+      .addMBB(TailMBB);
+  BuildMI(BB, DL, TII->get(Nyuzi::CTZSS), Bit).addReg(Remaining);
+  BuildMI(BB, DL, TII->get(Nyuzi::XORSSI), Lane).addReg(Bit).addImm(15);
+  BuildMI(BB, DL, TII->get(Nyuzi::GET_LANEI), Addr).addReg(Ptrs).addReg(Lane);
+  BuildMI(BB, DL, TII->get(Nyuzi::SEQSIVS), SameAddr)
+      .addReg(Ptrs)
+      .addReg(Addr);
+  BuildMI(BB, DL, TII->get(Nyuzi::ANDSSS), Group)
+      .addReg(SameAddr)
+      .addReg(Remaining);
+  BuildMI(BB, DL, TII->get(Nyuzi::XORSSS), NewRemaining)
+      .addReg(Remaining)
+      .addReg(Group);
+
+  unsigned Sum = NewVectorReg();
+  BuildMI(BB, DL, TII->get(Nyuzi::MOVEVVMI), Sum)
+      .addReg(Group)
+      .addReg(Values)
+      .addReg(Zero);
+  for (int Step = 0; Step < 4; Step++) {
+    unsigned Shuffled = NewVectorReg();
+    unsigned NewSum = NewVectorReg();
+    BuildMI(BB, DL, TII->get(Nyuzi::SHUFFLEI), Shuffled)
+        .addReg(Sum)
+        .addReg(ButterflyIndices[Step]);
+    BuildMI(BB, DL, TII->get(VectorAddOp), NewSum)
+        .addReg(Sum)
+        .addReg(Shuffled);
+    Sum = NewSum;
+  }
 
+  unsigned Total = NewScalarReg();
+  BuildMI(BB, DL, TII->get(Nyuzi::GET_LANEIimm), Total).addReg(Sum).addImm(0);
+
+  // LoopMBB:
+  //   load_sync OldValue, (Addr)
+  //   add NewValue, OldValue, Total
+  //   store_sync NewValue, (Addr)
+  //   bz Success, LoopMBB
+  unsigned OldValue = NewScalarReg();
+  unsigned NewValue = NewScalarReg();
+  unsigned Success = NewScalarReg();
+  BB = LoopMBB;
+  BuildMI(BB, DL, TII->get(Nyuzi::LOAD_SYNC), OldValue).addReg(Addr).addImm(0);
+  BuildMI(BB, DL, TII->get(ScalarAddOp), NewValue)
+      .addReg(OldValue)
+      .addReg(Total);
   BuildMI(BB, DL, TII->get(Nyuzi::STORE_SYNC), Success)
       .addReg(NewValue)
-      .addReg(Ptr)
+      .addReg(Addr)
       .addImm(0);
   BuildMI(BB, DL, TII->get(Nyuzi::BZ)).addReg(Success).addMBB(LoopMBB);
-  BB->addSuccessor(LoopMBB);
-  BB->addSuccessor(ExitMBB);
 
-  //  ExitMBB:
-  BB = ExitMBB;
+  // TailMBB:
+  //   bnz NewRemaining, HeaderMBB
+  BB = TailMBB;
+  BuildMI(BB, DL, TII->get(Nyuzi::BNZ)).addReg(NewRemaining).addMBB(HeaderMBB);
 
   MI.eraseFromParent(); // The instruction is gone now.
 
-  return BB;
+  return ExitMBB;
 }
 
-MachineBasicBlock *
-NyuziTargetLowering::EmitAtomicCmpSwap(MachineInstr &MI,
-                                       MachineBasicBlock *BB) const {
-  MachineFunction *MF = BB->getParent();
-  MachineRegisterInfo &RegInfo = MF->getRegInfo();
-  const TargetRegisterClass *RC = getRegClassFor(MVT::i32);
-  const TargetInstrInfo *TII = Subtarget.getInstrInfo();
-  DebugLoc DL = MI.getDebugLoc();
-
-  unsigned Dest = MI.getOperand(0).getReg();
-  unsigned Ptr = MI.getOperand(1).getReg();
-  unsigned OldVal = MI.getOperand(2).getReg();
-  unsigned NewVal = MI.getOperand(3).getReg();
-
-  unsigned Success = RegInfo.createVirtualRegister(RC);
-  unsigned CmpResult = RegInfo.createVirtualRegister(RC);
-
-  // insert new blocks after the current block
-  const BasicBlock *LLVM_BB = BB->getBasicBlock();
-  MachineBasicBlock *Loop1MBB = MF->CreateMachineBasicBlock(LLVM_BB);
-  MachineBasicBlock *Loop2MBB = MF->CreateMachineBasicBlock(LLVM_BB);
-  MachineBasicBlock *ExitMBB = MF->CreateMachineBasicBlock(LLVM_BB);
-  MachineFunction::iterator It = BB->getIterator();
-  ++It;
-  MF->insert(It, Loop1MBB);
-  MF->insert(It, Loop2MBB);
-  MF->insert(It, ExitMBB);
-
-  // Transfer the remainder of BB and its successor edges to ExitMBB.
-  ExitMBB->splice(ExitMBB->begin(), BB,
-                  std::next(MachineBasicBlock::iterator(MI)), BB->end());
-  ExitMBB->transferSuccessorsAndUpdatePHIs(BB);
-
-  //  ThisMBB:
-  //    ...
-  //    fallthrough --> Loop1MBB
-  BB->addSuccessor(Loop1MBB);
-  Loop1MBB->addSuccessor(ExitMBB);
-  Loop1MBB->addSuccessor(Loop2MBB);
-  Loop2MBB->addSuccessor(Loop1MBB);
-  Loop2MBB->addSuccessor(ExitMBB);
-
-  // Loop1MBB:
-  //   load.sync Dest, 0(Ptr)
-  //   setne cmpresult, Dest, oldval
-  //   btrue cmpresult, ExitMBB
-  BB = Loop1MBB;
-  BuildMI(BB, DL, TII->get(Nyuzi::LOAD_SYNC), Dest).addReg(Ptr).addImm(0);
-  BuildMI(BB, DL, TII->get(Nyuzi::SNESISS), CmpResult)
-      .addReg(Dest)
-      .addReg(OldVal);
-  BuildMI(BB, DL, TII->get(Nyuzi::BNZ)).addReg(CmpResult).addMBB(ExitMBB);
-
-  // Loop2MBB:
-  //   move success, newval			; need a temporary because
-  //   store.sync success, 0(Ptr)	; store.sync will clobber success
-  //   bfalse success, Loop1MBB
-  BB = Loop2MBB;
-  BuildMI(BB, DL, TII->get(Nyuzi::STORE_SYNC), Success)
-      .addReg(NewVal)
-      .addReg(Ptr)
-      .addImm(0);
-  BuildMI(BB, DL, TII->get(Nyuzi::BZ)).addReg(Success).addMBB(Loop1MBB);
-
-  MI.eraseFromParent(); // The instruction is gone now.
+// Expand v16f32 math functions inline, rather than calling the scalar library
+// function for each lane.
+SDValue NyuziTargetLowering::LowerVectorMath(SDValue Op,
+                                             SelectionDAG &DAG) const {
+  SDLoc DL(Op);
+  VectorMathBuilder Builder(DAG, DL);
+  bool Fast = VectorMath == VectorMathFast;
+  SDValue X = Op.getOperand(0);
+  switch (Op.getOpcode()) {
+  case ISD::FFLOOR:
+    return Builder.floor(X);
+  case ISD::FSQRT:
+    return Builder.sqrt(X, Fast);
+  case ISD::FSIN:
+    return Builder.sinCos(X, false, Fast);
+  case ISD::FCOS:
+    return Builder.sinCos(X, true, Fast);
+  case ISD::FEXP:
+    return Builder.exp(X, Fast);
+  case ISD::FEXP2:
+    return Builder.exp2(X, Fast);
+  case ISD::FLOG:
+    return Builder.log(X, Fast);
+  case ISD::FLOG2:
+    return Builder.log2(X, Fast);
+  default:
+    llvm_unreachable("unexpected vector math operation");
+  }
+}
 
-  return ExitMBB;
+// Expand v16i32 division and remainder inline, rather than calling the
+// scalar library function for each lane.
+SDValue NyuziTargetLowering::LowerVectorDivRem(SDValue Op,
+                                               SelectionDAG &DAG) const {
+  SDLoc DL(Op);
+  VectorMathBuilder Builder(DAG, DL);
+  SDValue Quotient;
+  SDValue Remainder;
+  unsigned Opcode = Op.getOpcode();
+  if (Opcode == ISD::UDIV || Opcode == ISD::UREM)
+    Builder.udivrem(Op.getOperand(0), Op.getOperand(1), Quotient, Remainder);
+  else
+    Builder.sdivrem(Op.getOperand(0), Op.getOperand(1), Quotient, Remainder);
+
+  return Opcode == ISD::UDIV || Opcode == ISD::SDIV ? Quotient : Remainder;
 }
@@ -31,6 +31,9 @@
 #define GET_INSTRINFO_CTOR_DTOR
 #include "NyuziGenInstrInfo.inc"
 
+#define GET_INSTRMAP_INFO
+#include "NyuziGenInstrInfo.inc"
+
 using namespace llvm;
 
 namespace {
@@ -43,6 +46,58 @@ bool isCondBranchOpcode(int opc) {
 }
 
 bool isJumpTableBranchOpcode(int opc) { return opc == Nyuzi::JUMP_TABLE; }
+
+bool isScalarMemoryOpcode(unsigned Opcode) {
+  switch (Opcode) {
+  case Nyuzi::LBS:
+  case Nyuzi::LBU:
+  case Nyuzi::LSS:
+  case Nyuzi::LSU:
+  case Nyuzi::LW:
+  case Nyuzi::SB:
+  case Nyuzi::SS:
+  case Nyuzi::SW:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool isBlockMemoryOpcode(unsigned Opcode) {
+  return Opcode == Nyuzi::BLOCK_LOADI || Opcode == Nyuzi::BLOCK_STOREI;
+}
+
+struct ImmediateStep {
+  unsigned Opcode;
+  int32_t Imm;
+};
+
+// Break a constant into a move of a 13 bit signed immediate, followed by
+// shifts and ors. The or immediate is also sign extended, so each or can
+// only fill in 12 bits.
+void getImmediateSteps(int32_t Value, SmallVectorImpl<ImmediateStep> &Steps) {
+  if (isInt<13>(Value)) {
+    Steps.push_back({Nyuzi::MOVESimm, Value});
+    return;
+  }
+
+  // A small value shifted left, which includes many float constants.
+  unsigned Shift = countTrailingZeros(static_cast<uint32_t>(Value));
+  if (isInt<13>(Value >> Shift)) {
+    Steps.push_back({Nyuzi::MOVESimm, Value >> Shift});
+    Steps.push_back({Nyuzi::SLLSSI, static_cast<int32_t>(Shift)});
+    return;
+  }
+
+  getImmediateSteps(Value >> 12, Steps);
+  if (Steps.back().Opcode == Nyuzi::SLLSSI)
+    Steps.back().Imm += 12;
+  else
+    Steps.push_back({Nyuzi::SLLSSI, 12});
+
+  if (Value & 0xfff)
+    Steps.push_back({Nyuzi::ORSSI, Value & 0xfff});
+}
 }
 
 const NyuziInstrInfo *NyuziInstrInfo::create(NyuziSubtarget &ST) {
@@ -151,8 +206,7 @@ void NyuziInstrInfo::adjustStackPointer(MachineBasicBlock &MBB,
         .addImm(Amount);
   } else {
     unsigned int OffsetReg = loadConstant(MBB, MBBI, Amount);
-    BuildMI(MBB, MBBI, DL, get(Nyuzi::ADDISSS))
-        .addReg(Nyuzi::SP_REG)
+    BuildMI(MBB, MBBI, DL, get(Nyuzi::ADDISSS), Nyuzi::SP_REG)
         .addReg(Nyuzi::SP_REG)
         .addReg(OffsetReg);
   }
@@ -321,31 +375,92 @@ void NyuziInstrInfo::copyPhysReg(MachineBasicBlock &MBB,
       .addReg(SrcReg, getKillRegState(KillSrc));
 }
 
+bool NyuziInstrInfo::getMemOpBaseRegImmOfs(
+    MachineInstr &MemOp, unsigned &BaseReg, int64_t &Offset,
+    const TargetRegisterInfo *TRI) const {
+  unsigned Opcode = MemOp.getOpcode();
+  if (!isScalarMemoryOpcode(Opcode) && !isBlockMemoryOpcode(Opcode))
+    return false;
+
+  // Operand 0 is the value loaded or stored, followed by the base and offset.
+  // The base is a frame index until frame lowering has run.
+  if (!MemOp.getOperand(1).isReg() || !MemOp.getOperand(2).isImm())
+    return false;
+
+  BaseReg = MemOp.getOperand(1).getReg();
+  Offset = MemOp.getOperand(2).getImm();
+  return true;
+}
+
+// Scheduling accesses to the same base register next to each other lets the
+// memory pipeline overlap cache misses from the same line. Only cluster
+// accesses of the same width, and stop before a cluster becomes long enough
+// to stall on the results.
+bool NyuziInstrInfo::shouldClusterMemOps(MachineInstr &FirstLdSt,
+                                         MachineInstr &SecondLdSt,
+                                         unsigned NumLoads) const {
+  if (NumLoads > 4)
+    return false;
+
+  return isBlockMemoryOpcode(FirstLdSt.getOpcode()) ==
+         isBlockMemoryOpcode(SecondLdSt.getOpcode());
+}
+
+unsigned NyuziInstrInfo::getMemoryOffsetBits(unsigned Opcode) const {
+  switch (Opcode) {
+  case Nyuzi::INT_BLOCK_LOADI_MASKED:
+  case Nyuzi::INT_BLOCK_STOREI_MASKED:
+    return 10;
+
+  default:
+    return 13;
+  }
+}
+
 // Load constant larger than immediate field (13 bits signed)
 unsigned int NyuziInstrInfo::loadConstant(MachineBasicBlock &MBB,
                                           MachineBasicBlock::iterator MBBI,
                                           int Value) const {
 
   MachineRegisterInfo &RegInfo = MBB.getParent()->getRegInfo();
-  DebugLoc DL = MBBI->getDebugLoc();
   unsigned Reg = RegInfo.createVirtualRegister(&Nyuzi::GPR32RegClass);
+  materializeImmediate(MBB, MBBI, MBBI->getDebugLoc(), Reg, Value);
+  return Reg;
+}
 
-  if (!isInt<24>(Value))
-    report_fatal_error("NyuziInstrInfo::loadConstant: value out of range");
-
-  BuildMI(MBB, MBBI, DL, get(Nyuzi::MOVESimm), Reg).addImm(Value >> 12);
-  BuildMI(MBB, MBBI, DL, get(Nyuzi::SLLSSI)).addReg(Reg).addReg(Reg).addImm(12);
+unsigned NyuziInstrInfo::getImmediateCost(int32_t Value) const {
+  SmallVector<ImmediateStep, 5> Steps;
+  getImmediateSteps(Value, Steps);
+  return Steps.size();
+}
 
-  if ((Value & 0xfff) != 0) {
-    // Load bits 11-0 into register (note we only load 12 bits because we
-    // don't want sign extension)
-    BuildMI(MBB, MBBI, DL, get(Nyuzi::ORSSI))
-        .addReg(Reg)
-        .addReg(Reg)
-        .addImm(Value & 0xfff);
+void NyuziInstrInfo::materializeImmediate(MachineBasicBlock &MBB,
+                                          MachineBasicBlock::iterator MBBI,
+                                          const DebugLoc &DL, unsigned DestReg,
+                                          int32_t Value) const {
+  SmallVector<ImmediateStep, 5> Steps;
+  getImmediateSteps(Value, Steps);
+  for (const ImmediateStep &Step : Steps) {
+    MachineInstrBuilder MIB = BuildMI(MBB, MBBI, DL, get(Step.Opcode), DestReg);
+    if (Step.Opcode != Nyuzi::MOVESimm)
+      MIB.addReg(DestReg);
+
+    MIB.addImm(Step.Imm);
   }
+}
 
-  return Reg;
+bool NyuziInstrInfo::expandPostRAPseudo(MachineInstr &MI) const {
+  switch (MI.getOpcode()) {
+  case Nyuzi::MOVESimm32:
+    materializeImmediate(*MI.getParent(), MI, MI.getDebugLoc(),
+                         MI.getOperand(0).getReg(),
+                         static_cast<int32_t>(MI.getOperand(1).getImm()));
+    MI.eraseFromParent();
+    return true;
+
+  default:
+    return false;
+  }
 }
 
 MachineMemOperand *
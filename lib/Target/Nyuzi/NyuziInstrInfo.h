@@ -69,6 +69,29 @@ public:
   void copyPhysReg(MachineBasicBlock &MBB, MachineBasicBlock::iterator I,
                    const DebugLoc &DL, unsigned DestReg, unsigned SrcReg,
                    bool KillSrc) const override;
+  bool getMemOpBaseRegImmOfs(MachineInstr &MemOp, unsigned &BaseReg,
+                             int64_t &Offset,
+                             const TargetRegisterInfo *TRI) const override;
+  bool shouldClusterMemOps(MachineInstr &FirstLdSt, MachineInstr &SecondLdSt,
+                           unsigned NumLoads) const override;
+
+  bool expandPostRAPseudo(MachineInstr &MI) const override;
+
+  /// getMemoryOffsetBits - Return the number of bits available to encode a
+  /// signed immediate offset in the memory operand of the given load or store
+  /// instruction.
+  unsigned getMemoryOffsetBits(unsigned Opcode) const;
+
+  /// getImmediateCost - Return the number of instructions
+  /// materializeImmediate uses to build Value.
+  unsigned getImmediateCost(int32_t Value) const;
+
+  /// materializeImmediate - Load an arbitrary 32 bit constant into DestReg
+  /// with a move followed by shifts and ors.
+  void materializeImmediate(MachineBasicBlock &MBB,
+                            MachineBasicBlock::iterator MBBI,
+                            const DebugLoc &DL, unsigned DestReg,
+                            int32_t Value) const;
 
 private:
   unsigned int loadConstant(MachineBasicBlock &MBB,
@@ -77,6 +100,13 @@ private:
                                    MachineMemOperand::Flags) const;
   const NyuziRegisterInfo RI;
 };
+
+namespace Nyuzi {
+/// getMaskedOpcode - Return the predicated form of an unmasked vector
+/// instruction, or -1 if there isn't one.
+LLVM_READONLY
+int getMaskedOpcode(uint16_t Opcode);
+}
 }
 
 #endif
@@ -38,12 +38,18 @@ NyuziRegisterInfo::NyuziRegisterInfo() : NyuziGenRegisterInfo(Nyuzi::FP_REG) {}
 
 const uint16_t *
 NyuziRegisterInfo::getCalleeSavedRegs(const MachineFunction *MF) const {
+  if (MF->getFunction()->getCallingConv() == CallingConv::PreserveMost)
+    return NyuziPreserveMostCSR_SaveList;
+
   return NyuziCSR_SaveList;
 }
 
 const uint32_t *
 NyuziRegisterInfo::getCallPreservedMask(const MachineFunction &MF,
-                                        CallingConv::ID) const {
+                                        CallingConv::ID CC) const {
+  if (CC == CallingConv::PreserveMost)
+    return NyuziPreserveMostCSR_RegMask;
+
   return NyuziCSR_RegMask;
 }
 
@@ -71,11 +77,10 @@ void NyuziRegisterInfo::eliminateFrameIndex(MachineBasicBlock::iterator MBBI,
   MachineInstr &MI = *MBBI;
   int FrameIndex = MI.getOperand(FIOperandNum).getIndex();
   MachineFunction &MF = *MI.getParent()->getParent();
-  const TargetFrameLowering &TFL = *MF.getSubtarget().getFrameLowering();
   MachineFrameInfo &MFI = MF.getFrameInfo();
 
-  // Round stack size to multiple of 64, consistent with frame pointer info.
-  int stackSize = alignTo(MFI.getStackSize(), TFL.getStackAlignment());
+  // This is already rounded by PEI, consistent with the prologue.
+  int stackSize = MFI.getStackSize();
 
   // Frame index is relative to where SP is before it is decremented on
   // entry to the function.  Need to add stackSize to adjust for this.
@@ -99,8 +104,14 @@ void NyuziRegisterInfo::eliminateFrameIndex(MachineBasicBlock::iterator MBBI,
   else
     FrameReg = getFrameRegister(MF);
 
+  // Masked block loads and stores have a narrower offset field than the
+  // other memory instructions.
+  const NyuziInstrInfo &TII =
+      *static_cast<const NyuziInstrInfo *>(MF.getSubtarget().getInstrInfo());
+  unsigned OffsetBits = TII.getMemoryOffsetBits(MI.getOpcode());
+
   // Replace frame index with a frame pointer reference.
-  if (isInt<13>(Offset)) {
+  if (isIntN(OffsetBits, Offset)) {
     // If the offset is small enough to fit in the immediate field, directly
     // encode it.
     MI.getOperand(FIOperandNum).ChangeToRegister(FrameReg, false);
@@ -108,18 +119,25 @@ void NyuziRegisterInfo::eliminateFrameIndex(MachineBasicBlock::iterator MBBI,
   } else if (isInt<25>(Offset)) {
     DebugLoc DL = MBBI->getDebugLoc();
     MachineBasicBlock &MBB = *MBBI->getParent();
-    const NyuziInstrInfo &TII =
-        *static_cast<const NyuziInstrInfo *>(MF.getSubtarget().getInstrInfo());
-
     MachineRegisterInfo &RegInfo = MBB.getParent()->getRegInfo();
     unsigned Reg = RegInfo.createVirtualRegister(&Nyuzi::GPR32RegClass);
+    int64_t LowOffset = Offset & 0xfff;
     BuildMI(MBB, MBBI, DL, TII.get(Nyuzi::MOVESimm), Reg).addImm(Offset >> 12);
     BuildMI(MBB, MBBI, DL, TII.get(Nyuzi::SLLSSI), Reg).addReg(Reg).addImm(12);
+    if (!isIntN(OffsetBits, LowOffset)) {
+      // The low bits don't fit in the instruction either. Fold them into
+      // the base register.
+      BuildMI(MBB, MBBI, DL, TII.get(Nyuzi::ORSSI), Reg)
+          .addReg(Reg)
+          .addImm(LowOffset);
+      LowOffset = 0;
+    }
+
     BuildMI(MBB, MBBI, DL, TII.get(Nyuzi::ADDISSS), Reg)
         .addReg(FrameReg)
         .addReg(Reg);
     MI.getOperand(FIOperandNum).ChangeToRegister(Reg, false);
-    MI.getOperand(FIOperandNum + 1).ChangeToImmediate(Offset & 0xfff);
+    MI.getOperand(FIOperandNum + 1).ChangeToImmediate(LowOffset);
   } else
     report_fatal_error("frame index out of bounds: frame too large");
 }
@@ -0,0 +1,264 @@
+//===-- NyuziSelectionDAGInfo.cpp - Nyuzi SelectionDAG Info ---------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the NyuziSelectionDAGInfo class, which lowers memcpy,
+// memmove, and memset to 64-byte block loads and stores.
+//
+//===----------------------------------------------------------------------===//
+
+#include "NyuziSelectionDAGInfo.h"
+#include "NyuziISelLowering.h"
+#include "llvm/CodeGen/SelectionDAG.h"
+#include "llvm/IR/Intrinsics.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "nyuzi-selectiondag-info"
+
+namespace {
+
+// Block loads and stores transfer one vector register and must be aligned to
+// its size.
+const unsigned kBlockSize = 64;
+
+// Larger operations call the library, which uses a loop.
+const unsigned kMaxInlineBlocks = 16;
+
+const unsigned kAllLanes = 0xffff;
+
+// Lane 0 is the most significant bit of the mask.
+unsigned getLeadingLanesMask(unsigned NumLanes) {
+  return ((1u << NumLanes) - 1) << (16 - NumLanes);
+}
+
+SDValue getOffsetPointer(SDValue Ptr, uint64_t Offset, const SDLoc &DL,
+                         SelectionDAG &DAG) {
+  if (Offset == 0)
+    return Ptr;
+
+  EVT VT = Ptr.getValueType();
+  return DAG.getNode(ISD::ADD, DL, VT, Ptr, DAG.getConstant(Offset, DL, VT));
+}
+
+SDValue getMaskedBlockLoad(SDValue Chain, SDValue Ptr, SDValue Mask,
+                           MachinePointerInfo PtrInfo, bool IsVolatile,
+                           const SDLoc &DL, SelectionDAG &DAG) {
+  SDValue Ops[] = {
+      Chain,
+      DAG.getConstant(Intrinsic::nyuzi_block_loadi_masked, DL, MVT::i32), Ptr,
+      Mask};
+  return DAG.getMemIntrinsicNode(
+      ISD::INTRINSIC_W_CHAIN, DL, DAG.getVTList(MVT::v16i32, MVT::Other), Ops,
+      MVT::v16i32, PtrInfo, kBlockSize, IsVolatile, /*ReadMem=*/true,
+      /*WriteMem=*/false);
+}
+
+SDValue getMaskedBlockStore(SDValue Chain, SDValue Value, SDValue Ptr,
+                            SDValue Mask, MachinePointerInfo PtrInfo,
+                            bool IsVolatile, const SDLoc &DL,
+                            SelectionDAG &DAG) {
+  SDValue Ops[] = {
+      Chain,
+      DAG.getConstant(Intrinsic::nyuzi_block_storei_masked, DL, MVT::i32), Ptr,
+      Value, Mask};
+  return DAG.getMemIntrinsicNode(ISD::INTRINSIC_VOID, DL,
+                                 DAG.getVTList(MVT::Other), Ops, MVT::v16i32,
+                                 PtrInfo, kBlockSize, IsVolatile,
+                                 /*ReadMem=*/false, /*WriteMem=*/true);
+}
+
+// Returns the size if the operation can be done with a small number of block
+// accesses, or zero otherwise. A partial last block is done with a masked
+// access, so the size must be a whole number of words.
+uint64_t getInlineBlockSize(SDValue Size) {
+  ConstantSDNode *ConstSize = dyn_cast<ConstantSDNode>(Size);
+  if (!ConstSize)
+    return 0;
+
+  uint64_t Bytes = ConstSize->getZExtValue();
+  if (Bytes < kBlockSize || Bytes > kMaxInlineBlocks * kBlockSize ||
+      Bytes % 4 != 0)
+    return 0;
+
+  return Bytes;
+}
+
+// Copy between two block aligned buffers. All loads are issued before any
+// stores, so this is also correct if the buffers overlap.
+SDValue emitBlockCopy(SDValue Chain, SDValue Dst, SDValue Src, uint64_t Bytes,
+                      bool IsVolatile, MachinePointerInfo DstPtrInfo,
+                      MachinePointerInfo SrcPtrInfo, const SDLoc &DL,
+                      SelectionDAG &DAG) {
+  MachineMemOperand::Flags MMOFlags =
+      IsVolatile ? MachineMemOperand::MOVolatile : MachineMemOperand::MONone;
+  uint64_t WholeBytes = Bytes - Bytes % kBlockSize;
+  unsigned TailLanes = (Bytes % kBlockSize) / 4;
+  SDValue TailMask = DAG.getConstant(getLeadingLanesMask(TailLanes), DL,
+                                     MVT::i32);
+
+  SmallVector<SDValue, kMaxInlineBlocks + 1> Values;
+  SmallVector<SDValue, kMaxInlineBlocks + 1> Chains;
+  for (uint64_t Offset = 0; Offset < Bytes; Offset += kBlockSize) {
+    SDValue Ptr = getOffsetPointer(Src, Offset, DL, DAG);
+    MachinePointerInfo PtrInfo = SrcPtrInfo.getWithOffset(Offset);
+    SDValue Value;
+    if (Offset < WholeBytes)
+      Value = DAG.getLoad(MVT::v16i32, DL, Chain, Ptr, PtrInfo, kBlockSize,
+                          MMOFlags);
+    else
+      Value = getMaskedBlockLoad(Chain, Ptr, TailMask, PtrInfo, IsVolatile,
+                                 DL, DAG);
+
+    Values.push_back(Value);
+    Chains.push_back(Value.getValue(1));
+  }
+
+  Chain = DAG.getNode(ISD::TokenFactor, DL, MVT::Other, Chains);
+  Chains.clear();
+  for (uint64_t Offset = 0, I = 0; Offset < Bytes; Offset += kBlockSize, ++I) {
+    SDValue Ptr = getOffsetPointer(Dst, Offset, DL, DAG);
+    MachinePointerInfo PtrInfo = DstPtrInfo.getWithOffset(Offset);
+    if (Offset < WholeBytes)
+      Chains.push_back(DAG.getStore(Chain, DL, Values[I], Ptr, PtrInfo,
+                                    kBlockSize, MMOFlags));
+    else
+      Chains.push_back(getMaskedBlockStore(Chain, Values[I], Ptr, TailMask,
+                                           PtrInfo, IsVolatile, DL, DAG));
+  }
+
+  return DAG.getNode(ISD::TokenFactor, DL, MVT::Other, Chains);
+}
+
+} // namespace
+
+SDValue NyuziSelectionDAGInfo::EmitTargetCodeForMemcpy(
+    SelectionDAG &DAG, const SDLoc &DL, SDValue Chain, SDValue Dst, SDValue Src,
+    SDValue Size, unsigned Align, bool IsVolatile, bool AlwaysInline,
+    MachinePointerInfo DstPtrInfo, MachinePointerInfo SrcPtrInfo) const {
+  // The source and destination may be misaligned relative to each other, and
+  // there is no cheap way to shift data between lanes on the way through.
+  uint64_t Bytes = getInlineBlockSize(Size);
+  if (Align < kBlockSize || Bytes == 0)
+    return SDValue();
+
+  return emitBlockCopy(Chain, Dst, Src, Bytes, IsVolatile, DstPtrInfo,
+                       SrcPtrInfo, DL, DAG);
+}
+
+SDValue NyuziSelectionDAGInfo::EmitTargetCodeForMemmove(
+    SelectionDAG &DAG, const SDLoc &DL, SDValue Chain, SDValue Dst, SDValue Src,
+    SDValue Size, unsigned Align, bool IsVolatile,
+    MachinePointerInfo DstPtrInfo, MachinePointerInfo SrcPtrInfo) const {
+  uint64_t Bytes = getInlineBlockSize(Size);
+  if (Align < kBlockSize || Bytes == 0)
+    return SDValue();
+
+  return emitBlockCopy(Chain, Dst, Src, Bytes, IsVolatile, DstPtrInfo,
+                       SrcPtrInfo, DL, DAG);
+}
+
+SDValue NyuziSelectionDAGInfo::EmitTargetCodeForMemset(
+    SelectionDAG &DAG, const SDLoc &DL, SDValue Chain, SDValue Dst,
+    SDValue Value, SDValue Size, unsigned Align, bool IsVolatile,
+    MachinePointerInfo DstPtrInfo) const {
+  uint64_t Bytes = getInlineBlockSize(Size);
+  if (Align < 4 || Bytes == 0)
+    return SDValue();
+
+  // Partially covered blocks may be written more than once below.
+  if (Align < kBlockSize && IsVolatile)
+    return SDValue();
+
+  MachineMemOperand::Flags MMOFlags =
+      IsVolatile ? MachineMemOperand::MOVolatile : MachineMemOperand::MONone;
+  EVT PtrVT = Dst.getValueType();
+
+  // Replicate the byte into every byte of every lane.
+  SDValue Word;
+  if (ConstantSDNode *ConstValue = dyn_cast<ConstantSDNode>(Value))
+    Word = DAG.getConstant((ConstValue->getZExtValue() & 0xff) * 0x01010101,
+                           DL, MVT::i32);
+  else
+    Word = DAG.getNode(ISD::MUL, DL, MVT::i32,
+                       DAG.getZExtOrTrunc(Value, DL, MVT::i32),
+                       DAG.getConstant(0x01010101, DL, MVT::i32));
+
+  SDValue Fill = DAG.getNode(NyuziISD::SPLAT, DL, MVT::v16i32, Word);
+  SmallVector<SDValue, kMaxInlineBlocks + 1> Chains;
+
+  if (Align >= kBlockSize) {
+    uint64_t WholeBytes = Bytes - Bytes % kBlockSize;
+    for (uint64_t Offset = 0; Offset < WholeBytes; Offset += kBlockSize)
+      Chains.push_back(DAG.getStore(Chain, DL, Fill,
+                                    getOffsetPointer(Dst, Offset, DL, DAG),
+                                    DstPtrInfo.getWithOffset(Offset),
+                                    kBlockSize, MMOFlags));
+
+    if (WholeBytes != Bytes) {
+      unsigned TailLanes = (Bytes - WholeBytes) / 4;
+      Chains.push_back(getMaskedBlockStore(
+          Chain, Fill, getOffsetPointer(Dst, WholeBytes, DL, DAG),
+          DAG.getConstant(getLeadingLanesMask(TailLanes), DL, MVT::i32),
+          DstPtrInfo.getWithOffset(WholeBytes), IsVolatile, DL, DAG));
+    }
+
+    return DAG.getNode(ISD::TokenFactor, DL, MVT::Other, Chains);
+  }
+
+  // Only the word alignment of the destination is known. Start at the block
+  // that contains it, masking off the lanes before it. Where the last block
+  // is depends on the alignment, so write enough blocks to cover the worst
+  // case. Those that may be past the end are clamped to the last block (which
+  // stores the same values to it again), and masked to end at the last word.
+  MachinePointerInfo BlockPtrInfo;
+  SDValue AllLanes = DAG.getConstant(kAllLanes, DL, MVT::i32);
+  SDValue BlockMask = DAG.getConstant(~(kBlockSize - 1), DL, PtrVT);
+  SDValue Base = DAG.getNode(ISD::AND, DL, PtrVT, Dst, BlockMask);
+  SDValue End = getOffsetPointer(Dst, Bytes, DL, DAG);
+  SDValue LastBlock = DAG.getNode(
+      ISD::AND, DL, PtrVT,
+      DAG.getNode(ISD::SUB, DL, PtrVT, End, DAG.getConstant(1, DL, PtrVT)),
+      BlockMask);
+
+  SDValue HeadWords = DAG.getNode(
+      ISD::SRL, DL, MVT::i32,
+      DAG.getNode(ISD::AND, DL, PtrVT, Dst,
+                  DAG.getConstant(kBlockSize - 1, DL, PtrVT)),
+      DAG.getConstant(2, DL, MVT::i32));
+  SDValue HeadMask = DAG.getNode(ISD::SRL, DL, MVT::i32, AllLanes, HeadWords);
+  Chains.push_back(getMaskedBlockStore(Chain, Fill, Base, HeadMask,
+                                       BlockPtrInfo, IsVolatile, DL, DAG));
+
+  unsigned NumBlocks =
+      (kBlockSize - Align + Bytes + kBlockSize - 1) / kBlockSize;
+  for (unsigned Block = 1; Block < NumBlocks; Block++) {
+    SDValue Ptr = getOffsetPointer(Base, Block * kBlockSize, DL, DAG);
+    if ((Block + 1) * kBlockSize <= Bytes) {
+      // This block is always entirely inside the destination.
+      Chains.push_back(DAG.getStore(Chain, DL, Fill, Ptr, BlockPtrInfo,
+                                    kBlockSize, MMOFlags));
+      continue;
+    }
+
+    Ptr = DAG.getSelectCC(DL, Ptr, LastBlock, Ptr, LastBlock, ISD::SETULT);
+    SDValue Remaining = DAG.getNode(ISD::SUB, DL, PtrVT, End, Ptr);
+    SDValue BlockBytes = DAG.getConstant(kBlockSize, DL, PtrVT);
+    Remaining = DAG.getSelectCC(DL, Remaining, BlockBytes, Remaining,
+                                BlockBytes, ISD::SETULT);
+    SDValue TailWords = DAG.getNode(ISD::SRL, DL, MVT::i32, Remaining,
+                                    DAG.getConstant(2, DL, MVT::i32));
+    SDValue TailMask = DAG.getNode(
+        ISD::XOR, DL, MVT::i32, AllLanes,
+        DAG.getNode(ISD::SRL, DL, MVT::i32, AllLanes, TailWords));
+    Chains.push_back(getMaskedBlockStore(Chain, Fill, Ptr, TailMask,
+                                         BlockPtrInfo, IsVolatile, DL, DAG));
+  }
+
+  return DAG.getNode(ISD::TokenFactor, DL, MVT::Other, Chains);
+}
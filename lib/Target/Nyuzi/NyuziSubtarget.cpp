@@ -29,16 +29,14 @@ void NyuziSubtarget::anchor() {}
 NyuziSubtarget::NyuziSubtarget(const Triple &TT, const std::string &CPU,
                                const std::string &FS,
                                const NyuziTargetMachine &TM)
-    : NyuziGenSubtargetInfo(TT, CPU, FS),
+    : NyuziGenSubtargetInfo(TT, CPU.empty() ? "nyuzi" : CPU, FS),
       InstrInfo(NyuziInstrInfo::create(*this)),
       TLInfo(NyuziTargetLowering::create(TM, *this)), TSInfo(),
       FrameLowering(NyuziFrameLowering::create(*this)) {
 
-  std::string CPUName = CPU;
-
-  // CPUName is empty when invoked from tools like llc
-  if (CPUName.empty())
-    CPUName = "nyuzi";
+  // CPU is empty when invoked from tools like llc. The base class is also
+  // given the default name so it selects the nyuzi scheduling model.
+  std::string CPUName = CPU.empty() ? "nyuzi" : CPU;
 
   InstrItins = getInstrItineraryForCPU(CPUName);
 
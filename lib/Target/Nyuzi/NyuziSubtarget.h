@@ -17,7 +17,7 @@
 #include "NyuziFrameLowering.h"
 #include "NyuziISelLowering.h"
 #include "NyuziInstrInfo.h"
-#include "llvm/CodeGen/SelectionDAGTargetInfo.h"
+#include "NyuziSelectionDAGInfo.h"
 #include "llvm/Target/TargetSubtargetInfo.h"
 #include <string>
 
@@ -31,7 +31,7 @@ class NyuziSubtarget : public NyuziGenSubtargetInfo {
   virtual void anchor();
   std::unique_ptr<const NyuziInstrInfo> InstrInfo;
   std::unique_ptr<const NyuziTargetLowering> TLInfo;
-  SelectionDAGTargetInfo TSInfo;
+  NyuziSelectionDAGInfo TSInfo;
   std::unique_ptr<const NyuziFrameLowering> FrameLowering;
   InstrItineraryData InstrItins;
 
@@ -54,17 +54,12 @@ public:
   const NyuziTargetLowering *getTargetLowering() const override {
     return TLInfo.get();
   }
-  const SelectionDAGTargetInfo *getSelectionDAGInfo() const override {
+  const NyuziSelectionDAGInfo *getSelectionDAGInfo() const override {
     return &TSInfo;
   }
 
-  // Currently disabled because these cause bad code gen with large stack frames
-  //  bool enableMachineScheduler() const override {
-  //    return true;
-  //  }
-  //  bool enablePostRAScheduler() const override {
-  //    return true;
-  //  }
+  bool enableMachineScheduler() const override { return true; }
+  bool enablePostRAScheduler() const override { return true; }
   const InstrItineraryData *getInstrItineraryData() const override {
     return &InstrItins;
   }
@@ -14,13 +14,44 @@
 #include "MCTargetDesc/NyuziMCTargetDesc.h"
 #include "Nyuzi.h"
 #include "NyuziTargetObjectFile.h"
+#include "NyuziTargetTransformInfo.h"
+#include "llvm/CodeGen/MachineScheduler.h"
 #include "llvm/CodeGen/Passes.h"
 #include "llvm/CodeGen/TargetPassConfig.h"
 #include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/TargetRegistry.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Vectorize.h"
 
 using namespace llvm;
 
+extern cl::opt<bool> EnableIPRA; // TargetMachine.cpp
+
+// The load that stands in for a prefetch (see PREFETCH in NyuziInstrInfo.td)
+// faults on an unmapped address. The prefetches this pass inserts run ahead
+// of the loop, past the end of the arrays it reads, so it is off unless
+// requested.
+static cl::opt<bool>
+    EnableLoopDataPrefetch("nyuzi-loop-prefetch", cl::Hidden, cl::init(false),
+                           cl::desc("Insert prefetches for streaming loads "
+                                    "in loops"));
+
+static cl::opt<bool> EnableLoadStoreVectorizer(
+    "nyuzi-load-store-vectorizer", cl::Hidden, cl::init(true),
+    cl::desc("Merge runs of adjacent scalar loads and stores into block "
+             "loads and stores"));
+
+static cl::opt<bool>
+    EnableNyuziIPRA("nyuzi-ipra", cl::Hidden, cl::init(true),
+                    cl::desc("Use interprocedural register allocation when "
+                             "optimizing"));
+
+static cl::opt<bool>
+    EnableEarlyIfConversion("nyuzi-early-ifcvt", cl::Hidden, cl::init(true),
+                            cl::desc("Convert small vector branches to "
+                                     "predicated instructions"));
+
 extern "C" void LLVMInitializeNyuziTarget() {
   // Register the target.
   RegisterTargetMachine<NyuziTargetMachine> X(TheNyuziTarget);
@@ -37,7 +68,17 @@ public:
     return getTM<NyuziTargetMachine>();
   }
 
+  ScheduleDAGInstrs *
+  createMachineScheduler(MachineSchedContext *C) const override {
+    ScheduleDAGMILive *DAG = createGenericSchedLive(C);
+    DAG->addMutation(createLoadClusterDAGMutation(DAG->TII, DAG->TRI));
+    DAG->addMutation(createStoreClusterDAGMutation(DAG->TII, DAG->TRI));
+    return DAG;
+  }
+
+  void addIRPasses() override;
   bool addInstSelector() override;
+  bool addILPOpts() override;
 };
 
 Reloc::Model getEffectiveRelocModel(const Triple &TT,
@@ -58,14 +99,49 @@ NyuziTargetMachine::NyuziTargetMachine(const Target &T, const Triple &TT,
                         getEffectiveRelocModel(TT, RM), CM, OL),
       TLOF(make_unique<NyuziTargetObjectFile>()),
       Subtarget(TT, CPU, FS, *this) {
+  // Vector registers are expensive to save, and firmware is usually linked
+  // statically with LTO, so most callees are visible. Allocating registers
+  // based on what callees actually clobber avoids many spills around calls.
+  // This is only the default: an explicit -enable-ipra takes precedence.
+  if (EnableNyuziIPRA && OL != CodeGenOpt::None &&
+      !EnableIPRA.getNumOccurrences())
+    this->Options.EnableIPRA = true;
+
   initAsmInfo();
 }
 
+TargetIRAnalysis NyuziTargetMachine::getTargetIRAnalysis() {
+  return TargetIRAnalysis([this](const Function &F) {
+    return TargetTransformInfo(NyuziTTIImpl(this, F));
+  });
+}
+
 TargetPassConfig *NyuziTargetMachine::createPassConfig(PassManagerBase &PM) {
   return new NyuziPassConfig(this, PM);
 }
 
+void NyuziPassConfig::addIRPasses() {
+  addPass(createAtomicExpandPass(TM));
+
+  if (TM->getOptLevel() != CodeGenOpt::None) {
+    if (EnableLoopDataPrefetch)
+      addPass(createLoopDataPrefetchPass());
+
+    if (EnableLoadStoreVectorizer)
+      addPass(createLoadStoreVectorizerPass());
+  }
+
+  TargetPassConfig::addIRPasses();
+}
+
 bool NyuziPassConfig::addInstSelector() {
   addPass(createNyuziISelDag(getNyuziTargetMachine()));
   return false;
 }
+
+bool NyuziPassConfig::addILPOpts() {
+  if (EnableEarlyIfConversion)
+    addPass(createNyuziEarlyIfConversionPass());
+
+  return true;
+}
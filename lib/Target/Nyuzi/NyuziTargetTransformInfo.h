@@ -0,0 +1,317 @@
+//===-- NyuziTargetTransformInfo.h - Nyuzi specific TTI ---------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file a TargetTransformInfo::Concept conforming object specific to the
+// Nyuzi target machine. It describes the 16 lane vector unit to the loop and
+// SLP vectorizers, while letting the target independent and default TTI
+// implementations handle the rest.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LIB_TARGET_NYUZI_NYUZITARGETTRANSFORMINFO_H
+#define LLVM_LIB_TARGET_NYUZI_NYUZITARGETTRANSFORMINFO_H
+
+#include "Nyuzi.h"
+#include "NyuziSubtarget.h"
+#include "NyuziTargetMachine.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/CodeGen/BasicTTIImpl.h"
+#include "llvm/Target/TargetLowering.h"
+
+namespace llvm {
+class NyuziTTIImpl : public BasicTTIImplBase<NyuziTTIImpl> {
+  typedef BasicTTIImplBase<NyuziTTIImpl> BaseT;
+  typedef TargetTransformInfo TTI;
+  friend BaseT;
+
+  const NyuziSubtarget *ST;
+  const NyuziTargetLowering *TLI;
+
+  const NyuziSubtarget *getST() const { return ST; }
+  const NyuziTargetLowering *getTLI() const { return TLI; }
+
+  // Block loads and stores must be aligned to the size of a vector register.
+  // Anything else is done one lane at a time with a scatter/gather.
+  static const unsigned BlockAlignment = 64;
+  static const unsigned NumLanes = 16;
+
+  bool isNativeVectorType(Type *Ty) const {
+    return Ty->isVectorTy() && Ty->getVectorNumElements() == NumLanes &&
+           Ty->getScalarSizeInBits() == 32;
+  }
+
+  // Narrower vectors of 32 bit elements are widened to the native type and
+  // wider ones split, so an operation on them costs the same as on however
+  // many native registers they legalize to. Returns 0 for types that don't
+  // legalize to native vectors.
+  unsigned getNumNativeRegisters(Type *Ty) const {
+    if (!Ty->isVectorTy())
+      return 0;
+
+    std::pair<int, MVT> LT = TLI->getTypeLegalizationCost(DL, Ty);
+    if (LT.second != MVT::v16i32 && LT.second != MVT::v16f32)
+      return 0;
+
+    return LT.first;
+  }
+
+public:
+  explicit NyuziTTIImpl(const NyuziTargetMachine *TM, const Function &F)
+      : BaseT(TM, F.getParent()->getDataLayout()), ST(TM->getSubtargetImpl(F)),
+        TLI(ST->getTargetLowering()) {}
+
+  // SP, FP, RA, and PC are not allocatable.
+  unsigned getNumberOfRegisters(bool Vector) { return Vector ? 32 : 28; }
+
+  unsigned getRegisterBitWidth(bool Vector) { return Vector ? 512 : 32; }
+
+  // Interleaving two iterations covers most of the floating point pipeline
+  // latency in a single thread.
+  unsigned getMaxInterleaveFactor(unsigned VF) { return VF > 1 ? 2 : 1; }
+
+  // Cost of putting a constant in a register (see
+  // NyuziTargetLowering::LowerConstant). Constants that take more than one
+  // instruction and are used more than once are hoisted by ConstantHoisting,
+  // so they are built once instead of in every block that uses them.
+  int getIntImmCost(const APInt &Imm, Type *Ty) {
+    assert(Ty->isIntegerTy());
+    if (Imm.getBitWidth() > 32)
+      return TTI::TCC_Free;
+
+    return ST->getInstrInfo()->getImmediateCost(
+               static_cast<int32_t>(Imm.getSExtValue())) *
+           TTI::TCC_Basic;
+  }
+
+  int getIntImmCost(unsigned Opcode, unsigned Idx, const APInt &Imm,
+                    Type *Ty) {
+    switch (Opcode) {
+    case Instruction::Add:
+    case Instruction::Sub:
+    case Instruction::Mul:
+    case Instruction::And:
+    case Instruction::Or:
+    case Instruction::Xor:
+    case Instruction::Shl:
+    case Instruction::LShr:
+    case Instruction::AShr:
+    case Instruction::ICmp:
+      // The second operand has a 13 bit immediate form.
+      if (Idx == 1 && Imm.getBitWidth() <= 32 && isInt<13>(Imm.getSExtValue()))
+        return TTI::TCC_Free;
+
+      return getIntImmCost(Imm, Ty);
+
+    case Instruction::Select:
+      return Idx != 0 ? getIntImmCost(Imm, Ty) : TTI::TCC_Free;
+
+    case Instruction::Store:
+      return Idx == 0 ? getIntImmCost(Imm, Ty) : TTI::TCC_Free;
+
+    default:
+      return TTI::TCC_Free;
+    }
+  }
+
+  // Masks are always passed in a register. Other intrinsic operands, like
+  // control register numbers, must stay immediates.
+  int getIntImmCost(Intrinsic::ID IID, unsigned Idx, const APInt &Imm,
+                    Type *Ty) {
+    switch (IID) {
+    case Intrinsic::nyuzi_vector_mixi:
+    case Intrinsic::nyuzi_vector_mixf:
+      return Idx == 0 ? getIntImmCost(Imm, Ty) : TTI::TCC_Free;
+
+    case Intrinsic::nyuzi_gather_loadi_masked:
+    case Intrinsic::nyuzi_gather_loadf_masked:
+    case Intrinsic::nyuzi_block_loadi_masked:
+    case Intrinsic::nyuzi_block_loadf_masked:
+      return Idx == 1 ? getIntImmCost(Imm, Ty) : TTI::TCC_Free;
+
+    case Intrinsic::nyuzi_scatter_storei_masked:
+    case Intrinsic::nyuzi_scatter_storef_masked:
+    case Intrinsic::nyuzi_block_storei_masked:
+    case Intrinsic::nyuzi_block_storef_masked:
+      return Idx == 2 ? getIntImmCost(Imm, Ty) : TTI::TCC_Free;
+
+    default:
+      return TTI::TCC_Free;
+    }
+  }
+
+  unsigned getCacheLineSize() { return 64; }
+
+  // A thread is suspended by the load that stands in for a prefetch just as
+  // it would be by the demand load, so running further ahead doesn't hide
+  // more latency. It only needs to touch the next line before the loop gets
+  // there: 64 instructions is about one line of a word-sized stream in a
+  // short loop. The cap on iterations bounds how far past the end of an
+  // array the last prefetches reach.
+  unsigned getPrefetchDistance() { return 64; }
+  unsigned getMaxPrefetchIterationsAhead() { return 16; }
+
+  bool isLegalMaskedLoad(Type *DataType) { return isNativeVectorType(DataType); }
+  bool isLegalMaskedStore(Type *DataType) {
+    return isNativeVectorType(DataType);
+  }
+  bool isLegalMaskedGather(Type *DataType) {
+    return isNativeVectorType(DataType);
+  }
+  bool isLegalMaskedScatter(Type *DataType) {
+    return isNativeVectorType(DataType);
+  }
+
+  unsigned getArithmeticInstrCost(
+      unsigned Opcode, Type *Ty,
+      TTI::OperandValueKind Opd1Info = TTI::OK_AnyValue,
+      TTI::OperandValueKind Opd2Info = TTI::OK_AnyValue,
+      TTI::OperandValueProperties Opd1PropInfo = TTI::OP_None,
+      TTI::OperandValueProperties Opd2PropInfo = TTI::OP_None,
+      ArrayRef<const Value *> Args = ArrayRef<const Value *>()) {
+    unsigned NumElements = Ty->isVectorTy() ? Ty->getVectorNumElements() : 1;
+    int ISD = TLI->InstructionOpcodeToISD(Opcode);
+    switch (ISD) {
+    case ISD::SDIV:
+    case ISD::UDIV:
+    case ISD::SREM:
+    case ISD::UREM:
+      // There is no integer divider. Division by a constant is a multiply
+      // by a magic number and a few shifts.
+      if (Opd2Info == TTI::OK_UniformConstantValue)
+        return 6;
+
+      // Vector division is expanded inline to about 35 instructions. Scalar
+      // division is a library call.
+      if (unsigned NumRegs = getNumNativeRegisters(Ty))
+        return 40 * NumRegs;
+
+      return 64 * NumElements;
+
+    case ISD::FDIV:
+      // Reciprocal estimate followed by two Newton-Raphson iterations.
+      if (!Ty->isVectorTy())
+        return 7;
+
+      if (unsigned NumRegs = getNumNativeRegisters(Ty))
+        return 7 * NumRegs;
+
+      break;
+
+    default:
+      break;
+    }
+
+    return BaseT::getArithmeticInstrCost(Opcode, Ty, Opd1Info, Opd2Info,
+                                         Opd1PropInfo, Opd2PropInfo, Args);
+  }
+
+  unsigned getShuffleCost(TTI::ShuffleKind Kind, Type *Tp, int Index,
+                          Type *SubTp) {
+    if (!isNativeVectorType(Tp))
+      return BaseT::getShuffleCost(Kind, Tp, Index, SubTp);
+
+    switch (Kind) {
+    case TTI::SK_Alternate:
+      // Single vector_mix with an immediate mask.
+      return 1;
+
+    case TTI::SK_Broadcast:
+      // getlane followed by a splat move.
+      return 2;
+
+    case TTI::SK_Reverse:
+    case TTI::SK_PermuteSingleSrc:
+      // Shuffle with an index vector. The index vector is loop invariant.
+      return 2;
+
+    case TTI::SK_PermuteTwoSrc:
+      // Shuffle each source, then vector_mix the results together.
+      return 4;
+
+    default:
+      return BaseT::getShuffleCost(Kind, Tp, Index, SubTp);
+    }
+  }
+
+  unsigned getCmpSelInstrCost(unsigned Opcode, Type *ValTy, Type *CondTy) {
+    // A vector compare produces a scalar lane mask, which vector_mix uses
+    // directly to select lanes.
+    if (unsigned NumRegs = getNumNativeRegisters(ValTy))
+      return NumRegs;
+
+    return BaseT::getCmpSelInstrCost(Opcode, ValTy, CondTy);
+  }
+
+  unsigned getMemoryOpCost(unsigned Opcode, Type *Src, unsigned Alignment,
+                           unsigned AddressSpace) {
+    // A partial register can't use a block access even when it is aligned,
+    // and is moved one lane at a time like an unaligned full register.
+    if (unsigned NumRegs = getNumNativeRegisters(Src)) {
+      if (Alignment >= BlockAlignment &&
+          Src->getVectorNumElements() == NumRegs * NumLanes)
+        return NumRegs;
+
+      return NumLanes * NumRegs;
+    }
+
+    return BaseT::getMemoryOpCost(Opcode, Src, Alignment, AddressSpace);
+  }
+
+  // Used by the load/store vectorizer to merge runs of scalar accesses into
+  // block loads and stores. Only whole, aligned blocks are worth it: anything
+  // smaller isn't a legal type, and unaligned accesses would become a
+  // gather/scatter that is no faster than the scalar accesses.
+  unsigned getLoadStoreVecRegBitWidth(unsigned AddrSpace) const { return 512; }
+
+  bool isLegalToVectorizeLoadChain(unsigned ChainSizeInBytes,
+                                   unsigned Alignment,
+                                   unsigned AddrSpace) const {
+    return ChainSizeInBytes == BlockAlignment && Alignment >= BlockAlignment;
+  }
+
+  bool isLegalToVectorizeStoreChain(unsigned ChainSizeInBytes,
+                                    unsigned Alignment,
+                                    unsigned AddrSpace) const {
+    return isLegalToVectorizeLoadChain(ChainSizeInBytes, Alignment, AddrSpace);
+  }
+
+  unsigned getLoadVectorFactor(unsigned VF, unsigned LoadSize,
+                               unsigned ChainSizeInBytes,
+                               VectorType *VecTy) const {
+    return LoadSize == 32 ? VF : 1;
+  }
+
+  unsigned getStoreVectorFactor(unsigned VF, unsigned StoreSize,
+                                unsigned ChainSizeInBytes,
+                                VectorType *VecTy) const {
+    return StoreSize == 32 ? VF : 1;
+  }
+
+  unsigned getMaskedMemoryOpCost(unsigned Opcode, Type *Src, unsigned Alignment,
+                                 unsigned AddressSpace) {
+    if (isNativeVectorType(Src))
+      return getMemoryOpCost(Opcode, Src, Alignment, AddressSpace);
+
+    return BaseT::getMaskedMemoryOpCost(Opcode, Src, Alignment, AddressSpace);
+  }
+
+  unsigned getGatherScatterOpCost(unsigned Opcode, Type *DataTy, Value *Ptr,
+                                  bool VariableMask, unsigned Alignment) {
+    // Scatter/gather instructions access one lane per cycle.
+    if (isNativeVectorType(DataTy))
+      return NumLanes;
+
+    return BaseT::getGatherScatterOpCost(Opcode, DataTy, Ptr, VariableMask,
+                                         Alignment);
+  }
+};
+
+} // end namespace llvm
+
+#endif // LLVM_LIB_TARGET_NYUZI_NYUZITARGETTRANSFORMINFO_H
@@ -0,0 +1,76 @@
+; RUN: llc %s -o - | FileCheck %s
+;
+; Functions with the nyuzi-atomic-backoff attribute wait after a failed
+; store_sync before retrying, doubling the delay each time. This applies to
+; compare-and-swap as well as read-modify-write operations.
+;
+
+target triple = "nyuzi-elf-none"
+
+define i32 @backoff_add(i32* %ptr, i32 %value) #0 { ; CHECK-LABEL: backoff_add:
+  %tmp = atomicrmw add i32* %ptr, i32 %value monotonic
+
+  ; CHECK: move [[MINDELAY:s[0-9]+]], 16
+  ; CHECK: [[LOOP:\.LBB[0-9]+_[0-9]+]]:
+  ; CHECK: load_sync [[OLDVAL:s[0-9]+]], (s0)
+  ; CHECK: add_i [[NEWVAL:s[0-9]+]], [[OLDVAL]], s1
+  ; CHECK: store_sync [[NEWVAL]], (s0)
+  ; CHECK: shl {{s[0-9]+}}, {{s[0-9]+}}, 1
+  ; CHECK: [[SPIN:\.LBB[0-9]+_[0-9]+]]:
+  ; CHECK: add_i [[COUNT:s[0-9]+]], {{s[0-9]+}}, -1
+  ; CHECK: b{{n?z}} [[COUNT]],
+  ; CHECK: b{{n?z}} {{s[0-9]+}}, [[LOOP]]
+
+  ret i32 %tmp
+}
+
+define { i32, i1 } @backoff_cmpxchg(i32* %ptr, i32 %cmp, i32 %newvalue) #0 { ; CHECK-LABEL: backoff_cmpxchg:
+  %tmp = cmpxchg i32* %ptr, i32 %cmp, i32 %newvalue monotonic monotonic
+
+  ; CHECK: [[LOOP:\.LBB[0-9]+_[0-9]+]]:
+  ; CHECK: load_sync
+  ; CHECK: store_sync [[SUCCESS:s[0-9]+]],
+  ; CHECK: shl {{s[0-9]+}}, {{s[0-9]+}}, 1
+  ; CHECK: add_i [[COUNT:s[0-9]+]], {{s[0-9]+}}, -1
+  ; CHECK: b{{n?z}} [[COUNT]],
+  ; CHECK: b{{n?z}} [[SUCCESS]],
+
+  ret { i32, i1 } %tmp
+}
+
+; All operations in a function share one delay, which is only initialized on
+; entry and only updated when a store fails.
+define i32 @backoff_shared(i32* %ptr, i32 %value) #0 { ; CHECK-LABEL: backoff_shared:
+  %old = atomicrmw add i32* %ptr, i32 %value monotonic
+  %tmp = atomicrmw xchg i32* %ptr, i32 %old monotonic
+
+  ; CHECK: move [[MINDELAY:s[0-9]+]], 16
+  ; CHECK: store_32 [[MINDELAY]], (sp)
+  ; CHECK: store_sync [[RESULT1:s[0-9]+]], (s0)
+  ; CHECK-NEXT: bz [[RESULT1]], [[WAIT1:\.LBB[0-9]+_[0-9]+]]
+  ; CHECK: [[WAIT1]]:
+  ; CHECK: store_32 {{s[0-9]+}}, (sp)
+  ; CHECK: store_sync [[RESULT2:s[0-9]+]], (s0)
+  ; CHECK-NEXT: bz [[RESULT2]], [[WAIT2:\.LBB[0-9]+_[0-9]+]]
+  ; CHECK: [[WAIT2]]:
+  ; CHECK: store_32 {{s[0-9]+}}, (sp)
+  ; CHECK-NOT: store_32
+  ; CHECK: .Lfunc_end
+
+  ret i32 %tmp
+}
+
+; Without the attribute, the loop retries immediately.
+define i32 @no_backoff_add(i32* %ptr, i32 %value) { ; CHECK-LABEL: no_backoff_add:
+  %tmp = atomicrmw add i32* %ptr, i32 %value monotonic
+
+  ; CHECK: [[LOOP:\.LBB[0-9]+_[0-9]+]]:
+  ; CHECK: load_sync [[OLDVAL:s[0-9]+]], (s0)
+  ; CHECK: add_i [[NEWVAL:s[0-9]+]], [[OLDVAL]], s1
+  ; CHECK: store_sync [[NEWVAL]], (s0)
+  ; CHECK-NEXT: bz [[NEWVAL]], [[LOOP]]
+
+  ret i32 %tmp
+}
+
+attributes #0 = { "nyuzi-atomic-backoff" }
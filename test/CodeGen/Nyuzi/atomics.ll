@@ -9,7 +9,6 @@ define i32 @atomic_add_reg(i32* %ptr, i32 %value) { ; CHECK-LABEL: atomic_add_re
   %tmp = atomicrmw volatile add i32* %ptr, i32 %value monotonic
 
   ; CHECK: load_sync [[OLDVAL:s[0-9]+]], (s0)
-  ; CHECK: move s{{[0-9]+}}, [[OLDVAL]]
   ; CHECK: add_i [[NEWVAL:s[0-9]+]], [[OLDVAL]], s1
   ; CHECK: store_sync [[NEWVAL]], (s0)
   ; CHECK: bz [[NEWVAL]],
@@ -22,7 +21,6 @@ define i32 @atomic_add_imm(i32* %ptr) { ; CHECK-LABEL: atomic_add_imm:
   %tmp = atomicrmw volatile add i32* %ptr, i32 13 monotonic
 
   ; CHECK: load_sync [[OLDVAL:s[0-9]+]], (s0)
-  ; CHECK: move s{{[0-9]+}}, [[OLDVAL]]
   ; CHECK: add_i [[NEWVAL:s[0-9]+]], [[OLDVAL]], 13
   ; CHECK: store_sync [[NEWVAL]], (s0)
   ; CHECK: bz [[NEWVAL]],
@@ -31,14 +29,15 @@ define i32 @atomic_add_imm(i32* %ptr) { ; CHECK-LABEL: atomic_add_imm:
 }
 
 ; This one has an constant operand, but it doesn't fit in an immediate instruction,
-; so this should load the addend from the constant pool
+; so the addend is built with a move/shift/or sequence
 
 define i32 @atomic_add_large_imm(i32* %ptr) { ; CHECK-LABEL: atomic_add_large_imm:
   %tmp = atomicrmw volatile add i32* %ptr, i32 1300000 monotonic
 
-  ; CHECK: load_32 [[CONSTREG1:s[0-9]+]], .LCPI
+  ; CHECK: move [[CONSTREG1:s[0-9]+]], 317
+  ; CHECK: shl [[CONSTREG1]], [[CONSTREG1]], 12
+  ; CHECK: or [[CONSTREG1]], [[CONSTREG1]], 1568
   ; CHECK: load_sync s{{[0-9]+}}, (s0)
-  ; CHECK: move s{{[0-9]+}}, s{{[0-9]+}}
   ; CHECK: add_i [[NEWVAL:s[0-9]+]], s{{[0-9]+}}, [[CONSTREG1]]
   ; CHECK: store_sync [[NEWVAL]], (s0)
   ; CHECK: bz [[NEWVAL]],
@@ -58,7 +57,7 @@ define i32 @atomic_sub_reg(i32* %ptr, i32 %value) { ; CHECK-LABEL: atomic_sub_re
 define i32 @atomic_sub_imm(i32* %ptr) { ; CHECK-LABEL: atomic_sub_imm:
   %tmp = atomicrmw volatile sub i32* %ptr, i32 13 monotonic
 
-  ; CHECK: sub_i [[NEWVAL:s[0-9]+]], s{{[0-9]+}}, 13
+  ; CHECK: add_i [[NEWVAL:s[0-9]+]], s{{[0-9]+}}, -13
   ; CHECK: store_sync [[NEWVAL]], (s0)
 
   ret i32 %tmp
@@ -67,8 +66,10 @@ define i32 @atomic_sub_imm(i32* %ptr) { ; CHECK-LABEL: atomic_sub_imm:
 define i32 @atomic_sub_large_imm(i32* %ptr) { ; CHECK-LABEL: atomic_sub_large_imm:
   %tmp = atomicrmw volatile sub i32* %ptr, i32 1300000 monotonic
 
-  ; CHECK: load_32 [[CONSTREG2:s[0-9]+]], .LCPI
-  ; CHECK: sub_i [[NEWVAL:s[0-9]+]], s{{[0-9]+}}, [[CONSTREG2]]
+  ; CHECK: move [[CONSTREG2:s[0-9]+]], -318
+  ; CHECK: shl [[CONSTREG2]], [[CONSTREG2]], 12
+  ; CHECK: or [[CONSTREG2]], [[CONSTREG2]], 2528
+  ; CHECK: add_i [[NEWVAL:s[0-9]+]], s{{[0-9]+}}, [[CONSTREG2]]
   ; CHECK: store_sync [[NEWVAL]], (s0)
 
   ret i32 %tmp
@@ -95,7 +96,9 @@ define i32 @atomic_and_imm(i32* %ptr) { ; CHECK-LABEL: atomic_and_imm:
 define i32 @atomic_and_large_imm(i32* %ptr) { ; CHECK-LABEL: atomic_and_large_imm:
   %tmp = atomicrmw volatile and i32* %ptr, i32 1300000 monotonic
 
-  ; CHECK: load_32 [[CONST:s[0-9]+]], .LCPI
+  ; CHECK: move [[CONST:s[0-9]+]], 317
+  ; CHECK: shl [[CONST]], [[CONST]], 12
+  ; CHECK: or [[CONST]], [[CONST]], 1568
   ; CHECK: and [[NEWVAL:s[0-9]+]], s{{[0-9]+}}, [[CONST]]
   ; CHECK: store_sync [[NEWVAL]], (s0)
 
@@ -123,7 +126,9 @@ define i32 @atomic_or_imm(i32* %ptr) { ; CHECK-LABEL: atomic_or_imm:
 define i32 @atomic_or_large_imm(i32* %ptr) { ; CHECK-LABEL: atomic_or_large_imm:
   %tmp = atomicrmw volatile or i32* %ptr, i32 1300000 monotonic
 
-  ; CHECK: load_32 [[CONST:s[0-9]+]], .LCPI
+  ; CHECK: move [[CONST:s[0-9]+]], 317
+  ; CHECK: shl [[CONST]], [[CONST]], 12
+  ; CHECK: or [[CONST]], [[CONST]], 1568
   ; CHECK: or [[NEWVAL:s[0-9]+]], s{{[0-9]+}}, [[CONST]]
   ; CHECK: store_sync [[NEWVAL]], (s0)
 
@@ -151,7 +156,9 @@ define i32 @atomic_xor_imm(i32* %ptr) { ; CHECK-LABEL: atomic_xor_imm:
 define i32 @atomic_xor_large_imm(i32* %ptr) { ; CHECK-LABEL: atomic_xor_large_imm:
   %tmp = atomicrmw volatile xor i32* %ptr, i32 1300000 monotonic
 
-  ; CHECK: load_32 [[CONST:s[0-9]+]], .LCPI
+  ; CHECK: move [[CONST:s[0-9]+]], 317
+  ; CHECK: shl [[CONST]], [[CONST]], 12
+  ; CHECK: or [[CONST]], [[CONST]], 1568
   ; CHECK: xor [[NEWVAL:s[0-9]+]], s{{[0-9]+}}, [[CONST]]
   ; CHECK: store_sync [[NEWVAL]], (s0)
 
@@ -161,10 +168,10 @@ define i32 @atomic_xor_large_imm(i32* %ptr) { ; CHECK-LABEL: atomic_xor_large_im
 define i32 @atomic_xchg(i32* %ptr, i32 %value) { ; CHECK-LABEL: atomic_xchg:
   %tmp = atomicrmw volatile xchg i32* %ptr, i32 %value monotonic
 
-  ; CHECK: load_sync [[OLDVAL:s[0-9]+]], (s0)
-  ; CHECK: move s{{[0-9]+}}, [[OLDVAL]]
-  ; CHECK: store_sync [[OLDVAL]], (s0)
-  ; CHECK: bz [[OLDVAL]],
+  ; CHECK-DAG: load_sync s{{[0-9]+}}, (s0)
+  ; CHECK-DAG: move [[NEWVAL:s[0-9]+]], s1
+  ; CHECK: store_sync [[NEWVAL]], (s0)
+  ; CHECK: bz [[NEWVAL]],
 
   ret i32 %tmp
 }
@@ -172,12 +179,67 @@ define i32 @atomic_xchg(i32* %ptr, i32 %value) { ; CHECK-LABEL: atomic_xchg:
 define { i32, i1 } @atomic_cmpxchg(i32* %ptr, i32 %cmp, i32 %newvalue) { ; CHECK-LABEL: atomic_cmpxchg:
   %tmp = cmpxchg volatile i32* %ptr, i32 %cmp, i32 %newvalue monotonic monotonic
 
-  ; CHECK: load_sync [[DEST:s[0-9]+]], (
-  ; CHECK: cmpne_i [[CMPRES:s[0-9]+]], [[DEST]], s1
-  ; CHECK: bnz [[CMPRES]],
-  ; CHECK: move [[SUCCESS:s[0-9]+]], s2
-  ; CHECK: store_sync [[RESULT:s[0-9]+]], (
-  ; CHECK: bz [[RESULT]],
+  ; CHECK: load_sync [[DEST:s[0-9]+]], ([[PTR:s[0-9]+]])
+  ; CHECK: cmp{{eq|ne}}_i [[CMPRES:s[0-9]+]], [[DEST]], s1
+  ; CHECK: b{{n?z}} [[CMPRES]],
+  ; CHECK: move [[RESULT:s[0-9]+]], s2
+  ; CHECK: store_sync [[RESULT]], ([[PTR]])
+  ; CHECK: b{{n?z}} [[RESULT]],
 
   ret { i32, i1 } %tmp
 }
+
+; load_sync/store_sync only work on whole words, so smaller operations are
+; performed with a compare and swap on the containing word.
+define i8 @atomic_add_byte(i8* %ptr, i8 %value) { ; CHECK-LABEL: atomic_add_byte:
+  %tmp = atomicrmw volatile add i8* %ptr, i8 %value monotonic
+
+  ; CHECK: and [[WORDPTR:s[0-9]+]], s0, -4
+  ; CHECK: load_sync {{s[0-9]+}}, ([[WORDPTR]])
+  ; CHECK: store_sync {{s[0-9]+}}, ([[WORDPTR]])
+
+  ret i8 %tmp
+}
+
+define { i16, i1 } @atomic_cmpxchg_short(i16* %ptr, i16 %cmp, i16 %newvalue) { ; CHECK-LABEL: atomic_cmpxchg_short:
+  %tmp = cmpxchg volatile i16* %ptr, i16 %cmp, i16 %newvalue monotonic monotonic
+
+  ; CHECK: and [[WORDPTR:s[0-9]+]], s0, -4
+  ; CHECK: load_sync [[DEST:s[0-9]+]], ([[WORDPTR]])
+  ; CHECK: cmpne_i [[CMPRES:s[0-9]+]], [[DEST]],
+  ; CHECK: bnz [[CMPRES]],
+  ; CHECK: store_sync {{s[0-9]+}}, ([[WORDPTR]])
+
+  ret { i16, i1 } %tmp
+}
+
+; Aligned loads and stores are atomic
+define i32 @atomic_load(i32* %ptr) { ; CHECK-LABEL: atomic_load:
+  %tmp = load atomic i32, i32* %ptr monotonic, align 4
+
+  ; CHECK: load_32 s0, (s0)
+  ; CHECK-NOT: load_sync
+
+  ret i32 %tmp
+}
+
+define void @atomic_store(i32* %ptr, i32 %value) { ; CHECK-LABEL: atomic_store:
+  store atomic i32 %value, i32* %ptr monotonic, align 4
+
+  ; CHECK: store_32 s1, (s0)
+  ; CHECK-NOT: store_sync
+
+  ret void
+}
+
+define i32 @atomic_load_seq_cst(i32* %ptr) { ; CHECK-LABEL: atomic_load_seq_cst:
+  %tmp = load atomic i32, i32* %ptr seq_cst, align 4
+
+  ; A seq_cst store is followed by a barrier, so only a trailing one is
+  ; needed here.
+  ; CHECK-NOT: membar
+  ; CHECK: load_32 s0, (s0)
+  ; CHECK-NEXT: membar
+
+  ret i32 %tmp
+}
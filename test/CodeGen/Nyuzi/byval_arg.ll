@@ -18,13 +18,13 @@ define void @func1(%struct.foo* byval %f) {
   call void @func2(%struct.foo* byval %f)
 
   ; f parameter becomes src for memcpy call
-  ; CHECK: move s1, s0
+  ; CHECK-DAG: move s1, s0
 
   ; locally allocated stack space is dest parameter for memcpy
-  ; CHECK: lea [[SAVENV:s[0-9]+]], 48(sp)
+  ; CHECK-DAG: lea [[SAVENV:s[0-9]+]], 48(sp)
 
   ; size of structure
-  ; CHECK: move s2, 264
+  ; CHECK-DAG: move s2, 264
 
   ; Copy to local stack object
   ; CHECK: call memcpy
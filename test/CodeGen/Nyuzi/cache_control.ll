@@ -0,0 +1,54 @@
+; RUN: llc %s -o - | FileCheck %s
+;
+; Cache control intrinsics and prefetch
+;
+
+target triple = "nyuzi-elf-none"
+
+declare void @llvm.nyuzi.__builtin_nyuzi_dflush(i8*)
+declare void @llvm.nyuzi.__builtin_nyuzi_dinvalidate(i8*)
+declare void @llvm.nyuzi.__builtin_nyuzi_iinvalidate(i8*)
+declare void @llvm.prefetch(i8*, i32, i32, i32)
+
+define void @test_dflush(i8* %ptr) { ; CHECK-LABEL: test_dflush:
+  call void @llvm.nyuzi.__builtin_nyuzi_dflush(i8* %ptr)
+  ; CHECK: dflush s0
+  ret void
+}
+
+define void @test_dinvalidate(i8* %ptr) { ; CHECK-LABEL: test_dinvalidate:
+  call void @llvm.nyuzi.__builtin_nyuzi_dinvalidate(i8* %ptr)
+  ; CHECK: dinvalidate s0
+  ret void
+}
+
+define void @test_iinvalidate(i8* %ptr) { ; CHECK-LABEL: test_iinvalidate:
+  call void @llvm.nyuzi.__builtin_nyuzi_iinvalidate(i8* %ptr)
+  ; CHECK: iinvalidate s0
+  ret void
+}
+
+; A data read prefetch touches the line with a load whose result is unused.
+; This doesn't depend on -nyuzi-loop-prefetch, which only controls whether
+; prefetches are inserted in loops.
+define void @prefetch_read(i8* %ptr) { ; CHECK-LABEL: prefetch_read:
+  %addr = getelementptr i8, i8* %ptr, i32 128
+  call void @llvm.prefetch(i8* %addr, i32 0, i32 3, i32 1)
+  ; CHECK: load_u8 s{{[0-9]+}}, 128(s0)
+  ; CHECK-NEXT: ret
+  ret void
+}
+
+define void @prefetch_write(i8* %ptr) { ; CHECK-LABEL: prefetch_write:
+  call void @llvm.prefetch(i8* %ptr, i32 1, i32 3, i32 1)
+  ; CHECK-NOT: load_u8
+  ; CHECK: ret
+  ret void
+}
+
+define void @prefetch_instruction(i8* %ptr) { ; CHECK-LABEL: prefetch_instruction:
+  call void @llvm.prefetch(i8* %ptr, i32 0, i32 3, i32 0)
+  ; CHECK-NOT: load_u8
+  ; CHECK: ret
+  ret void
+}
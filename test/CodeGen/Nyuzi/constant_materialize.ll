@@ -0,0 +1,101 @@
+; RUN: llc %s -o - | FileCheck %s
+;
+; Constants that don't fit in an immediate field are built with a short
+; move/shift/or sequence when possible, and only loaded from the constant
+; pool when that would take more than three instructions.
+;
+
+target triple = "nyuzi-elf-none"
+
+define i32 @shifted_imm(i32 %a) { ; CHECK-LABEL: shifted_imm:
+  %1 = add i32 %a, 100000
+
+  ; CHECK: move [[REG:s[0-9]+]], 3125
+  ; CHECK-NEXT: shl [[REG]], [[REG]], 5
+  ; CHECK-NEXT: add_i s0, s0, [[REG]]
+  ; CHECK-NOT: .LCPI
+
+  ret i32 %1
+}
+
+define i32 @move_shift_or(i32 %a) { ; CHECK-LABEL: move_shift_or:
+  %1 = add i32 %a, 1234567
+
+  ; CHECK: move [[REG:s[0-9]+]], 301
+  ; CHECK-NEXT: shl [[REG]], [[REG]], 12
+  ; CHECK-NEXT: or [[REG]], [[REG]], 1671
+  ; CHECK-NEXT: add_i s0, s0, [[REG]]
+
+  ret i32 %1
+}
+
+define float @float_const(float %a) { ; CHECK-LABEL: float_const:
+  %1 = fmul float %a, 1.0e1
+
+  ; CHECK: move [[REG:s[0-9]+]], 521
+  ; CHECK-NEXT: shl [[REG]], [[REG]], 21
+  ; CHECK-NEXT: mul_f s0, s0, [[REG]]
+
+  ret float %1
+}
+
+; CHECK: [[CONST_LBL:\.L[A-Z0-9_]+]]:
+; CHECK: .long 123456789
+define i32 @full_width(i32 %a) { ; CHECK-LABEL: full_width:
+  %1 = add i32 %a, 123456789
+
+  ; CHECK: load_32 [[REG:s[0-9]+]], [[CONST_LBL]]
+  ; CHECK-NEXT: add_i s0, s0, [[REG]]
+
+  ret i32 %1
+}
+
+; The constant pool load is invariant, so it is hoisted out of the loop.
+define void @hoisted(i32* %ptr, i32 %count) { ; CHECK-LABEL: hoisted:
+entry:
+  ; CHECK: load_32 [[REG:s[0-9]+]], .LCPI
+  ; CHECK: [[LOOP:\.LBB[0-9]+_[0-9]+]]:
+  ; CHECK-NOT: load_32 {{s[0-9]+}}, .LCPI
+  ; CHECK: b{{[nz]+}} {{s[0-9]+}}, [[LOOP]]
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %inc, %loop ]
+  %addr = getelementptr i32, i32* %ptr, i32 %i
+  %val = load i32, i32* %addr
+  %sum = add i32 %val, 123456789
+  store i32 %sum, i32* %addr
+  %inc = add i32 %i, 1
+  %done = icmp eq i32 %inc, %count
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+; A constant used in several blocks is built once in a block that dominates
+; them, rather than again in each block.
+define i32 @shared(i32 %a, i32 %b) { ; CHECK-LABEL: shared:
+entry:
+  ; CHECK: move [[REG:s[0-9]+]], 301
+  ; CHECK: or [[REG]], [[REG]], 1671
+  ; CHECK-NOT: move {{s[0-9]+}}, 301
+  ; CHECK-DAG: add_i {{s[0-9]+}}, {{s[0-9]+}}, [[REG]]
+  ; CHECK-DAG: xor {{s[0-9]+}}, {{s[0-9]+}}, [[REG]]
+  ; CHECK-NOT: move {{s[0-9]+}}, 301
+  ; CHECK: .Lfunc_end
+  %cond = icmp eq i32 %b, 0
+  br i1 %cond, label %then, label %else
+
+then:
+  %sum = add i32 %a, 1234567
+  br label %done
+
+else:
+  %xor = xor i32 %a, 1234567
+  br label %done
+
+done:
+  %r = phi i32 [ %sum, %then ], [ %xor, %else ]
+  ret i32 %r
+}
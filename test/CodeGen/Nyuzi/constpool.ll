@@ -36,11 +36,12 @@ define i32 @loadconsti_big() { ; CHECK-LABEL: loadconsti_big:
 }
 
 ; Ensures the backend creates constant pool entries when
-; instruction operands won't fit in the immediate field
+; instruction operands won't fit in the immediate field and would take
+; more than a few instructions to build.
 ; CHECK: [[CONSTOP_LBL:\.L[A-Z0-9_]+]]:
-; CHECK: .long 1234567
+; CHECK: .long 123456789
 define i32 @largeoperand(i32 %a) { ; CHECK-LABEL: largeoperand:
-  %1 = add i32 %a, 1234567
+  %1 = add i32 %a, 123456789
 
     ; CHECK: load_32 [[CONSTREG:s[0-9]+]], [[CONSTOP_LBL]]
     ; CHECK: add_i s0, s0, [[CONSTREG]]
@@ -0,0 +1,123 @@
+; RUN: llc %s -o - | FileCheck %s
+;
+; Small branches that only compute vector values are converted to
+; predicated instructions.
+;
+
+target triple = "nyuzi-elf-none"
+
+define <16 x i32> @diamond(i32 %c, <16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL: diamond:
+entry:
+  %tobool = icmp ne i32 %c, 0
+  br i1 %tobool, label %then, label %else
+
+then:
+  %sum = add <16 x i32> %a, %b
+  br label %done
+
+else:
+  %prod = mul <16 x i32> %a, %b
+  br label %done
+
+done:
+  %r = phi <16 x i32> [ %sum, %then ], [ %prod, %else ]
+
+  ; CHECK-NOT: bnz
+  ; CHECK-NOT: bz
+  ; The mask selects the lanes where the condition is false, which take the
+  ; result of the else block.
+  ; CHECK: move [[SPLAT:v[0-9]+]], s0
+  ; CHECK: cmpeq_i [[MASK:s[0-9]+]], [[SPLAT]], 0
+  ; CHECK: add_i [[RESULT:v[0-9]+]], v0, v1
+  ; CHECK: mull_i_mask [[RESULT]], [[MASK]], v0, v1
+  ret <16 x i32> %r
+}
+
+define <16 x float> @triangle(i32 %c, <16 x float> %a, <16 x float> %b) { ; CHECK-LABEL: triangle:
+entry:
+  %tobool = icmp sgt i32 %c, 10
+  br i1 %tobool, label %then, label %done
+
+then:
+  %sum = fadd <16 x float> %a, %b
+  br label %done
+
+done:
+  %r = phi <16 x float> [ %sum, %then ], [ %a, %entry ]
+
+  ; CHECK-NOT: bnz
+  ; CHECK-NOT: bz
+  ; The branch condition is inverted, so the mask is set where the inverse
+  ; is false.
+  ; CHECK: cmplt_i [[NOTCOND:s[0-9]+]], s0, 11
+  ; CHECK: move [[SPLAT:v[0-9]+]], [[NOTCOND]]
+  ; CHECK: cmpeq_i [[MASK:s[0-9]+]], [[SPLAT]], 0
+  ; CHECK: add_f_mask v0, [[MASK]], v0, v1
+  ret <16 x float> %r
+}
+
+define <16 x i32> @nested(i32 %c, i32 %d, <16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL: nested:
+entry:
+  %c1 = icmp ne i32 %c, 0
+  br i1 %c1, label %outer, label %done
+
+outer:
+  %x = sub <16 x i32> %a, %b
+  %c2 = icmp ne i32 %d, 0
+  br i1 %c2, label %inner, label %join
+
+inner:
+  %y = xor <16 x i32> %x, %b
+  br label %join
+
+join:
+  %z = phi <16 x i32> [ %y, %inner ], [ %x, %outer ]
+  br label %done
+
+done:
+  %r = phi <16 x i32> [ %z, %join ], [ %a, %entry ]
+
+  ; CHECK-NOT: bnz
+  ; CHECK-NOT: bz
+  ; CHECK-DAG: move [[DSPLAT:v[0-9]+]], s1
+  ; CHECK-DAG: move [[CSPLAT:v[0-9]+]], s0
+  ; CHECK-DAG: sub_i [[X:v[0-9]+]], v0, v1
+  ; CHECK-DAG: cmpne_i [[INNER:s[0-9]+]], [[DSPLAT]], 0
+  ; CHECK-DAG: cmpeq_i [[OUTER:s[0-9]+]], [[CSPLAT]], 0
+  ; CHECK: xor_mask [[X]], [[INNER]], [[X]], v1
+  ; CHECK: move_mask [[X]], [[OUTER]], v0
+  ; CHECK: ret
+  ret <16 x i32> %r
+}
+
+; Scalar values can't be merged with a predicated instruction.
+define i32 @scalar_phi(i32 %c, i32 %a, i32 %b) { ; CHECK-LABEL: scalar_phi:
+entry:
+  %tobool = icmp ne i32 %c, 0
+  br i1 %tobool, label %then, label %done
+
+then:
+  %sum = add i32 %a, %b
+  br label %done
+
+done:
+  %r = phi i32 [ %sum, %then ], [ %a, %entry ]
+
+  ; CHECK: b{{n?}}z
+  ret i32 %r
+}
+
+; Stores can't be speculated.
+define void @has_store(i32 %c, <16 x i32> %a, <16 x i32>* %p) { ; CHECK-LABEL: has_store:
+entry:
+  %tobool = icmp ne i32 %c, 0
+  br i1 %tobool, label %then, label %done
+
+then:
+  store <16 x i32> %a, <16 x i32>* %p
+  br label %done
+
+done:
+  ; CHECK: b{{n?}}z
+  ret void
+}
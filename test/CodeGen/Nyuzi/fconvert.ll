@@ -14,14 +14,17 @@ define float @test_sitofp(i32 %a) { ; CHECK-LABEL: test_sitofp:
 }
 
 ; The native itof instruction is signed. We emulate unsigned by checking for
-; wrap and adjusting.
+; wrap and adjusting. The adjusted value is selected without a branch.
 define float @test_uitofp(i32 %a) { ; CHECK-LABEL: test_uitofp:
   %conv = uitofp i32 %a to float
 
   ; CHECK: itof [[CONV:s[0-9]+]], [[SRCVAL:s[0-9]+]]
   ; CHECK: cmplt_i [[CMPVAL:s[0-9]+]], [[SRCVAL]], 0
-  ; CHECK: bnz [[CMPVAL]],
-  ; CHECK: add_f s{{[0-9]+}}, [[CONV]],
+  ; CHECK-NOT: bnz
+  ; CHECK: add_f [[ADJUSTED:s[0-9]+]], [[CONV]],
+  ; CHECK: xor [[DIFF:s[0-9]+]], [[ADJUSTED]], [[CONV]]
+  ; CHECK: and [[SELBITS:s[0-9]+]], [[DIFF]],
+  ; CHECK: xor s0, [[CONV]], [[SELBITS]]
 
   ret float %conv
 }
@@ -51,3 +51,72 @@ define float @reciprocal_float(float %b) { 	; CHECK-LABEL: reciprocal_float:
 
   ret float %1
 }
+
+;
+; The reciprocal-estimates attribute (-mrecip) can reduce the number of
+; refinement steps.
+;
+define float @divide_one_step(float %a, float %b) #0 { 	; CHECK-LABEL: divide_one_step:
+  %1 = fdiv float %a, %b
+
+  ; CHECK: reciprocal [[ESTIMATE1:s[0-9]+]], [[DENOMINATOR:s[0-9]+]]
+  ; CHECK: mul_f [[TRIAL1:s[0-9]+]], [[ESTIMATE1]], [[DENOMINATOR]]
+  ; CHECK: sub_f [[ERROR1:s[0-9]+]], {{s[0-9]+}}, [[TRIAL1]]
+  ; CHECK: mul_f [[ESTIMATE2:s[0-9]+]], [[ESTIMATE1]], [[ERROR1]]
+  ; CHECK: mul_f {{s[0-9]+}}, {{s[0-9]+}}, [[ESTIMATE2]]
+  ; CHECK-NOT: mul_f
+  ; CHECK: ret
+
+  ret float %1
+}
+
+define <16 x float> @divide_vector_no_steps(<16 x float> %a, <16 x float> %b) #1 { 	; CHECK-LABEL: divide_vector_no_steps:
+  %1 = fdiv <16 x float> %a, %b
+
+  ; CHECK: reciprocal [[ESTIMATE:v[0-9]+]], v1
+  ; CHECK-NEXT: mul_f v0, v0, [[ESTIMATE]]
+  ; CHECK-NEXT: ret
+
+  ret <16 x float> %1
+}
+
+;
+; A step count alone doesn't enable estimates, so without unsafe math the
+; reciprocal is still refined to full precision. There is no divide
+; instruction, so the reciprocal itself is always used.
+;
+define float @divide_default_steps(float %a, float %b) #3 { 	; CHECK-LABEL: divide_default_steps:
+  %1 = fdiv float %a, %b
+
+  ; CHECK: reciprocal [[ESTIMATE1:s[0-9]+]], [[DENOMINATOR:s[0-9]+]]
+  ; CHECK: mul_f [[TRIAL1:s[0-9]+]], [[ESTIMATE1]], [[DENOMINATOR]]
+  ; CHECK: sub_f [[ERROR1:s[0-9]+]], [[TWO:s[0-9]+]], [[TRIAL1]]
+  ; CHECK: mul_f [[ESTIMATE2:s[0-9]+]], [[ESTIMATE1]], [[ERROR1]]
+  ; CHECK: mul_f [[TRIAL2:s[0-9]+]], [[ESTIMATE2]], [[DENOMINATOR]]
+  ; CHECK: sub_f [[ERROR2:s[0-9]+]], [[TWO]], [[TRIAL2]]
+  ; CHECK: mul_f [[ESTIMATE3:s[0-9]+]], [[ESTIMATE2]], [[ERROR2]]
+  ; CHECK: mul_f {{s[0-9]+}}, {{s[0-9]+}}, [[ESTIMATE3]]
+
+  ret float %1
+}
+
+;
+; With unsafe math, multiple divides by the same value compute the reciprocal
+; once.
+;
+define float @repeated_divisor(float %a, float %b, float %c) #2 { 	; CHECK-LABEL: repeated_divisor:
+  %1 = fdiv float %a, %c
+  %2 = fdiv float %b, %c
+  %3 = fadd float %1, %2
+
+  ; CHECK: reciprocal
+  ; CHECK-NOT: reciprocal
+  ; CHECK: ret
+
+  ret float %3
+}
+
+attributes #0 = { "reciprocal-estimates"="divf:1" }
+attributes #1 = { "reciprocal-estimates"="vec-divf:0" }
+attributes #2 = { "unsafe-fp-math"="true" }
+attributes #3 = { "reciprocal-estimates"="default:1" }
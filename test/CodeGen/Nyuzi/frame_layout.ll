@@ -0,0 +1,45 @@
+; RUN: llc %s -o - | FileCheck %s
+;
+; Leaf functions only round the frame to their most strictly aligned stack
+; object. Functions that make calls keep SP 64 byte aligned.
+;
+
+target triple = "nyuzi-elf-none"
+
+define i32 @scalar_leaf(i32 %a, i32 %b) { ; CHECK-LABEL: scalar_leaf:
+  %buf = alloca [4 x i32], align 4
+  %p0 = getelementptr [4 x i32], [4 x i32]* %buf, i32 0, i32 0
+  %p1 = getelementptr [4 x i32], [4 x i32]* %buf, i32 0, i32 %b
+  store volatile i32 %a, i32* %p0
+  %v = load volatile i32, i32* %p1
+
+  ; CHECK: add_i sp, sp, -16
+  ; CHECK: add_i sp, sp, 16
+  ret i32 %v
+}
+
+define <16 x i32> @vector_leaf(<16 x i32> %a, i32 %b, i32 %c) { ; CHECK-LABEL: vector_leaf:
+  %vbuf = alloca <16 x i32>, align 64
+  %sbuf = alloca [2 x i32], align 4
+  %sp = getelementptr [2 x i32], [2 x i32]* %sbuf, i32 0, i32 %c
+  store volatile i32 %b, i32* %sp
+  store volatile <16 x i32> %a, <16 x i32>* %vbuf
+  %v = load volatile <16 x i32>, <16 x i32>* %vbuf
+
+  ; CHECK: add_i sp, sp, -128
+  ; CHECK: store_v v0, 64(sp)
+  ; CHECK: add_i sp, sp, 128
+  ret <16 x i32> %v
+}
+
+declare void @ext(i32*)
+
+define void @scalar_call(i32 %a) { ; CHECK-LABEL: scalar_call:
+  %buf = alloca i32, align 4
+  store i32 %a, i32* %buf
+  call void @ext(i32* %buf)
+
+  ; CHECK: add_i sp, sp, -64
+  ; CHECK: add_i sp, sp, 64
+  ret void
+}
@@ -12,7 +12,7 @@ define i8* @f() {
   ret i8* %1
 
   ; CHECK: .cfi_startproc
-  ; CHECK: .cfi_def_cfa_offset 64
+  ; CHECK: .cfi_def_cfa_offset 4
   ; CHECK: .cfi_offset fp, -4
   ; CHECK:  move fp, sp
   ; CHECK: cfi_def_cfa_register fp
@@ -16,13 +16,12 @@ target triple = "nyuzi-elf-none"
 
 define i32 @test() {
   %1 = load i32, i32* @foo, align 4
-
-  ; CHECK: load_32 [[FOO_PTR:s[0-9]+]], [[FOO_LBL]]
-  ; CHECK: load_32 [[TMP_REG:s[0-9]+]], ([[FOO_PTR]])
-
   store i32 %1, i32* @bar, align 4
 
-  ; CHECK: load_32 [[BAR_PTR:s[0-9]+]], [[BAR_LBL]]
+  ; The address loads are invariant and may be scheduled in either order.
+  ; CHECK-DAG: load_32 [[FOO_PTR:s[0-9]+]], [[FOO_LBL]]
+  ; CHECK-DAG: load_32 [[BAR_PTR:s[0-9]+]], [[BAR_LBL]]
+  ; CHECK: load_32 [[TMP_REG:s[0-9]+]], ([[FOO_PTR]])
   ; CHECK: store_32 [[TMP_REG]], ([[BAR_PTR]])
 
   ret i32 %1
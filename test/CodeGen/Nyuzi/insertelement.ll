@@ -9,11 +9,12 @@ target triple = "nyuzi-elf-none"
 define <16 x i32> @test_inserti(<16 x i32> %orig, i32 %value, i32 %lane) {	; CHECK-LABEL: test_inserti:
   %result = insertelement <16 x i32> %orig, i32 %value, i32 %lane
 
-  ; Load 0x8000, shift it to select the appropriate lane, and do a predicated
+  ; Build 0x8000, shift it to select the appropriate lane, and do a predicated
   ; vector move.
 
-  ; CHECK: load_32 s2, .LCPI
-  ; CHECK: shr [[MASKREG:s[0-9]+]], s2, s1
+  ; CHECK: move [[BITREG:s[0-9]+]], 1
+  ; CHECK: shl [[BITREG]], [[BITREG]], 15
+  ; CHECK: shr [[MASKREG:s[0-9]+]], [[BITREG]], s1
   ; CHECK: move_mask v0, [[MASKREG]], s0
 
   ret <16 x i32> %result
@@ -22,8 +23,9 @@ define <16 x i32> @test_inserti(<16 x i32> %orig, i32 %value, i32 %lane) {	; CHE
 define <16 x float> @test_insertf(<16 x float> %orig, float %value, i32 %lane) { ; CHECK-LABEL: test_insertf:
   %result = insertelement <16 x float> %orig, float %value, i32 %lane
 
-  ; CHECK: load_32 s2, .LCPI
-  ; CHECK: shr [[MASKREG:s[0-9]+]], s2, s1
+  ; CHECK: move [[BITREG:s[0-9]+]], 1
+  ; CHECK: shl [[BITREG]], [[BITREG]], 15
+  ; CHECK: shr [[MASKREG:s[0-9]+]], [[BITREG]], s1
   ; CHECK: move_mask v0, [[MASKREG]], s0
 
   ret <16 x float> %result
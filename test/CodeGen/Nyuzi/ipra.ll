@@ -0,0 +1,48 @@
+; RUN: llc %s -o - | FileCheck %s
+; RUN: llc -nyuzi-ipra=false %s -o - | FileCheck %s -check-prefix=NOIPRA
+; RUN: llc -enable-ipra=false %s -o - | FileCheck %s -check-prefix=NOIPRA
+;
+; With interprocedural register allocation, callers only treat registers
+; that the callee actually modifies as clobbered, so live vectors can stay in
+; registers across calls to functions defined earlier in the module.
+;
+
+target triple = "nyuzi-elf-none"
+
+define internal <16 x i32> @helper(<16 x i32> %a) noinline {
+  %1 = mul <16 x i32> %a, %a
+  ret <16 x i32> %1
+}
+
+define <16 x i32> @caller(<16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL: caller:
+  ; CHECK-NOT: store_v
+  ; CHECK: call helper
+  ; CHECK-NOT: load_v
+  ; CHECK: ret
+
+  ; NOIPRA-LABEL: caller:
+  ; NOIPRA: store_v
+  ; NOIPRA: call helper
+  ; NOIPRA: load_v
+
+  %1 = call <16 x i32> @helper(<16 x i32> %a)
+  %2 = add <16 x i32> %1, %b
+  ret <16 x i32> %2
+}
+
+; Local functions don't save callee saved registers, but must still save
+; the link register if they make calls.
+define internal void @internal_nonleaf() noinline { ; CHECK-LABEL: internal_nonleaf:
+  ; CHECK: store_32 ra, {{[0-9]*}}(sp)
+  ; CHECK: call external
+  ; CHECK: load_32 ra, {{[0-9]*}}(sp)
+  call void @external()
+  ret void
+}
+
+declare void @external()
+
+define void @use_internal_nonleaf() {
+  call void @internal_nonleaf()
+  ret void
+}
@@ -14,9 +14,8 @@ define void @large_frame() {
   %1 = alloca [1024 x i32], align 4
 
   ; Ensure we allocate enough space
-  ; CHECK: move [[SIZEREG1:s[0-9+]]], -2
-  ; CHECK: shl [[SIZEREG1]], [[SIZEREG1]], 12
-  ; CHECK: or [[SIZEREG1]], [[SIZEREG1]], 4032
+  ; CHECK: move [[SIZEREG1:s[0-9+]]], -65
+  ; CHECK: shl [[SIZEREG1]], [[SIZEREG1]], 6
   ; CHECK: add_i sp, sp, [[SIZEREG1]]
   ; CHECK: .cfi_def_cfa_offset 4160
 
@@ -25,13 +24,34 @@ define void @large_frame() {
 
   ; CHECK: call dummy_func
 
-  ; CHECK: load_32 ra,
-
   ; Clean up stack
-  ; CHECK: move [[SIZEREG2:s[0-9]+]], 1
-  ; CHECK: shl [[SIZEREG2]], [[SIZEREG2]], 12
-  ; CHECK: or [[SIZEREG2]], [[SIZEREG2]], 64
+  ; CHECK-DAG: load_32 ra,
+  ; CHECK-DAG: move [[SIZEREG2:s[0-9]+]], 65
+  ; CHECK-DAG: shl [[SIZEREG2]], [[SIZEREG2]], 6
   ; CHECK: add_i sp, sp, [[SIZEREG2]]
 
   ret void
 }
+
+declare void @llvm.nyuzi.__builtin_nyuzi_block_storei_masked(<16 x i32>* %ptr,
+  <16 x i32> %value, i32 %mask)
+
+; Masked block stores only have a 10 bit offset field, so a stack object
+; that is further away than that must be addressed with a computed base
+; register, even though the frame would otherwise be small enough to use
+; immediate offsets.
+define void @masked_frame_offset(<16 x i32> %value, i32 %mask) { ; CHECK-LABEL: masked_frame_offset:
+  %1 = alloca [32 x <16 x i32>], align 64
+  %2 = getelementptr inbounds [32 x <16 x i32>], [32 x <16 x i32>]* %1, i32 0, i32 20
+  call void @llvm.nyuzi.__builtin_nyuzi_block_storei_masked(<16 x i32>* %2,
+    <16 x i32> %value, i32 %mask)
+
+  ; CHECK: shl [[ADDR:s[0-9]+]], [[ADDR]], 12
+  ; CHECK-NEXT: or [[ADDR]], [[ADDR]], {{[0-9]+}}
+  ; CHECK-NEXT: add_i [[ADDR]], sp, [[ADDR]]
+  ; CHECK-NEXT: store_v_mask v0, s0, ([[ADDR]])
+
+  %3 = bitcast [32 x <16 x i32>]* %1 to i32*
+  call void @dummy_func(i32* %3)
+  ret void
+}
@@ -0,0 +1,154 @@
+; RUN: llc %s -o - | FileCheck %s
+;
+; Runs of 16 adjacent 32-bit scalar loads or stores from a block aligned
+; address are merged into a single block load or store.
+;
+
+target triple = "nyuzi-elf-none"
+
+define void @block_copy(i32* %dst, i32* %src) { ; CHECK-LABEL: block_copy:
+  ; CHECK: load_v [[VAL:v[0-9]+]], (s1)
+  ; CHECK-NEXT: store_v [[VAL]], (s0)
+  ; CHECK-NOT: load_32
+  ; CHECK-NOT: store_32
+
+  %sp0 = getelementptr i32, i32* %src, i32 0
+  %v0 = load i32, i32* %sp0, align 64
+  %sp1 = getelementptr i32, i32* %src, i32 1
+  %v1 = load i32, i32* %sp1, align 4
+  %sp2 = getelementptr i32, i32* %src, i32 2
+  %v2 = load i32, i32* %sp2, align 4
+  %sp3 = getelementptr i32, i32* %src, i32 3
+  %v3 = load i32, i32* %sp3, align 4
+  %sp4 = getelementptr i32, i32* %src, i32 4
+  %v4 = load i32, i32* %sp4, align 4
+  %sp5 = getelementptr i32, i32* %src, i32 5
+  %v5 = load i32, i32* %sp5, align 4
+  %sp6 = getelementptr i32, i32* %src, i32 6
+  %v6 = load i32, i32* %sp6, align 4
+  %sp7 = getelementptr i32, i32* %src, i32 7
+  %v7 = load i32, i32* %sp7, align 4
+  %sp8 = getelementptr i32, i32* %src, i32 8
+  %v8 = load i32, i32* %sp8, align 4
+  %sp9 = getelementptr i32, i32* %src, i32 9
+  %v9 = load i32, i32* %sp9, align 4
+  %sp10 = getelementptr i32, i32* %src, i32 10
+  %v10 = load i32, i32* %sp10, align 4
+  %sp11 = getelementptr i32, i32* %src, i32 11
+  %v11 = load i32, i32* %sp11, align 4
+  %sp12 = getelementptr i32, i32* %src, i32 12
+  %v12 = load i32, i32* %sp12, align 4
+  %sp13 = getelementptr i32, i32* %src, i32 13
+  %v13 = load i32, i32* %sp13, align 4
+  %sp14 = getelementptr i32, i32* %src, i32 14
+  %v14 = load i32, i32* %sp14, align 4
+  %sp15 = getelementptr i32, i32* %src, i32 15
+  %v15 = load i32, i32* %sp15, align 4
+  %dp0 = getelementptr i32, i32* %dst, i32 0
+  store i32 %v0, i32* %dp0, align 64
+  %dp1 = getelementptr i32, i32* %dst, i32 1
+  store i32 %v1, i32* %dp1, align 4
+  %dp2 = getelementptr i32, i32* %dst, i32 2
+  store i32 %v2, i32* %dp2, align 4
+  %dp3 = getelementptr i32, i32* %dst, i32 3
+  store i32 %v3, i32* %dp3, align 4
+  %dp4 = getelementptr i32, i32* %dst, i32 4
+  store i32 %v4, i32* %dp4, align 4
+  %dp5 = getelementptr i32, i32* %dst, i32 5
+  store i32 %v5, i32* %dp5, align 4
+  %dp6 = getelementptr i32, i32* %dst, i32 6
+  store i32 %v6, i32* %dp6, align 4
+  %dp7 = getelementptr i32, i32* %dst, i32 7
+  store i32 %v7, i32* %dp7, align 4
+  %dp8 = getelementptr i32, i32* %dst, i32 8
+  store i32 %v8, i32* %dp8, align 4
+  %dp9 = getelementptr i32, i32* %dst, i32 9
+  store i32 %v9, i32* %dp9, align 4
+  %dp10 = getelementptr i32, i32* %dst, i32 10
+  store i32 %v10, i32* %dp10, align 4
+  %dp11 = getelementptr i32, i32* %dst, i32 11
+  store i32 %v11, i32* %dp11, align 4
+  %dp12 = getelementptr i32, i32* %dst, i32 12
+  store i32 %v12, i32* %dp12, align 4
+  %dp13 = getelementptr i32, i32* %dst, i32 13
+  store i32 %v13, i32* %dp13, align 4
+  %dp14 = getelementptr i32, i32* %dst, i32 14
+  store i32 %v14, i32* %dp14, align 4
+  %dp15 = getelementptr i32, i32* %dst, i32 15
+  store i32 %v15, i32* %dp15, align 4
+  ret void
+}
+
+; If alignment isn't known, the accesses stay scalar.
+define void @unaligned_copy(i32* %dst, i32* %src) { ; CHECK-LABEL: unaligned_copy:
+  ; CHECK-NOT: load_v
+  ; CHECK-NOT: store_v
+  ; CHECK: load_32
+  ; CHECK: store_32
+
+  %sp0 = getelementptr i32, i32* %src, i32 0
+  %v0 = load i32, i32* %sp0, align 4
+  %sp1 = getelementptr i32, i32* %src, i32 1
+  %v1 = load i32, i32* %sp1, align 4
+  %sp2 = getelementptr i32, i32* %src, i32 2
+  %v2 = load i32, i32* %sp2, align 4
+  %sp3 = getelementptr i32, i32* %src, i32 3
+  %v3 = load i32, i32* %sp3, align 4
+  %sp4 = getelementptr i32, i32* %src, i32 4
+  %v4 = load i32, i32* %sp4, align 4
+  %sp5 = getelementptr i32, i32* %src, i32 5
+  %v5 = load i32, i32* %sp5, align 4
+  %sp6 = getelementptr i32, i32* %src, i32 6
+  %v6 = load i32, i32* %sp6, align 4
+  %sp7 = getelementptr i32, i32* %src, i32 7
+  %v7 = load i32, i32* %sp7, align 4
+  %sp8 = getelementptr i32, i32* %src, i32 8
+  %v8 = load i32, i32* %sp8, align 4
+  %sp9 = getelementptr i32, i32* %src, i32 9
+  %v9 = load i32, i32* %sp9, align 4
+  %sp10 = getelementptr i32, i32* %src, i32 10
+  %v10 = load i32, i32* %sp10, align 4
+  %sp11 = getelementptr i32, i32* %src, i32 11
+  %v11 = load i32, i32* %sp11, align 4
+  %sp12 = getelementptr i32, i32* %src, i32 12
+  %v12 = load i32, i32* %sp12, align 4
+  %sp13 = getelementptr i32, i32* %src, i32 13
+  %v13 = load i32, i32* %sp13, align 4
+  %sp14 = getelementptr i32, i32* %src, i32 14
+  %v14 = load i32, i32* %sp14, align 4
+  %sp15 = getelementptr i32, i32* %src, i32 15
+  %v15 = load i32, i32* %sp15, align 4
+  %dp0 = getelementptr i32, i32* %dst, i32 0
+  store i32 %v0, i32* %dp0, align 4
+  %dp1 = getelementptr i32, i32* %dst, i32 1
+  store i32 %v1, i32* %dp1, align 4
+  %dp2 = getelementptr i32, i32* %dst, i32 2
+  store i32 %v2, i32* %dp2, align 4
+  %dp3 = getelementptr i32, i32* %dst, i32 3
+  store i32 %v3, i32* %dp3, align 4
+  %dp4 = getelementptr i32, i32* %dst, i32 4
+  store i32 %v4, i32* %dp4, align 4
+  %dp5 = getelementptr i32, i32* %dst, i32 5
+  store i32 %v5, i32* %dp5, align 4
+  %dp6 = getelementptr i32, i32* %dst, i32 6
+  store i32 %v6, i32* %dp6, align 4
+  %dp7 = getelementptr i32, i32* %dst, i32 7
+  store i32 %v7, i32* %dp7, align 4
+  %dp8 = getelementptr i32, i32* %dst, i32 8
+  store i32 %v8, i32* %dp8, align 4
+  %dp9 = getelementptr i32, i32* %dst, i32 9
+  store i32 %v9, i32* %dp9, align 4
+  %dp10 = getelementptr i32, i32* %dst, i32 10
+  store i32 %v10, i32* %dp10, align 4
+  %dp11 = getelementptr i32, i32* %dst, i32 11
+  store i32 %v11, i32* %dp11, align 4
+  %dp12 = getelementptr i32, i32* %dst, i32 12
+  store i32 %v12, i32* %dp12, align 4
+  %dp13 = getelementptr i32, i32* %dst, i32 13
+  store i32 %v13, i32* %dp13, align 4
+  %dp14 = getelementptr i32, i32* %dst, i32 14
+  store i32 %v14, i32* %dp14, align 4
+  %dp15 = getelementptr i32, i32* %dst, i32 15
+  store i32 %v15, i32* %dp15, align 4
+  ret void
+}
@@ -0,0 +1,31 @@
+; RUN: llc %s -o - -nyuzi-loop-prefetch | FileCheck %s
+; RUN: llc %s -o - | FileCheck %s -check-prefix=NOPREFETCH
+;
+; Insert prefetches for streaming loads in a loop. This is off by default.
+;
+
+target triple = "nyuzi-elf-none"
+
+define void @stream(float* noalias %dest, float* noalias %src, i32 %count) { ; CHECK-LABEL: stream:
+entry:
+  %empty = icmp eq i32 %count, 0
+  br i1 %empty, label %exit, label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %inc, %loop ]
+  %srcaddr = getelementptr float, float* %src, i32 %i
+  %val = load float, float* %srcaddr
+  %scaled = fmul float %val, %val
+  %destaddr = getelementptr float, float* %dest, i32 %i
+  store float %scaled, float* %destaddr
+  %inc = add i32 %i, 1
+  %done = icmp eq i32 %inc, %count
+  br i1 %done, label %exit, label %loop
+
+; CHECK: load_u8
+; CHECK: load_32
+; NOPREFETCH-NOT: load_u8
+
+exit:
+  ret void
+}
@@ -0,0 +1,114 @@
+; RUN: llc %s -o - | FileCheck %s
+;
+; Generic masked memory intrinsics are lowered to native masked block
+; load/stores and scatter/gathers rather than being scalarized.
+;
+
+target triple = "nyuzi-elf-none"
+
+declare <16 x i32> @llvm.masked.load.v16i32.p0v16i32(<16 x i32>*, i32, <16 x i1>, <16 x i32>)
+declare <16 x float> @llvm.masked.load.v16f32.p0v16f32(<16 x float>*, i32, <16 x i1>, <16 x float>)
+declare void @llvm.masked.store.v16i32.p0v16i32(<16 x i32>, <16 x i32>*, i32, <16 x i1>)
+declare <16 x i32> @llvm.masked.gather.v16i32(<16 x i32*>, i32, <16 x i1>, <16 x i32>)
+declare <16 x float> @llvm.masked.gather.v16f32(<16 x float*>, i32, <16 x i1>, <16 x float>)
+declare void @llvm.masked.scatter.v16i32(<16 x i32>, <16 x i32*>, i32, <16 x i1>)
+
+define <16 x i32> @masked_load_aligned(<16 x i32>* %ptr, <16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL: masked_load_aligned:
+  %mask = icmp sgt <16 x i32> %a, %b
+  %1 = call <16 x i32> @llvm.masked.load.v16i32.p0v16i32(<16 x i32>* %ptr, i32 64, <16 x i1> %mask, <16 x i32> undef)
+
+  ; CHECK: cmpgt_i [[MASK:s[0-9]+]], v0, v1
+  ; CHECK: load_v_mask v0, [[MASK]], (s0)
+  ; CHECK-NOT: load_32
+
+  ret <16 x i32> %1
+}
+
+define <16 x float> @masked_load_unaligned(<16 x float>* %ptr, <16 x i32> %a, <16 x i32> %b, <16 x float> %passthru) { ; CHECK-LABEL: masked_load_unaligned:
+  %mask = icmp eq <16 x i32> %a, %b
+  %1 = call <16 x float> @llvm.masked.load.v16f32.p0v16f32(<16 x float>* %ptr, i32 4, <16 x i1> %mask, <16 x float> %passthru)
+
+  ; CHECK: cmpeq_i [[MASK:s[0-9]+]], v0, v1
+  ; CHECK: load_gath_mask [[RESULT:v[0-9]+]], [[MASK]], (v{{[0-9]+}})
+  ; CHECK: move_mask v2, [[MASK]], [[RESULT]]
+
+  ret <16 x float> %1
+}
+
+define void @masked_store(<16 x i32>* %ptr, <16 x i32> %value, <16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL: masked_store:
+  %mask = icmp ult <16 x i32> %a, %b
+  call void @llvm.masked.store.v16i32.p0v16i32(<16 x i32> %value, <16 x i32>* %ptr, i32 64, <16 x i1> %mask)
+
+  ; CHECK: cmplt_u [[MASK:s[0-9]+]], v1, v2
+  ; CHECK: store_v_mask v0, [[MASK]], (s0)
+
+  ret void
+}
+
+define <16 x i32> @masked_gather(<16 x i32*> %ptrs, <16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL: masked_gather:
+  %mask = icmp ne <16 x i32> %a, %b
+  %1 = call <16 x i32> @llvm.masked.gather.v16i32(<16 x i32*> %ptrs, i32 4, <16 x i1> %mask, <16 x i32> undef)
+
+  ; CHECK: cmpne_i [[MASK:s[0-9]+]], v1, v2
+  ; CHECK: load_gath_mask v0, [[MASK]], (v0)
+
+  ret <16 x i32> %1
+}
+
+define <16 x float> @masked_gather_indexed(float* %base, <16 x i32> %index, <16 x i32> %a) { ; CHECK-LABEL: masked_gather_indexed:
+  %ptrs = getelementptr float, float* %base, <16 x i32> %index
+  %mask = icmp slt <16 x i32> %a, zeroinitializer
+  %1 = call <16 x float> @llvm.masked.gather.v16f32(<16 x float*> %ptrs, i32 4, <16 x i1> %mask, <16 x float> undef)
+
+  ; CHECK: shl [[OFFSETS:v[0-9]+]], v0, 2
+  ; CHECK: add_i [[ADDRS:v[0-9]+]], [[OFFSETS]], s0
+  ; CHECK: load_gath_mask v0, s{{[0-9]+}}, ([[ADDRS]])
+
+  ret <16 x float> %1
+}
+
+define void @masked_scatter(<16 x i32> %value, <16 x i32*> %ptrs, <16 x i32> %maskvec) { ; CHECK-LABEL: masked_scatter:
+  ; This mask doesn't come from a compare, so it needs to be converted.
+  %mask = trunc <16 x i32> %maskvec to <16 x i1>
+  call void @llvm.masked.scatter.v16i32(<16 x i32> %value, <16 x i32*> %ptrs, i32 4, <16 x i1> %mask)
+
+  ; CHECK: and [[LOWBITS:v[0-9]+]], v2, 1
+  ; CHECK: cmpne_i [[MASK:s[0-9]+]], [[LOWBITS]], 0
+  ; CHECK: store_scat_mask v0, [[MASK]], (v1)
+
+  ret void
+}
+
+; A GEP with i64 indices produces a 64 bit index vector. It is truncated
+; rather than splitting the gather.
+define <16 x float> @masked_gather_index64(float* %base, <16 x i32> %index, <16 x i32> %a) { ; CHECK-LABEL: masked_gather_index64:
+  %index64 = zext <16 x i32> %index to <16 x i64>
+  %ptrs = getelementptr float, float* %base, <16 x i64> %index64
+  %mask = icmp slt <16 x i32> %a, zeroinitializer
+  %1 = call <16 x float> @llvm.masked.gather.v16f32(<16 x float*> %ptrs, i32 4, <16 x i1> %mask, <16 x float> undef)
+
+  ; CHECK: shl [[OFFSETS:v[0-9]+]], v0, 2
+  ; CHECK: add_i [[ADDRS:v[0-9]+]], [[OFFSETS]], s0
+  ; CHECK: load_gath_mask v0, s{{[0-9]+}}, ([[ADDRS]])
+  ; CHECK-NOT: load_gath_mask
+
+  ret <16 x float> %1
+}
+
+; A sign extended narrow index is used at its original width and extended
+; to 32 bits.
+define void @masked_scatter_index16(<16 x i32> %value, i32* %base, <16 x i16> %index, <16 x i32> %a) { ; CHECK-LABEL: masked_scatter_index16:
+  %index64 = sext <16 x i16> %index to <16 x i64>
+  %ptrs = getelementptr i32, i32* %base, <16 x i64> %index64
+  %mask = icmp slt <16 x i32> %a, zeroinitializer
+  call void @llvm.masked.scatter.v16i32(<16 x i32> %value, <16 x i32*> %ptrs, i32 4, <16 x i1> %mask)
+
+  ; CHECK: shl [[EXT:v[0-9]+]], v1, 16
+  ; CHECK: ashr [[INDEX:v[0-9]+]], [[EXT]], 16
+  ; CHECK: shl [[OFFSETS:v[0-9]+]], [[INDEX]], 2
+  ; CHECK: add_i [[ADDRS:v[0-9]+]], [[OFFSETS]], s0
+  ; CHECK: store_scat_mask v0, s{{[0-9]+}}, ([[ADDRS]])
+  ; CHECK-NOT: store_scat_mask
+
+  ret void
+}
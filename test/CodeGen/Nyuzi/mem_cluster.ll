@@ -0,0 +1,49 @@
+; RUN: llc %s -o - | FileCheck %s
+;
+; Check that the machine scheduler keeps loads from the same base register
+; together, so they issue back to back instead of being interleaved with
+; the arithmetic that consumes them.
+;
+
+target triple = "nyuzi-elf-none"
+
+define <16 x i32> @cluster_block_loads(<16 x i32>* %ptr) { ; CHECK-LABEL: cluster_block_loads:
+  %ptr1 = getelementptr <16 x i32>, <16 x i32>* %ptr, i32 1
+  %ptr2 = getelementptr <16 x i32>, <16 x i32>* %ptr, i32 2
+  %ptr3 = getelementptr <16 x i32>, <16 x i32>* %ptr, i32 3
+  %a = load <16 x i32>, <16 x i32>* %ptr
+  %b = load <16 x i32>, <16 x i32>* %ptr1
+  %sum1 = add <16 x i32> %a, %b
+  %c = load <16 x i32>, <16 x i32>* %ptr2
+  %sum2 = add <16 x i32> %sum1, %c
+  %d = load <16 x i32>, <16 x i32>* %ptr3
+  %sum3 = add <16 x i32> %sum2, %d
+
+  ; CHECK: load_v v{{[0-9]+}}, (s0)
+  ; CHECK-NEXT: load_v v{{[0-9]+}}, 64(s0)
+  ; CHECK-NEXT: load_v v{{[0-9]+}}, 128(s0)
+  ; CHECK: load_v v{{[0-9]+}}, 192(s0)
+
+  ret <16 x i32> %sum3
+}
+
+define i32 @cluster_scalar_loads(i32* %ptr) { ; CHECK-LABEL: cluster_scalar_loads:
+  %ptr1 = getelementptr i32, i32* %ptr, i32 1
+  %ptr2 = getelementptr i32, i32* %ptr, i32 2
+  %ptr3 = getelementptr i32, i32* %ptr, i32 3
+  %a = load i32, i32* %ptr
+  %b = load i32, i32* %ptr1
+  %sum1 = add i32 %a, %b
+  %c = load i32, i32* %ptr2
+  %sum2 = add i32 %sum1, %c
+  %d = load i32, i32* %ptr3
+  %sum3 = add i32 %sum2, %d
+
+  ; CHECK: load_32 s{{[0-9]+}}, (s0)
+  ; CHECK-NEXT: load_32 s{{[0-9]+}}, 4(s0)
+  ; CHECK-NEXT: load_32 s{{[0-9]+}}, 8(s0)
+  ; CHECK-NEXT: load_32 s{{[0-9]+}}, 12(s0)
+  ; CHECK-NEXT: add_i
+
+  ret i32 %sum3
+}
@@ -0,0 +1,85 @@
+; RUN: llc %s -o - | FileCheck %s
+;
+; Copies and fills of up to 1k with a constant size use block loads and
+; stores, with masked accesses for partial blocks.
+;
+
+target triple = "nyuzi-elf-none"
+
+declare void @llvm.memcpy.p0i8.p0i8.i32(i8*, i8*, i32, i32, i1)
+declare void @llvm.memmove.p0i8.p0i8.i32(i8*, i8*, i32, i32, i1)
+declare void @llvm.memset.p0i8.i32(i8*, i8, i32, i32, i1)
+
+define void @copy_blocks(i8* %dst, i8* %src) { ; CHECK-LABEL: copy_blocks:
+  call void @llvm.memcpy.p0i8.p0i8.i32(i8* %dst, i8* %src, i32 128, i32 64, i1 false)
+
+  ; CHECK-DAG: load_v [[VAL1:v[0-9]+]], (s1)
+  ; CHECK-DAG: load_v [[VAL2:v[0-9]+]], 64(s1)
+  ; CHECK-DAG: store_v [[VAL1]], (s0)
+  ; CHECK-DAG: store_v [[VAL2]], 64(s0)
+  ; CHECK-NOT: call memcpy
+
+  ret void
+}
+
+; The last 8 bytes are copied with a masked load and store of the first two
+; lanes.
+define void @copy_partial_block(i8* %dst, i8* %src) { ; CHECK-LABEL: copy_partial_block:
+  call void @llvm.memcpy.p0i8.p0i8.i32(i8* %dst, i8* %src, i32 72, i32 64, i1 false)
+
+  ; CHECK-DAG: load_v {{v[0-9]+}}, (s1)
+  ; CHECK-DAG: load_v_mask [[TAIL:v[0-9]+]], [[MASK:s[0-9]+]], 64(s1)
+  ; CHECK-DAG: store_v_mask [[TAIL]], [[MASK]], 64(s0)
+  ; CHECK-NOT: call memcpy
+
+  ret void
+}
+
+define void @move_blocks(i8* %dst, i8* %src) { ; CHECK-LABEL: move_blocks:
+  call void @llvm.memmove.p0i8.p0i8.i32(i8* %dst, i8* %src, i32 128, i32 64, i1 false)
+
+  ; Both loads happen before either store, in case the buffers overlap.
+  ; CHECK: load_v
+  ; CHECK: load_v
+  ; CHECK: store_v
+  ; CHECK: store_v
+  ; CHECK-NOT: call memmove
+
+  ret void
+}
+
+; If the buffers may not be block aligned, use the library.
+define void @copy_unaligned(i8* %dst, i8* %src) { ; CHECK-LABEL: copy_unaligned:
+  call void @llvm.memcpy.p0i8.p0i8.i32(i8* %dst, i8* %src, i32 128, i32 4, i1 false)
+
+  ; CHECK-NOT: load_v
+  ; CHECK: call memcpy
+
+  ret void
+}
+
+define void @fill_blocks(i8* %dst, i8 %value) { ; CHECK-LABEL: fill_blocks:
+  call void @llvm.memset.p0i8.i32(i8* %dst, i8 %value, i32 128, i32 64, i1 false)
+
+  ; CHECK: move [[SCALE:s[0-9]+]], 257
+  ; CHECK: mull_i {{s[0-9]+}}
+  ; CHECK-DAG: store_v [[FILL:v[0-9]+]], (s0)
+  ; CHECK-DAG: store_v [[FILL]], 64(s0)
+  ; CHECK-NOT: call memset
+
+  ret void
+}
+
+; The destination is only known to be word aligned. Round down to a block
+; boundary and mask the first and last blocks.
+define void @fill_unaligned(i8* %dst) { ; CHECK-LABEL: fill_unaligned:
+  call void @llvm.memset.p0i8.i32(i8* %dst, i8 0, i32 128, i32 4, i1 false)
+
+  ; CHECK: and [[BASE:s[0-9]+]], s0, -64
+  ; CHECK-DAG: store_v_mask [[FILL:v[0-9]+]], {{s[0-9]+}}, ([[BASE]])
+  ; CHECK-DAG: store_v [[FILL]], 64([[BASE]])
+  ; CHECK-DAG: store_v_mask [[FILL]], {{s[0-9]+}}, ({{s[0-9]+}})
+  ; CHECK-NOT: call memset
+
+  ret void
+}
@@ -0,0 +1,39 @@
+; RUN: llc %s -o - -enable-misched | FileCheck %s
+;
+; Check that the machine scheduler uses the Nyuzi machine model to hide
+; floating point latency by interleaving independent dependency chains.
+;
+
+target triple = "nyuzi-elf-none"
+
+define float @interleave_scalar(float %a, float %b, float %c, float %d) { ; CHECK-LABEL: interleave_scalar:
+  %1 = fmul float %a, %b
+  %2 = fadd float %1, %a
+  %3 = fmul float %c, %d
+  %4 = fadd float %3, %c
+
+  ; CHECK: mul_f
+  ; CHECK-NEXT: mul_f
+  ; CHECK-NEXT: add_f
+  ; CHECK-NEXT: add_f
+  ; CHECK-NEXT: mul_f
+
+  %5 = fmul float %2, %4
+  ret float %5
+}
+
+define <16 x float> @interleave_vector(<16 x float> %a, <16 x float> %b, <16 x float> %c, <16 x float> %d) { ; CHECK-LABEL: interleave_vector:
+  %1 = fmul <16 x float> %a, %b
+  %2 = fadd <16 x float> %1, %a
+  %3 = fmul <16 x float> %c, %d
+  %4 = fadd <16 x float> %3, %c
+
+  ; CHECK: mul_f
+  ; CHECK-NEXT: mul_f
+  ; CHECK-NEXT: add_f
+  ; CHECK-NEXT: add_f
+  ; CHECK-NEXT: mul_f
+
+  %5 = fmul <16 x float> %2, %4
+  ret <16 x float> %5
+}
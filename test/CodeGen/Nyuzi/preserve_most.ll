@@ -0,0 +1,44 @@
+; RUN: llc %s -o - | FileCheck %s
+;
+; The preserve_most calling convention passes up to 16 vector arguments in
+; registers, and the callee preserves everything except the argument and
+; return registers, so callers don't spill live vectors around the call.
+;
+
+target triple = "nyuzi-elf-none"
+
+define preserve_mostcc <16 x i32> @helper(<16 x i32> %arg0, <16 x i32> %arg1,
+  <16 x i32> %arg2, <16 x i32> %arg3, <16 x i32> %arg4, <16 x i32> %arg5,
+  <16 x i32> %arg6, <16 x i32> %arg7, <16 x i32> %arg8, <16 x i32> %arg9) { ; CHECK-LABEL: helper:
+
+  ; Arguments past the eighth are still in registers
+  ; CHECK-NOT: load_v
+  ; CHECK: add_i v{{[0-9]+}}, v{{[0-9]+}}, v9
+
+  %1 = add <16 x i32> %arg0, %arg8
+  %2 = add <16 x i32> %1, %arg9
+  ret <16 x i32> %2
+}
+
+; The callee must save vector registers that would be caller saved in the
+; default convention.
+define preserve_mostcc void @clobbers_v16() { ; CHECK-LABEL: clobbers_v16:
+  ; CHECK: store_v v16, {{[0-9]*}}(sp)
+  ; CHECK: load_v v16, {{[0-9]*}}(sp)
+  call void asm sideeffect "", "~{v16}"()
+  ret void
+}
+
+declare preserve_mostcc <16 x i32> @external_helper(<16 x i32>)
+
+define <16 x i32> @caller(<16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL: caller:
+  ; %b is live across the call, but it can stay in a preserved register.
+  ; CHECK-NOT: store_v
+  ; CHECK: call external_helper
+  ; CHECK-NOT: load_v
+  ; CHECK: ret
+
+  %1 = call preserve_mostcc <16 x i32> @external_helper(<16 x i32> %a)
+  %2 = add <16 x i32> %1, %b
+  ret <16 x i32> %2
+}
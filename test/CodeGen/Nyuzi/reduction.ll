@@ -0,0 +1,583 @@
+; RUN: llc %s -o - | FileCheck %s
+;
+; Test that a scalar reduction of all lanes of a vector is computed with a
+; shuffle/combine tree rather than extracting each lane and combining the
+; results serially (see NyuziTargetLowering::PerformDAGCombine). The serial
+; form takes 31 instructions: 16 getlane and 15 scalar operations. The tree
+; takes 4 shuffles and 4 vector operations, plus a single getlane. The
+; shuffle indices are computed from the lane index vector, which is loop
+; invariant.
+
+target triple = "nyuzi-elf-none"
+
+define i32 @reduce_add(<16 x i32> %a) { ; CHECK-LABEL: reduce_add:
+  %e0 = extractelement <16 x i32> %a, i32 0
+  %e1 = extractelement <16 x i32> %a, i32 1
+  %e2 = extractelement <16 x i32> %a, i32 2
+  %e3 = extractelement <16 x i32> %a, i32 3
+  %e4 = extractelement <16 x i32> %a, i32 4
+  %e5 = extractelement <16 x i32> %a, i32 5
+  %e6 = extractelement <16 x i32> %a, i32 6
+  %e7 = extractelement <16 x i32> %a, i32 7
+  %e8 = extractelement <16 x i32> %a, i32 8
+  %e9 = extractelement <16 x i32> %a, i32 9
+  %e10 = extractelement <16 x i32> %a, i32 10
+  %e11 = extractelement <16 x i32> %a, i32 11
+  %e12 = extractelement <16 x i32> %a, i32 12
+  %e13 = extractelement <16 x i32> %a, i32 13
+  %e14 = extractelement <16 x i32> %a, i32 14
+  %e15 = extractelement <16 x i32> %a, i32 15
+  %s1 = add i32 %e0, %e1
+  %s2 = add i32 %s1, %e2
+  %s3 = add i32 %s2, %e3
+  %s4 = add i32 %s3, %e4
+  %s5 = add i32 %s4, %e5
+  %s6 = add i32 %s5, %e6
+  %s7 = add i32 %s6, %e7
+  %s8 = add i32 %s7, %e8
+  %s9 = add i32 %s8, %e9
+  %s10 = add i32 %s9, %e10
+  %s11 = add i32 %s10, %e11
+  %s12 = add i32 %s11, %e12
+  %s13 = add i32 %s12, %e13
+  %s14 = add i32 %s13, %e14
+  %s15 = add i32 %s14, %e15
+
+  ; CHECK-NOT: getlane
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: add_i {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: add_i {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: add_i {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: add_i {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: getlane s0, {{v[0-9]+}}, 0
+  ; CHECK-NOT: getlane
+
+  ret i32 %s15
+}
+
+; Operands combined in a different order
+define i32 @reduce_xor_pairwise(<16 x i32> %a) { ; CHECK-LABEL: reduce_xor_pairwise:
+  %e0 = extractelement <16 x i32> %a, i32 0
+  %e1 = extractelement <16 x i32> %a, i32 1
+  %e2 = extractelement <16 x i32> %a, i32 2
+  %e3 = extractelement <16 x i32> %a, i32 3
+  %e4 = extractelement <16 x i32> %a, i32 4
+  %e5 = extractelement <16 x i32> %a, i32 5
+  %e6 = extractelement <16 x i32> %a, i32 6
+  %e7 = extractelement <16 x i32> %a, i32 7
+  %e8 = extractelement <16 x i32> %a, i32 8
+  %e9 = extractelement <16 x i32> %a, i32 9
+  %e10 = extractelement <16 x i32> %a, i32 10
+  %e11 = extractelement <16 x i32> %a, i32 11
+  %e12 = extractelement <16 x i32> %a, i32 12
+  %e13 = extractelement <16 x i32> %a, i32 13
+  %e14 = extractelement <16 x i32> %a, i32 14
+  %e15 = extractelement <16 x i32> %a, i32 15
+  %s0 = xor i32 %e0, %e1
+  %s1 = xor i32 %e2, %e3
+  %s2 = xor i32 %e4, %e5
+  %s3 = xor i32 %e6, %e7
+  %s4 = xor i32 %e8, %e9
+  %s5 = xor i32 %e10, %e11
+  %s6 = xor i32 %e12, %e13
+  %s7 = xor i32 %e14, %e15
+  %s8 = xor i32 %s0, %s1
+  %s9 = xor i32 %s2, %s3
+  %s10 = xor i32 %s4, %s5
+  %s11 = xor i32 %s6, %s7
+  %s12 = xor i32 %s8, %s9
+  %s13 = xor i32 %s10, %s11
+  %s14 = xor i32 %s12, %s13
+
+  ; CHECK-NOT: getlane
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: xor {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: xor {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: xor {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: xor {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: getlane s0, {{v[0-9]+}}, 0
+  ; CHECK-NOT: getlane
+
+  ret i32 %s14
+}
+
+; Floating point operations can only be reassociated with fast math flags
+define float @reduce_fadd_fast(<16 x float> %a) { ; CHECK-LABEL: reduce_fadd_fast:
+  %e0 = extractelement <16 x float> %a, i32 0
+  %e1 = extractelement <16 x float> %a, i32 1
+  %e2 = extractelement <16 x float> %a, i32 2
+  %e3 = extractelement <16 x float> %a, i32 3
+  %e4 = extractelement <16 x float> %a, i32 4
+  %e5 = extractelement <16 x float> %a, i32 5
+  %e6 = extractelement <16 x float> %a, i32 6
+  %e7 = extractelement <16 x float> %a, i32 7
+  %e8 = extractelement <16 x float> %a, i32 8
+  %e9 = extractelement <16 x float> %a, i32 9
+  %e10 = extractelement <16 x float> %a, i32 10
+  %e11 = extractelement <16 x float> %a, i32 11
+  %e12 = extractelement <16 x float> %a, i32 12
+  %e13 = extractelement <16 x float> %a, i32 13
+  %e14 = extractelement <16 x float> %a, i32 14
+  %e15 = extractelement <16 x float> %a, i32 15
+  %s1 = fadd fast float %e0, %e1
+  %s2 = fadd fast float %s1, %e2
+  %s3 = fadd fast float %s2, %e3
+  %s4 = fadd fast float %s3, %e4
+  %s5 = fadd fast float %s4, %e5
+  %s6 = fadd fast float %s5, %e6
+  %s7 = fadd fast float %s6, %e7
+  %s8 = fadd fast float %s7, %e8
+  %s9 = fadd fast float %s8, %e9
+  %s10 = fadd fast float %s9, %e10
+  %s11 = fadd fast float %s10, %e11
+  %s12 = fadd fast float %s11, %e12
+  %s13 = fadd fast float %s12, %e13
+  %s14 = fadd fast float %s13, %e14
+  %s15 = fadd fast float %s14, %e15
+
+  ; CHECK-NOT: getlane
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: add_f {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: add_f {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: add_f {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: add_f {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: getlane s0, {{v[0-9]+}}, 0
+  ; CHECK-NOT: getlane
+
+  ret float %s15
+}
+
+define float @reduce_fadd_strict(<16 x float> %a) { ; CHECK-LABEL: reduce_fadd_strict:
+  %e0 = extractelement <16 x float> %a, i32 0
+  %e1 = extractelement <16 x float> %a, i32 1
+  %e2 = extractelement <16 x float> %a, i32 2
+  %e3 = extractelement <16 x float> %a, i32 3
+  %e4 = extractelement <16 x float> %a, i32 4
+  %e5 = extractelement <16 x float> %a, i32 5
+  %e6 = extractelement <16 x float> %a, i32 6
+  %e7 = extractelement <16 x float> %a, i32 7
+  %e8 = extractelement <16 x float> %a, i32 8
+  %e9 = extractelement <16 x float> %a, i32 9
+  %e10 = extractelement <16 x float> %a, i32 10
+  %e11 = extractelement <16 x float> %a, i32 11
+  %e12 = extractelement <16 x float> %a, i32 12
+  %e13 = extractelement <16 x float> %a, i32 13
+  %e14 = extractelement <16 x float> %a, i32 14
+  %e15 = extractelement <16 x float> %a, i32 15
+  %s1 = fadd float %e0, %e1
+  %s2 = fadd float %s1, %e2
+  %s3 = fadd float %s2, %e3
+  %s4 = fadd float %s3, %e4
+  %s5 = fadd float %s4, %e5
+  %s6 = fadd float %s5, %e6
+  %s7 = fadd float %s6, %e7
+  %s8 = fadd float %s7, %e8
+  %s9 = fadd float %s8, %e9
+  %s10 = fadd float %s9, %e10
+  %s11 = fadd float %s10, %e11
+  %s12 = fadd float %s11, %e12
+  %s13 = fadd float %s12, %e13
+  %s14 = fadd float %s13, %e14
+  %s15 = fadd float %s14, %e15
+
+  ; CHECK-NOT: shuffle
+  ; CHECK: getlane
+  ; CHECK: ret
+
+  ret float %s15
+}
+
+; Max is a compare and a masked move at each step
+define i32 @reduce_smax(<16 x i32> %a) { ; CHECK-LABEL: reduce_smax:
+  %e0 = extractelement <16 x i32> %a, i32 0
+  %e1 = extractelement <16 x i32> %a, i32 1
+  %e2 = extractelement <16 x i32> %a, i32 2
+  %e3 = extractelement <16 x i32> %a, i32 3
+  %e4 = extractelement <16 x i32> %a, i32 4
+  %e5 = extractelement <16 x i32> %a, i32 5
+  %e6 = extractelement <16 x i32> %a, i32 6
+  %e7 = extractelement <16 x i32> %a, i32 7
+  %e8 = extractelement <16 x i32> %a, i32 8
+  %e9 = extractelement <16 x i32> %a, i32 9
+  %e10 = extractelement <16 x i32> %a, i32 10
+  %e11 = extractelement <16 x i32> %a, i32 11
+  %e12 = extractelement <16 x i32> %a, i32 12
+  %e13 = extractelement <16 x i32> %a, i32 13
+  %e14 = extractelement <16 x i32> %a, i32 14
+  %e15 = extractelement <16 x i32> %a, i32 15
+  %c1 = icmp sgt i32 %e0, %e1
+  %m1 = select i1 %c1, i32 %e0, i32 %e1
+  %c2 = icmp sgt i32 %m1, %e2
+  %m2 = select i1 %c2, i32 %m1, i32 %e2
+  %c3 = icmp sgt i32 %m2, %e3
+  %m3 = select i1 %c3, i32 %m2, i32 %e3
+  %c4 = icmp sgt i32 %m3, %e4
+  %m4 = select i1 %c4, i32 %m3, i32 %e4
+  %c5 = icmp sgt i32 %m4, %e5
+  %m5 = select i1 %c5, i32 %m4, i32 %e5
+  %c6 = icmp sgt i32 %m5, %e6
+  %m6 = select i1 %c6, i32 %m5, i32 %e6
+  %c7 = icmp sgt i32 %m6, %e7
+  %m7 = select i1 %c7, i32 %m6, i32 %e7
+  %c8 = icmp sgt i32 %m7, %e8
+  %m8 = select i1 %c8, i32 %m7, i32 %e8
+  %c9 = icmp sgt i32 %m8, %e9
+  %m9 = select i1 %c9, i32 %m8, i32 %e9
+  %c10 = icmp sgt i32 %m9, %e10
+  %m10 = select i1 %c10, i32 %m9, i32 %e10
+  %c11 = icmp sgt i32 %m10, %e11
+  %m11 = select i1 %c11, i32 %m10, i32 %e11
+  %c12 = icmp sgt i32 %m11, %e12
+  %m12 = select i1 %c12, i32 %m11, i32 %e12
+  %c13 = icmp sgt i32 %m12, %e13
+  %m13 = select i1 %c13, i32 %m12, i32 %e13
+  %c14 = icmp sgt i32 %m13, %e14
+  %m14 = select i1 %c14, i32 %m13, i32 %e14
+  %c15 = icmp sgt i32 %m14, %e15
+  %m15 = select i1 %c15, i32 %m14, i32 %e15
+
+  ; CHECK-NOT: getlane
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: cmpgt_i [[MASKX:s[0-9]+]], {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: move_mask {{v[0-9]+}}, [[MASKX]], {{v[0-9]+}}
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: cmpgt_i [[MASKX:s[0-9]+]], {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: move_mask {{v[0-9]+}}, [[MASKX]], {{v[0-9]+}}
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: cmpgt_i [[MASKX:s[0-9]+]], {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: move_mask {{v[0-9]+}}, [[MASKX]], {{v[0-9]+}}
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: cmpgt_i [[MASKX:s[0-9]+]], {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: move_mask {{v[0-9]+}}, [[MASKX]], {{v[0-9]+}}
+  ; CHECK: getlane s0, {{v[0-9]+}}, 0
+  ; CHECK-NOT: getlane
+
+  ret i32 %m15
+}
+
+define i32 @reduce_mul(<16 x i32> %a) { ; CHECK-LABEL: reduce_mul:
+  %e0 = extractelement <16 x i32> %a, i32 0
+  %e1 = extractelement <16 x i32> %a, i32 1
+  %e2 = extractelement <16 x i32> %a, i32 2
+  %e3 = extractelement <16 x i32> %a, i32 3
+  %e4 = extractelement <16 x i32> %a, i32 4
+  %e5 = extractelement <16 x i32> %a, i32 5
+  %e6 = extractelement <16 x i32> %a, i32 6
+  %e7 = extractelement <16 x i32> %a, i32 7
+  %e8 = extractelement <16 x i32> %a, i32 8
+  %e9 = extractelement <16 x i32> %a, i32 9
+  %e10 = extractelement <16 x i32> %a, i32 10
+  %e11 = extractelement <16 x i32> %a, i32 11
+  %e12 = extractelement <16 x i32> %a, i32 12
+  %e13 = extractelement <16 x i32> %a, i32 13
+  %e14 = extractelement <16 x i32> %a, i32 14
+  %e15 = extractelement <16 x i32> %a, i32 15
+  %s1 = mul i32 %e0, %e1
+  %s2 = mul i32 %s1, %e2
+  %s3 = mul i32 %s2, %e3
+  %s4 = mul i32 %s3, %e4
+  %s5 = mul i32 %s4, %e5
+  %s6 = mul i32 %s5, %e6
+  %s7 = mul i32 %s6, %e7
+  %s8 = mul i32 %s7, %e8
+  %s9 = mul i32 %s8, %e9
+  %s10 = mul i32 %s9, %e10
+  %s11 = mul i32 %s10, %e11
+  %s12 = mul i32 %s11, %e12
+  %s13 = mul i32 %s12, %e13
+  %s14 = mul i32 %s13, %e14
+  %s15 = mul i32 %s14, %e15
+
+  ; CHECK-NOT: getlane
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: mull_i {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: mull_i {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: mull_i {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: mull_i {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: getlane s0, {{v[0-9]+}}, 0
+  ; CHECK-NOT: getlane
+
+  ret i32 %s15
+}
+
+define i32 @reduce_and(<16 x i32> %a) { ; CHECK-LABEL: reduce_and:
+  %e0 = extractelement <16 x i32> %a, i32 0
+  %e1 = extractelement <16 x i32> %a, i32 1
+  %e2 = extractelement <16 x i32> %a, i32 2
+  %e3 = extractelement <16 x i32> %a, i32 3
+  %e4 = extractelement <16 x i32> %a, i32 4
+  %e5 = extractelement <16 x i32> %a, i32 5
+  %e6 = extractelement <16 x i32> %a, i32 6
+  %e7 = extractelement <16 x i32> %a, i32 7
+  %e8 = extractelement <16 x i32> %a, i32 8
+  %e9 = extractelement <16 x i32> %a, i32 9
+  %e10 = extractelement <16 x i32> %a, i32 10
+  %e11 = extractelement <16 x i32> %a, i32 11
+  %e12 = extractelement <16 x i32> %a, i32 12
+  %e13 = extractelement <16 x i32> %a, i32 13
+  %e14 = extractelement <16 x i32> %a, i32 14
+  %e15 = extractelement <16 x i32> %a, i32 15
+  %s1 = and i32 %e0, %e1
+  %s2 = and i32 %s1, %e2
+  %s3 = and i32 %s2, %e3
+  %s4 = and i32 %s3, %e4
+  %s5 = and i32 %s4, %e5
+  %s6 = and i32 %s5, %e6
+  %s7 = and i32 %s6, %e7
+  %s8 = and i32 %s7, %e8
+  %s9 = and i32 %s8, %e9
+  %s10 = and i32 %s9, %e10
+  %s11 = and i32 %s10, %e11
+  %s12 = and i32 %s11, %e12
+  %s13 = and i32 %s12, %e13
+  %s14 = and i32 %s13, %e14
+  %s15 = and i32 %s14, %e15
+
+  ; CHECK-NOT: getlane
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: and {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: and {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: and {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: and {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: getlane s0, {{v[0-9]+}}, 0
+  ; CHECK-NOT: getlane
+
+  ret i32 %s15
+}
+
+define i32 @reduce_or(<16 x i32> %a) { ; CHECK-LABEL: reduce_or:
+  %e0 = extractelement <16 x i32> %a, i32 0
+  %e1 = extractelement <16 x i32> %a, i32 1
+  %e2 = extractelement <16 x i32> %a, i32 2
+  %e3 = extractelement <16 x i32> %a, i32 3
+  %e4 = extractelement <16 x i32> %a, i32 4
+  %e5 = extractelement <16 x i32> %a, i32 5
+  %e6 = extractelement <16 x i32> %a, i32 6
+  %e7 = extractelement <16 x i32> %a, i32 7
+  %e8 = extractelement <16 x i32> %a, i32 8
+  %e9 = extractelement <16 x i32> %a, i32 9
+  %e10 = extractelement <16 x i32> %a, i32 10
+  %e11 = extractelement <16 x i32> %a, i32 11
+  %e12 = extractelement <16 x i32> %a, i32 12
+  %e13 = extractelement <16 x i32> %a, i32 13
+  %e14 = extractelement <16 x i32> %a, i32 14
+  %e15 = extractelement <16 x i32> %a, i32 15
+  %s1 = or i32 %e0, %e1
+  %s2 = or i32 %s1, %e2
+  %s3 = or i32 %s2, %e3
+  %s4 = or i32 %s3, %e4
+  %s5 = or i32 %s4, %e5
+  %s6 = or i32 %s5, %e6
+  %s7 = or i32 %s6, %e7
+  %s8 = or i32 %s7, %e8
+  %s9 = or i32 %s8, %e9
+  %s10 = or i32 %s9, %e10
+  %s11 = or i32 %s10, %e11
+  %s12 = or i32 %s11, %e12
+  %s13 = or i32 %s12, %e13
+  %s14 = or i32 %s13, %e14
+  %s15 = or i32 %s14, %e15
+
+  ; CHECK-NOT: getlane
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: or {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: or {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: or {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: or {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: getlane s0, {{v[0-9]+}}, 0
+  ; CHECK-NOT: getlane
+
+  ret i32 %s15
+}
+
+; Min keeps the lanes where the original value is smaller
+define i32 @reduce_smin(<16 x i32> %a) { ; CHECK-LABEL: reduce_smin:
+  %e0 = extractelement <16 x i32> %a, i32 0
+  %e1 = extractelement <16 x i32> %a, i32 1
+  %e2 = extractelement <16 x i32> %a, i32 2
+  %e3 = extractelement <16 x i32> %a, i32 3
+  %e4 = extractelement <16 x i32> %a, i32 4
+  %e5 = extractelement <16 x i32> %a, i32 5
+  %e6 = extractelement <16 x i32> %a, i32 6
+  %e7 = extractelement <16 x i32> %a, i32 7
+  %e8 = extractelement <16 x i32> %a, i32 8
+  %e9 = extractelement <16 x i32> %a, i32 9
+  %e10 = extractelement <16 x i32> %a, i32 10
+  %e11 = extractelement <16 x i32> %a, i32 11
+  %e12 = extractelement <16 x i32> %a, i32 12
+  %e13 = extractelement <16 x i32> %a, i32 13
+  %e14 = extractelement <16 x i32> %a, i32 14
+  %e15 = extractelement <16 x i32> %a, i32 15
+  %c1 = icmp slt i32 %e0, %e1
+  %m1 = select i1 %c1, i32 %e0, i32 %e1
+  %c2 = icmp slt i32 %m1, %e2
+  %m2 = select i1 %c2, i32 %m1, i32 %e2
+  %c3 = icmp slt i32 %m2, %e3
+  %m3 = select i1 %c3, i32 %m2, i32 %e3
+  %c4 = icmp slt i32 %m3, %e4
+  %m4 = select i1 %c4, i32 %m3, i32 %e4
+  %c5 = icmp slt i32 %m4, %e5
+  %m5 = select i1 %c5, i32 %m4, i32 %e5
+  %c6 = icmp slt i32 %m5, %e6
+  %m6 = select i1 %c6, i32 %m5, i32 %e6
+  %c7 = icmp slt i32 %m6, %e7
+  %m7 = select i1 %c7, i32 %m6, i32 %e7
+  %c8 = icmp slt i32 %m7, %e8
+  %m8 = select i1 %c8, i32 %m7, i32 %e8
+  %c9 = icmp slt i32 %m8, %e9
+  %m9 = select i1 %c9, i32 %m8, i32 %e9
+  %c10 = icmp slt i32 %m9, %e10
+  %m10 = select i1 %c10, i32 %m9, i32 %e10
+  %c11 = icmp slt i32 %m10, %e11
+  %m11 = select i1 %c11, i32 %m10, i32 %e11
+  %c12 = icmp slt i32 %m11, %e12
+  %m12 = select i1 %c12, i32 %m11, i32 %e12
+  %c13 = icmp slt i32 %m12, %e13
+  %m13 = select i1 %c13, i32 %m12, i32 %e13
+  %c14 = icmp slt i32 %m13, %e14
+  %m14 = select i1 %c14, i32 %m13, i32 %e14
+  %c15 = icmp slt i32 %m14, %e15
+  %m15 = select i1 %c15, i32 %m14, i32 %e15
+
+  ; CHECK-NOT: getlane
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: cmplt_i [[MASKX:s[0-9]+]], [[VALX:v[0-9]+]], [[SHUFX:v[0-9]+]]
+  ; CHECK: move_mask [[SHUFX]], [[MASKX]], [[VALX]]
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: cmplt_i [[MASKX:s[0-9]+]], [[VALX:v[0-9]+]], [[SHUFX:v[0-9]+]]
+  ; CHECK: move_mask [[SHUFX]], [[MASKX]], [[VALX]]
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: cmplt_i [[MASKX:s[0-9]+]], [[VALX:v[0-9]+]], [[SHUFX:v[0-9]+]]
+  ; CHECK: move_mask [[SHUFX]], [[MASKX]], [[VALX]]
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: cmplt_i [[MASKX:s[0-9]+]], [[VALX:v[0-9]+]], [[SHUFX:v[0-9]+]]
+  ; CHECK: move_mask [[SHUFX]], [[MASKX]], [[VALX]]
+  ; CHECK: getlane s0, {{v[0-9]+}}, 0
+  ; CHECK-NOT: getlane
+
+  ret i32 %m15
+}
+
+define i32 @reduce_umin(<16 x i32> %a) { ; CHECK-LABEL: reduce_umin:
+  %e0 = extractelement <16 x i32> %a, i32 0
+  %e1 = extractelement <16 x i32> %a, i32 1
+  %e2 = extractelement <16 x i32> %a, i32 2
+  %e3 = extractelement <16 x i32> %a, i32 3
+  %e4 = extractelement <16 x i32> %a, i32 4
+  %e5 = extractelement <16 x i32> %a, i32 5
+  %e6 = extractelement <16 x i32> %a, i32 6
+  %e7 = extractelement <16 x i32> %a, i32 7
+  %e8 = extractelement <16 x i32> %a, i32 8
+  %e9 = extractelement <16 x i32> %a, i32 9
+  %e10 = extractelement <16 x i32> %a, i32 10
+  %e11 = extractelement <16 x i32> %a, i32 11
+  %e12 = extractelement <16 x i32> %a, i32 12
+  %e13 = extractelement <16 x i32> %a, i32 13
+  %e14 = extractelement <16 x i32> %a, i32 14
+  %e15 = extractelement <16 x i32> %a, i32 15
+  %c1 = icmp ult i32 %e0, %e1
+  %m1 = select i1 %c1, i32 %e0, i32 %e1
+  %c2 = icmp ult i32 %m1, %e2
+  %m2 = select i1 %c2, i32 %m1, i32 %e2
+  %c3 = icmp ult i32 %m2, %e3
+  %m3 = select i1 %c3, i32 %m2, i32 %e3
+  %c4 = icmp ult i32 %m3, %e4
+  %m4 = select i1 %c4, i32 %m3, i32 %e4
+  %c5 = icmp ult i32 %m4, %e5
+  %m5 = select i1 %c5, i32 %m4, i32 %e5
+  %c6 = icmp ult i32 %m5, %e6
+  %m6 = select i1 %c6, i32 %m5, i32 %e6
+  %c7 = icmp ult i32 %m6, %e7
+  %m7 = select i1 %c7, i32 %m6, i32 %e7
+  %c8 = icmp ult i32 %m7, %e8
+  %m8 = select i1 %c8, i32 %m7, i32 %e8
+  %c9 = icmp ult i32 %m8, %e9
+  %m9 = select i1 %c9, i32 %m8, i32 %e9
+  %c10 = icmp ult i32 %m9, %e10
+  %m10 = select i1 %c10, i32 %m9, i32 %e10
+  %c11 = icmp ult i32 %m10, %e11
+  %m11 = select i1 %c11, i32 %m10, i32 %e11
+  %c12 = icmp ult i32 %m11, %e12
+  %m12 = select i1 %c12, i32 %m11, i32 %e12
+  %c13 = icmp ult i32 %m12, %e13
+  %m13 = select i1 %c13, i32 %m12, i32 %e13
+  %c14 = icmp ult i32 %m13, %e14
+  %m14 = select i1 %c14, i32 %m13, i32 %e14
+  %c15 = icmp ult i32 %m14, %e15
+  %m15 = select i1 %c15, i32 %m14, i32 %e15
+
+  ; CHECK-NOT: getlane
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: cmplt_u [[MASKX:s[0-9]+]], [[VALX:v[0-9]+]], [[SHUFX:v[0-9]+]]
+  ; CHECK: move_mask [[SHUFX]], [[MASKX]], [[VALX]]
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: cmplt_u [[MASKX:s[0-9]+]], [[VALX:v[0-9]+]], [[SHUFX:v[0-9]+]]
+  ; CHECK: move_mask [[SHUFX]], [[MASKX]], [[VALX]]
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: cmplt_u [[MASKX:s[0-9]+]], [[VALX:v[0-9]+]], [[SHUFX:v[0-9]+]]
+  ; CHECK: move_mask [[SHUFX]], [[MASKX]], [[VALX]]
+  ; CHECK: shuffle {{v[0-9]+}}, {{v[0-9]+}}, {{v[0-9]+}}
+  ; CHECK: cmplt_u [[MASKX:s[0-9]+]], [[VALX:v[0-9]+]], [[SHUFX:v[0-9]+]]
+  ; CHECK: move_mask [[SHUFX]], [[MASKX]], [[VALX]]
+  ; CHECK: getlane s0, {{v[0-9]+}}, 0
+  ; CHECK-NOT: getlane
+
+  ret i32 %m15
+}
+
+; Not all lanes are used, so this isn't a reduction
+define i32 @partial_sum(<16 x i32> %a) { ; CHECK-LABEL: partial_sum:
+  %e0 = extractelement <16 x i32> %a, i32 0
+  %e1 = extractelement <16 x i32> %a, i32 1
+  %e2 = extractelement <16 x i32> %a, i32 2
+  %e3 = extractelement <16 x i32> %a, i32 3
+  %e4 = extractelement <16 x i32> %a, i32 4
+  %e5 = extractelement <16 x i32> %a, i32 5
+  %e6 = extractelement <16 x i32> %a, i32 6
+  %e7 = extractelement <16 x i32> %a, i32 7
+  %e8 = extractelement <16 x i32> %a, i32 8
+  %e9 = extractelement <16 x i32> %a, i32 9
+  %e10 = extractelement <16 x i32> %a, i32 10
+  %e11 = extractelement <16 x i32> %a, i32 11
+  %e12 = extractelement <16 x i32> %a, i32 12
+  %e13 = extractelement <16 x i32> %a, i32 13
+  %e14 = extractelement <16 x i32> %a, i32 14
+  %s1 = add i32 %e0, %e1
+  %s2 = add i32 %s1, %e2
+  %s3 = add i32 %s2, %e3
+  %s4 = add i32 %s3, %e4
+  %s5 = add i32 %s4, %e5
+  %s6 = add i32 %s5, %e6
+  %s7 = add i32 %s6, %e7
+  %s8 = add i32 %s7, %e8
+  %s9 = add i32 %s8, %e9
+  %s10 = add i32 %s9, %e10
+  %s11 = add i32 %s10, %e11
+  %s12 = add i32 %s11, %e12
+  %s13 = add i32 %s12, %e13
+  %s14 = add i32 %s13, %e14
+
+  ; CHECK-NOT: shuffle
+  ; CHECK: getlane
+  ; CHECK: ret
+
+  ret i32 %s14
+}
@@ -323,7 +323,47 @@ define i32 @check_nan(float %a) { ; CHECK-LABEL: check_nan:
   %lnot = fcmp uno float %a, 0.000000e+00
   %lnot.ext = zext i1 %lnot to i32
 
-  ; CHECK: cmpeq_f
+  ; CHECK: cmpeq_f [[CMPRES:s[0-9]+]], s0, s0
+  ; CHECK: xor s{{[0-9]+}}, [[CMPRES]]
 
   ret i32 %lnot.ext
 }
+
+; Both operands are checked when neither is a constant.
+define i32 @check_ordered(float %a, float %b) { ; CHECK-LABEL: check_ordered:
+  %cmp = fcmp ord float %a, %b
+  %ret = zext i1 %cmp to i32
+
+  ; CHECK-DAG: cmpeq_f [[ORDA:s[0-9]+]], s0, s0
+  ; CHECK-DAG: cmpeq_f [[ORDB:s[0-9]+]], s1, s1
+  ; CHECK: and s{{[0-9]+}}, [[ORDA]], [[ORDB]]
+
+  ret i32 %ret
+}
+
+define i32 @check_unordered(float %a, float %b) { ; CHECK-LABEL: check_unordered:
+  %cmp = fcmp uno float %a, %b
+  %ret = zext i1 %cmp to i32
+
+  ; CHECK-DAG: cmpeq_f [[ORDA:s[0-9]+]], s0, s0
+  ; CHECK-DAG: cmpeq_f [[ORDB:s[0-9]+]], s1, s1
+  ; CHECK-DAG: xor [[NANA:s[0-9]+]], [[ORDA]]
+  ; CHECK-DAG: xor [[NANB:s[0-9]+]], [[ORDB]]
+  ; CHECK: or s{{[0-9]+}}, {{s[0-9]+}}, {{s[0-9]+}}
+
+  ret i32 %ret
+}
+
+; Inverting an unordered comparison folds to the ordered comparison, without
+; an xor.
+define i32 @invert_unordered(float %a, float %b) { ; CHECK-LABEL: invert_unordered:
+  %cmp = fcmp une float %a, %b
+  %not = xor i1 %cmp, true
+  %ret = zext i1 %not to i32
+
+  ; CHECK: cmpeq_f s{{[0-9]+}}, s0, s1
+  ; CHECK-NOT: xor
+  ; CHECK: ret
+
+  ret i32 %ret
+}
@@ -0,0 +1,55 @@
+; RUN: llc %s -o - | FileCheck %s
+;
+; Vector atomic add. Lanes with the same address are summed in registers,
+; then each unique address is updated with a single load_sync/store_sync
+; loop.
+;
+
+target triple = "nyuzi-elf-none"
+
+declare void @llvm.nyuzi.__builtin_nyuzi_scatter_atomic_addi(<16 x i32>, <16 x i32>)
+declare void @llvm.nyuzi.__builtin_nyuzi_scatter_atomic_addf(<16 x i32>, <16 x float>)
+
+define void @atomic_addi(<16 x i32> %ptrs, <16 x i32> %values) { ; CHECK-LABEL: atomic_addi:
+  call void @llvm.nyuzi.__builtin_nyuzi_scatter_atomic_addi(<16 x i32> %ptrs, <16 x i32> %values)
+
+  ; CHECK: load_v [[LANEIDS:v[0-9]+]], .LCPI
+  ; CHECK: [[HEADER:\.LBB[0-9]+_[0-9]+]]:
+  ; CHECK: ctz [[BIT:s[0-9]+]], [[REMAINING:s[0-9]+]]
+  ; CHECK: xor [[LANE:s[0-9]+]], [[BIT]], 15
+  ; CHECK: getlane [[ADDR:s[0-9]+]], v0, [[LANE]]
+  ; CHECK: cmpeq_i [[SAME:s[0-9]+]], v0, [[ADDR]]
+  ; CHECK: and [[GROUP:s[0-9]+]], [[SAME]],
+  ; CHECK: move_mask [[SUM:v[0-9]+]], [[GROUP]], v1
+  ; CHECK: shuffle
+  ; CHECK: add_i
+  ; CHECK: shuffle
+  ; CHECK: add_i
+  ; CHECK: shuffle
+  ; CHECK: add_i
+  ; CHECK: shuffle
+  ; CHECK: add_i [[TOTALV:v[0-9]+]],
+  ; CHECK: getlane [[TOTAL:s[0-9]+]], [[TOTALV]], 0
+  ; CHECK: [[LOOP:\.LBB[0-9]+_[0-9]+]]:
+  ; CHECK: load_sync [[OLD:s[0-9]+]], ([[ADDR]])
+  ; CHECK: add_i [[NEW:s[0-9]+]], [[OLD]], [[TOTAL]]
+  ; CHECK: store_sync [[NEW]], ([[ADDR]])
+  ; CHECK: bz [[NEW]], [[LOOP]]
+  ; CHECK: bnz {{s[0-9]+}}, [[HEADER]]
+  ; CHECK-NOT: load_sync
+  ; CHECK: ret
+
+  ret void
+}
+
+define void @atomic_addf(<16 x i32> %ptrs, <16 x float> %values) { ; CHECK-LABEL: atomic_addf:
+  call void @llvm.nyuzi.__builtin_nyuzi_scatter_atomic_addf(<16 x i32> %ptrs, <16 x float> %values)
+
+  ; CHECK: add_f v{{[0-9]+}}, v{{[0-9]+}}, v{{[0-9]+}}
+  ; CHECK: getlane [[TOTAL:s[0-9]+]], v{{[0-9]+}}, 0
+  ; CHECK: load_sync [[OLD:s[0-9]+]], ([[ADDR:s[0-9]+]])
+  ; CHECK: add_f [[NEW:s[0-9]+]], [[OLD]], [[TOTAL]]
+  ; CHECK: store_sync [[NEW]], ([[ADDR]])
+
+  ret void
+}
@@ -1,21 +1,24 @@
 ; RUN: llc %s -o - | FileCheck %s
 ;
-; Test 'select' LLVM instruction
+; Test 'select' LLVM instruction. Selects are lowered to mask arithmetic or
+; predicated moves rather than branches, except when optimizing for size.
 ;
 
 target triple = "nyuzi-elf-none"
 
-define i32 @seli(i32 %a) {  ; CHECK-LABEL: seli:
+define i32 @seli(i32 %a, i32 %b, i32 %c) {  ; CHECK-LABEL: seli:
   %cmp = icmp eq i32 %a, 4
 
   ; CHECK: cmpeq_i [[PRED:s[0-9]+]], s0, 4
-
-  %val = select i1 %cmp, i32 2, i32 3
-
-  ; CHECK: bnz [[PRED]], [[TRUELABEL:[\.A-Z0-9a-z_]+]]
-  ; move s{{[0-9]+}}, [0-9]+
-  ; [[TRUELABEL]]:
-
+  ; CHECK-NOT: bnz
+  ; CHECK-NOT: bz
+  ; CHECK-DAG: shl [[SHIFTED:s[0-9]+]], [[PRED]], 31
+  ; CHECK-DAG: ashr [[MASK:s[0-9]+]], [[SHIFTED]], 31
+  ; CHECK-DAG: xor [[DIFF:s[0-9]+]], s1, s2
+  ; CHECK: and [[MASKED:s[0-9]+]], [[DIFF]], [[MASK]]
+  ; CHECK: xor s0, s2, [[MASKED]]
+
+  %val = select i1 %cmp, i32 %b, i32 %c
   ret i32 %val
 }
 
@@ -23,12 +26,11 @@ define float @self(float %a, float %b, float %c) {  ; CHECK-LABEL: self:
   %cmp = fcmp oeq float %a, %b
 
   ; CHECK: cmpeq_f [[PRED:s[0-9]+]], s0, s1
+  ; CHECK-NOT: bnz
+  ; CHECK-NOT: bz
+  ; CHECK: xor
 
   %val = select i1 %cmp, float %b, float %c
-
-  ; CHECK: bnz [[PRED]], [[TRUELABEL:[\.A-Z0-9a-z_]+]]
-  ; [[TRUELABEL]]:
-
   ret float %val
 }
 
@@ -36,24 +38,32 @@ define <16 x i32> @selvi(i32 %a, <16 x i32> %b, <16 x i32> %c) { ; CHECK-LABEL:
   %cmp = icmp eq i32 %a, 4
 
   ; CHECK: cmpeq_i [[PRED:s[0-9]+]], s0, 4
+  ; CHECK-NOT: bnz
+  ; CHECK-NOT: bz
+  ; CHECK: move_mask v1, s{{[0-9]+}}, v0
 
   %val = select i1 %cmp, <16 x i32> %b, <16 x i32> %c
-
-  ; CHECK: bnz [[PRED]], [[TRUELABEL:[\.A-Z0-9a-z_]+]]
-  ; move v{{[0-9]+}}, v0
-  ; [[TRUELABEL]]:
-
   ret <16 x i32> %val
 }
 
 define <16 x float> @selvf(i32 %a, <16 x float> %b, <16 x float> %c) { ; CHECK-LABEL: selvf:
   %cmp = icmp eq i32 %a, 4
   ; CHECK: cmpeq_i [[PRED:s[0-9]+]], s0, 4
+  ; CHECK-NOT: bnz
+  ; CHECK-NOT: bz
+  ; CHECK: move_mask v1, s{{[0-9]+}}, v0
 
   %val = select i1 %cmp, <16 x float> %b, <16 x float> %c
+  ret <16 x float> %val
+}
+
+define i32 @seli_optsize(i32 %a, i32 %b, i32 %c) optsize {  ; CHECK-LABEL: seli_optsize:
+  %cmp = icmp eq i32 %a, 4
+
+  ; CHECK: cmpeq_i [[PRED:s[0-9]+]], s0, 4
   ; CHECK: bnz [[PRED]], [[TRUELABEL:[\.A-Z0-9a-z_]+]]
-  ; move v{{[0-9]+}}, v0
-  ; [[TRUELABEL]]:
+  ; CHECK: [[TRUELABEL]]:
 
-  ret <16 x float> %val
+  %val = select i1 %cmp, i32 %b, i32 %c
+  ret i32 %val
 }
@@ -0,0 +1,82 @@
+; RUN: llc %s -o - | FileCheck %s
+;
+; Square root. There is no hardware instruction, so this is a library call,
+; unless unsafe math is enabled, in which case it computes an estimate of
+; 1/sqrt(x) with integer operations and refines it with Newton-Raphson
+; iterations (see NyuziTargetLowering::getSqrtEstimate).
+;
+
+target triple = "nyuzi-elf-none"
+
+declare float @llvm.sqrt.f32(float)
+declare <16 x float> @llvm.sqrt.v16f32(<16 x float>)
+
+define float @sqrt_precise(float %a) { 	; CHECK-LABEL: sqrt_precise:
+  %1 = call float @llvm.sqrt.f32(float %a)
+
+  ; CHECK: call sqrtf
+
+  ret float %1
+}
+
+define float @rsqrt(float %a) #0 { 	; CHECK-LABEL: rsqrt:
+  %1 = call float @llvm.sqrt.f32(float %a)
+  %2 = fdiv float 1.0, %1
+
+  ; CHECK-NOT: call
+  ; CHECK-NOT: reciprocal
+  ; CHECK: shr [[HALFBITS:s[0-9]+]], s0, 1
+  ; CHECK: sub_i {{s[0-9]+}}, {{s[0-9]+}}, [[HALFBITS]]
+  ; CHECK: mul_f
+  ; CHECK-NOT: call
+  ; CHECK-NOT: reciprocal
+  ; CHECK: ret
+
+  ret float %2
+}
+
+; The refinement steps can be reduced with -mrecip. Normalizing a vector
+; is a common use of this.
+define <16 x float> @normalize(<16 x float> %x, <16 x float> %y) #1 { 	; CHECK-LABEL: normalize:
+  %1 = fmul <16 x float> %x, %x
+  %2 = fmul <16 x float> %y, %y
+  %3 = fadd <16 x float> %1, %2
+  %4 = call <16 x float> @llvm.sqrt.v16f32(<16 x float> %3)
+  %5 = fdiv <16 x float> %x, %4
+
+  ; CHECK-NOT: call
+  ; CHECK-NOT: reciprocal
+  ; CHECK: shr [[HALFBITS:v[0-9]+]], {{v[0-9]+}}, 1
+  ; CHECK: sub_i {{v[0-9]+}}, {{[sv][0-9]+}}, [[HALFBITS]]
+  ; CHECK-NOT: call
+  ; CHECK-NOT: reciprocal
+  ; CHECK: ret
+
+  ret <16 x float> %5
+}
+
+; -mrecip can disable the estimate even with unsafe math.
+define float @sqrt_estimate_disabled(float %a) #2 { 	; CHECK-LABEL: sqrt_estimate_disabled:
+  %1 = call float @llvm.sqrt.f32(float %a)
+
+  ; CHECK: call sqrtf
+
+  ret float %1
+}
+
+; A vector square root (not reciprocal) handles zero with a masked move
+define <16 x float> @sqrt_vector(<16 x float> %a) #0 { 	; CHECK-LABEL: sqrt_vector:
+  %1 = call <16 x float> @llvm.sqrt.v16f32(<16 x float> %a)
+
+  ; CHECK-NOT: call
+  ; CHECK: cmpeq_f [[ZEROMASK:s[0-9]+]], v0,
+  ; CHECK: move_mask {{v[0-9]+}}, [[ZEROMASK]],
+  ; CHECK-NOT: call
+  ; CHECK: ret
+
+  ret <16 x float> %1
+}
+
+attributes #0 = { "unsafe-fp-math"="true" }
+attributes #1 = { "unsafe-fp-math"="true" "reciprocal-estimates"="vec-sqrtf:1" }
+attributes #2 = { "unsafe-fp-math"="true" "reciprocal-estimates"="!sqrtf" }
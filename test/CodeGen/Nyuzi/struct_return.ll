@@ -16,13 +16,13 @@ define void @return_struct(%struct.foo* sret %retval, i32 %param1) { ; CHECK-LAB
   %elem0ptr = getelementptr %struct.foo, %struct.foo* %retval, i32 0, i32 0
   store i32 %param1, i32* %elem0ptr, align 4
 
-  ; CHECK: store_32 s1, (s0)
+  ; CHECK-DAG: store_32 s1, (s0)
 
   %elem1ptr = getelementptr %struct.foo, %struct.foo* %retval, i32 0, i32 1
   store i32 12, i32* %elem1ptr, align 4
 
-  ; CHECK: move [[TMP:s[0-9]+]], 12
-  ; CHECK: store_32 [[TMP]], 4(s0)
+  ; CHECK-DAG: move [[TMP:s[0-9]+]], 12
+  ; CHECK-DAG: store_32 [[TMP]], 4(s0)
 
   ret void
 }
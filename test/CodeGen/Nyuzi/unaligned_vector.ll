@@ -0,0 +1,53 @@
+; RUN: llc %s -o - | FileCheck %s
+;
+; Block loads and stores require 64 byte alignment. Vector accesses that
+; are less aligned (which the vectorizers generate for array accesses) are
+; converted to gathers and scatters of consecutive addresses.
+;
+
+target triple = "nyuzi-elf-none"
+
+define <16 x i32> @aligned_load(<16 x i32>* %ptr) { ; CHECK-LABEL: aligned_load:
+  %1 = load <16 x i32>, <16 x i32>* %ptr, align 64
+
+  ; CHECK: load_v v0, (s0)
+
+  ret <16 x i32> %1
+}
+
+define <16 x i32> @unaligned_loadi(<16 x i32>* %ptr) { ; CHECK-LABEL: unaligned_loadi:
+  %1 = load <16 x i32>, <16 x i32>* %ptr, align 4
+
+  ; CHECK-NOT: load_v {{.*}}(s0)
+  ; CHECK: add_i [[ADDRS:v[0-9]+]], v{{[0-9]+}}, s0
+  ; CHECK: load_gath v0, ([[ADDRS]])
+
+  ret <16 x i32> %1
+}
+
+define <16 x float> @unaligned_loadf(<16 x float>* %ptr) { ; CHECK-LABEL: unaligned_loadf:
+  %1 = load <16 x float>, <16 x float>* %ptr, align 4
+
+  ; CHECK-NOT: load_v {{.*}}(s0)
+  ; CHECK: load_gath v0, (v{{[0-9]+}})
+
+  ret <16 x float> %1
+}
+
+define void @unaligned_storei(<16 x i32>* %ptr, <16 x i32> %value) { ; CHECK-LABEL: unaligned_storei:
+  store <16 x i32> %value, <16 x i32>* %ptr, align 4
+
+  ; CHECK-NOT: store_v
+  ; CHECK: store_scat v0, (v{{[0-9]+}})
+
+  ret void
+}
+
+define void @unaligned_storef(<16 x float>* %ptr, <16 x float> %value) { ; CHECK-LABEL: unaligned_storef:
+  store <16 x float> %value, <16 x float>* %ptr, align 16
+
+  ; CHECK-NOT: store_v
+  ; CHECK: store_scat v0, (v{{[0-9]+}})
+
+  ret void
+}
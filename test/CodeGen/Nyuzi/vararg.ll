@@ -38,11 +38,11 @@ define void @test_caller_vararg(i32 %val1, float %val2, i8* %val3, <16 x i32> %v
   ret void
 
   ; Ensure this stores all arguments in the proper location on the stack
-  ; CHECK: store_v v0, 64(sp)
-  ; CHECK: store_32 s2, 12(sp)
-  ; CHECK: store_32 s1, 8(sp)
-  ; CHECK: store_32 s0, 4(sp)
-  ; CHECK: move s0, 1
-  ; CHECK: store_32 s0, (sp)
+  ; CHECK-DAG: store_v v0, 64(sp)
+  ; CHECK-DAG: store_32 s2, 12(sp)
+  ; CHECK-DAG: store_32 s1, 8(sp)
+  ; CHECK-DAG: store_32 s0, 4(sp)
+  ; CHECK-DAG: move [[ONE:s[0-9]+]], 1
+  ; CHECK-DAG: store_32 [[ONE]], (sp)
   ; CHECK: call test_callee_vararg
 }
@@ -19,43 +19,28 @@ define <16 x i32> @somefunc(i32 %arg0, <16 x i32> %arg1, <16 x i32> %arg2, <16 x
   ; CHECK: add_i sp, sp, -64
 
   %1 = add <16 x i32> %arg1, %arg2
-
-  ; CHECK: add_i [[RES1:v[0-9]+]], v0, v1
-
   %2 = add <16 x i32> %1, %arg3
-
-  ; CHECK: add_i [[RES2:v[0-9]+]], [[RES1]], v2
-
   %3 = add <16 x i32> %2, %arg4
-
-  ; CHECK: add_i [[RES3:v[0-9]+]], [[RES2]], v3
-
   %4 = add <16 x i32> %3, %arg5
-
-  ; CHECK: add_i [[RES4:v[0-9]+]], [[RES3]], v4
-
   %5 = add <16 x i32> %4, %arg6
-
-  ; CHECK: add_i [[RES5:v[0-9]+]], [[RES4]], v5
-
   %6 = add <16 x i32> %5, %arg7
-
-  ; CHECK: add_i [[RES6:v[0-9]+]], [[RES5]], v6
-
   %7 = add <16 x i32> %6, %arg8
-
-  ; CHECK: add_i [[RES7:v[0-9]+]], [[RES6]], v7
-
   %8 = add <16 x i32> %7, %arg9
-
-  ; Check that these are loaded from the stack
-  ; CHECK: load_v [[TMPREG1:v[0-9]+]], 64(sp)
-  ; CHECK: add_i [[RES7:v[0-9]+]], [[RES6]], [[TMPREG1]]
-
   %9 = add <16 x i32> %8, %arg10
 
-  ; CHECK: load_v [[TMPREG2:v[0-9]+]], 128(sp)
-  ; CHECK: add_i v{{[0-9]+}}, [[RES7]], [[TMPREG2]]
+  ; The scheduler may hoist the loads of the stack arguments above the
+  ; register adds to hide their latency.
+  ; CHECK-DAG: load_v [[TMPREG1:v[0-9]+]], 64(sp)
+  ; CHECK-DAG: load_v [[TMPREG2:v[0-9]+]], 128(sp)
+  ; CHECK-DAG: add_i [[RES1:v[0-9]+]], v0, v1
+  ; CHECK-DAG: add_i [[RES2:v[0-9]+]], [[RES1]], v2
+  ; CHECK-DAG: add_i [[RES3:v[0-9]+]], [[RES2]], v3
+  ; CHECK-DAG: add_i [[RES4:v[0-9]+]], [[RES3]], v4
+  ; CHECK-DAG: add_i [[RES5:v[0-9]+]], [[RES4]], v5
+  ; CHECK-DAG: add_i [[RES6:v[0-9]+]], [[RES5]], v6
+  ; CHECK-DAG: add_i [[RES7:v[0-9]+]], [[RES6]], v7
+  ; CHECK-DAG: add_i [[RES8:v[0-9]+]], [[RES7]], [[TMPREG1]]
+  ; CHECK-DAG: add_i v{{[0-9]+}}, [[RES8]], [[TMPREG2]]
 
   ret <16 x i32> %9
 }
@@ -77,19 +62,19 @@ define <16 x i32> @main() {  ; CHECK-LABEL: main:
   ; The first eight arguments will be passed in registers. The remainders will
   ; be copied onto the stack.
 
-  ; CHECK: move [[TMPVEC1:v[0-9]+]], 10
-  ; CHECK: store_v [[TMPVEC1]], 64(sp)
-  ; CHECK: move [[TMPVEC2:v[0-9]+]], 9
-  ; CHECK: store_v [[TMPVEC2]], (sp)
-  ; CHECK: move s0, 123
-  ; CHECK: move v0, 1
-  ; CHECK: move v1, 2
-  ; CHECK: move v2, 3
-  ; CHECK: move v3, 4
-  ; CHECK: move v4, 5
-  ; CHECK: move v5, 6
-  ; CHECK: move v6, 7
-  ; CHECK: move v7, 8
+  ; CHECK-DAG: move [[TMPVEC1:v[0-9]+]], 10
+  ; CHECK-DAG: store_v [[TMPVEC1]], 64(sp)
+  ; CHECK-DAG: move [[TMPVEC2:v[0-9]+]], 9
+  ; CHECK-DAG: store_v [[TMPVEC2]], (sp)
+  ; CHECK-DAG: move s0, 123
+  ; CHECK-DAG: move v0, 1
+  ; CHECK-DAG: move v1, 2
+  ; CHECK-DAG: move v2, 3
+  ; CHECK-DAG: move v3, 4
+  ; CHECK-DAG: move v4, 5
+  ; CHECK-DAG: move v5, 6
+  ; CHECK-DAG: move v6, 7
+  ; CHECK-DAG: move v7, 8
   ; CHECK: call somefunc
 
   ret <16 x i32> %result
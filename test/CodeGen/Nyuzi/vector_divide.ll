@@ -0,0 +1,87 @@
+; RUN: llc %s -o - | FileCheck %s
+;
+; There is no integer divider. Vector division is expanded inline using a
+; floating point reciprocal estimate (see NyuziTargetLowering::LowerVectorDivRem),
+; rather than calling the library function for each lane. Division by a
+; constant multiplies by a magic number.
+;
+
+target triple = "nyuzi-elf-none"
+
+define <16 x i32> @udiv(<16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL: udiv:
+  %1 = udiv <16 x i32> %a, %b
+
+  ; CHECK-NOT: call
+  ; CHECK: reciprocal
+  ; CHECK: ftoi
+  ; CHECK: mulh_u
+  ; CHECK: mulh_u
+  ; CHECK: cmpge_u
+  ; CHECK: cmpge_u
+  ; CHECK-NOT: call
+  ; CHECK: ret
+
+  ret <16 x i32> %1
+}
+
+define <16 x i32> @urem(<16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL: urem:
+  %1 = urem <16 x i32> %a, %b
+
+  ; CHECK-NOT: call
+  ; CHECK: reciprocal
+  ; CHECK: mulh_u
+  ; CHECK: cmpge_u
+  ; CHECK-NOT: call
+  ; CHECK: ret
+
+  ret <16 x i32> %1
+}
+
+define <16 x i32> @sdiv(<16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL: sdiv:
+  %1 = sdiv <16 x i32> %a, %b
+
+  ; CHECK-NOT: call
+  ; CHECK: ashr {{v[0-9]+}}, {{v[0-9]+}}, 31
+  ; CHECK: reciprocal
+  ; CHECK: cmpge_u
+  ; CHECK-NOT: call
+  ; CHECK: ret
+
+  ret <16 x i32> %1
+}
+
+define <16 x i32> @srem(<16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL: srem:
+  %1 = srem <16 x i32> %a, %b
+
+  ; CHECK-NOT: call
+  ; CHECK: reciprocal
+  ; CHECK: cmpge_u
+  ; CHECK-NOT: call
+  ; CHECK: ret
+
+  ret <16 x i32> %1
+}
+
+define <16 x i32> @udiv_const(<16 x i32> %a) { ; CHECK-LABEL: udiv_const:
+  %1 = udiv <16 x i32> %a, <i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7>
+
+  ; CHECK-NOT: reciprocal
+  ; CHECK: mulh_u
+  ; CHECK-NOT: reciprocal
+  ; CHECK-NOT: call
+  ; CHECK: ret
+
+  ret <16 x i32> %1
+}
+
+define <16 x i32> @sdiv_const(<16 x i32> %a) { ; CHECK-LABEL: sdiv_const:
+  %1 = sdiv <16 x i32> %a, <i32 24, i32 24, i32 24, i32 24, i32 24, i32 24, i32 24, i32 24, i32 24, i32 24, i32 24, i32 24, i32 24, i32 24, i32 24, i32 24>
+
+  ; CHECK-NOT: reciprocal
+  ; CHECK: mulh_i
+  ; CHECK-NOT: reciprocal
+  ; CHECK-NOT: call
+  ; CHECK: ret
+
+  ret <16 x i32> %1
+}
@@ -0,0 +1,150 @@
+; RUN: llc %s -o - | FileCheck %s
+; RUN: llc %s -o - -nyuzi-vector-math=libcall | FileCheck %s -check-prefix=LIBCALL
+;
+; There are no hardware instructions for these math functions. Vector versions
+; are expanded inline rather than calling the scalar library function for
+; each lane (see NyuziTargetLowering::LowerVectorMath).
+;
+
+target triple = "nyuzi-elf-none"
+
+declare <16 x float> @llvm.sqrt.v16f32(<16 x float>)
+declare <16 x float> @llvm.sin.v16f32(<16 x float>)
+declare <16 x float> @llvm.cos.v16f32(<16 x float>)
+declare <16 x float> @llvm.exp.v16f32(<16 x float>)
+declare <16 x float> @llvm.log.v16f32(<16 x float>)
+declare <16 x float> @llvm.exp2.v16f32(<16 x float>)
+declare <16 x float> @llvm.log2.v16f32(<16 x float>)
+declare <16 x float> @llvm.floor.v16f32(<16 x float>)
+
+define <16 x float> @vsqrt(<16 x float> %a) { ; CHECK-LABEL: vsqrt:
+  %1 = call <16 x float> @llvm.sqrt.v16f32(<16 x float> %a)
+
+  ; CHECK-NOT: call
+  ; CHECK: shr [[HALFBITS:v[0-9]+]], v0, 1
+  ; CHECK: sub_i {{v[0-9]+}}, {{[sv][0-9]+}}, [[HALFBITS]]
+  ; CHECK: cmpeq_f
+  ; CHECK: move_mask
+  ; CHECK-NOT: call
+  ; CHECK: ret
+
+  ; LIBCALL-LABEL: vsqrt:
+  ; LIBCALL: call sqrtf
+
+  ret <16 x float> %1
+}
+
+define <16 x float> @vsin(<16 x float> %a) { ; CHECK-LABEL: vsin:
+  %1 = call <16 x float> @llvm.sin.v16f32(<16 x float> %a)
+
+  ; CHECK-NOT: call
+  ; CHECK: ftoi
+  ; CHECK: itof
+  ; CHECK: cmpne_i
+  ; CHECK: {{move|add_f}}_mask
+  ; CHECK-NOT: call
+  ; CHECK: ret
+
+  ; LIBCALL-LABEL: vsin:
+  ; LIBCALL: call sinf
+
+  ret <16 x float> %1
+}
+
+define <16 x float> @vcos(<16 x float> %a) { ; CHECK-LABEL: vcos:
+  %1 = call <16 x float> @llvm.cos.v16f32(<16 x float> %a)
+
+  ; CHECK-NOT: call
+  ; CHECK: ftoi
+  ; CHECK: {{move|add_f}}_mask
+  ; CHECK-NOT: call
+  ; CHECK: ret
+
+  ; LIBCALL-LABEL: vcos:
+  ; LIBCALL: call cosf
+
+  ret <16 x float> %1
+}
+
+define <16 x float> @vexp(<16 x float> %a) { ; CHECK-LABEL: vexp:
+  %1 = call <16 x float> @llvm.exp.v16f32(<16 x float> %a)
+
+  ; CHECK-NOT: call
+  ; CHECK: ftoi
+  ; CHECK: shl {{v[0-9]+}}, {{v[0-9]+}}, 23
+  ; CHECK-NOT: call
+  ; CHECK: ret
+
+  ; LIBCALL-LABEL: vexp:
+  ; LIBCALL: call expf
+
+  ret <16 x float> %1
+}
+
+define <16 x float> @vlog(<16 x float> %a) { ; CHECK-LABEL: vlog:
+  %1 = call <16 x float> @llvm.log.v16f32(<16 x float> %a)
+
+  ; CHECK-NOT: call
+  ; CHECK: shr {{v[0-9]+}}, v0, 23
+  ; CHECK: itof
+  ; CHECK-NOT: call
+  ; CHECK: ret
+
+  ; LIBCALL-LABEL: vlog:
+  ; LIBCALL: call logf
+
+  ret <16 x float> %1
+}
+
+; The argument is rounded directly, rather than being multiplied by ln(2) and
+; passed to exp, so integer inputs give exact results.
+define <16 x float> @vexp2(<16 x float> %a) { ; CHECK-LABEL: vexp2:
+  %1 = call <16 x float> @llvm.exp2.v16f32(<16 x float> %a)
+
+  ; CHECK-NOT: call
+  ; CHECK-NOT: mul_f
+  ; CHECK: ftoi
+  ; CHECK: shl {{v[0-9]+}}, {{v[0-9]+}}, 23
+  ; CHECK-NOT: call
+  ; CHECK: ret
+
+  ; LIBCALL-LABEL: vexp2:
+  ; LIBCALL: call exp2f
+
+  ret <16 x float> %1
+}
+
+; The exponent is added last rather than dividing log(x) by ln(2), so powers
+; of two give exact results.
+define <16 x float> @vlog2(<16 x float> %a) { ; CHECK-LABEL: vlog2:
+  %1 = call <16 x float> @llvm.log2.v16f32(<16 x float> %a)
+
+  ; CHECK-NOT: call
+  ; CHECK: shr {{v[0-9]+}}, v0, 23
+  ; CHECK: itof [[EXPONENT:v[0-9]+]]
+  ; CHECK: add_f {{v[0-9]+}}, {{v[0-9]+}}, [[EXPONENT]]
+  ; CHECK-NOT: mul_f
+  ; CHECK-NOT: call
+  ; CHECK: ret
+
+  ; LIBCALL-LABEL: vlog2:
+  ; LIBCALL: call log2f
+
+  ret <16 x float> %1
+}
+
+define <16 x float> @vfloor(<16 x float> %a) { ; CHECK-LABEL: vfloor:
+  %1 = call <16 x float> @llvm.floor.v16f32(<16 x float> %a)
+
+  ; CHECK-NOT: call
+  ; CHECK: ftoi [[INT:v[0-9]+]], v0
+  ; CHECK: itof [[TRUNC:v[0-9]+]], [[INT]]
+  ; CHECK: cmpgt_f {{s[0-9]+}}, [[TRUNC]], v0
+  ; CHECK-NOT: call
+  ; CHECK: ret
+
+  ; LIBCALL-LABEL: vfloor:
+  ; LIBCALL: call floorf
+
+  ret <16 x float> %1
+}
@@ -85,41 +85,43 @@ define <16 x i32> @test2(<16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL: test2:
 }
 
 ; Select items from both vectors, but same lanes. Will be masked move
-; CHECK: [[MM_CPE:.LCPI[0-9]+_[0-9]+]]
-; CHECK: .long 21845
 define <16 x i32> @masked_move(<16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL: masked_move:
   %res = shufflevector <16 x i32> %a, <16 x i32> %b, <16 x i32> < i32 0, i32 17, i32 2, i32 19, i32 4, i32 21, i32 6, i32 23, i32 8, i32 25, i32 10, i32 27, i32 12, i32 29, i32 14, i32 31>
 
-  ; CHECK: load_32 [[MM_SREG:s[0-9]+]], [[MM_CPE]]
+  ; CHECK: move [[MM_SREG:s[0-9]+]], 5
+  ; CHECK-NEXT: shl [[MM_SREG]], [[MM_SREG]], 12
+  ; CHECK-NEXT: or [[MM_SREG]], [[MM_SREG]], 1365
   ; CHECK-NEXT: move_mask {{v[0-9]+}}, [[MM_SREG]], v1
   ; CHECK-NOT: shuffle
 
   ret <16 x i32> %res
 }
 
-; Shuffle only vector 1
-; CHECK: [[SO1_SHUFFLEVECCP:.LCPI[0-9]+_[0-9]+]]
-; CHECK: .long 15
-; CHECK: .long 14
-; CHECK: .long 13
-; CHECK: .long 12
-; CHECK: .long 11
-; CHECK: .long 10
-; CHECK: .long 9
-; CHECK: .long 8
-; CHECK: .long 7
-; CHECK: .long 6
-; CHECK: .long 5
-; CHECK: .long 4
-; CHECK: .long 3
-; CHECK: .long 2
-; CHECK: .long 1
+; Shuffle only vector 1. Reversing is lane ^ 15, which is computed from
+; the lane index vector rather than loading a separate index vector.
+; CHECK: [[SO1_LANEIDCP:.LCPI[0-9]+_[0-9]+]]
 ; CHECK: .long 0
+; CHECK: .long 1
+; CHECK: .long 2
+; CHECK: .long 3
+; CHECK: .long 4
+; CHECK: .long 5
+; CHECK: .long 6
+; CHECK: .long 7
+; CHECK: .long 8
+; CHECK: .long 9
+; CHECK: .long 10
+; CHECK: .long 11
+; CHECK: .long 12
+; CHECK: .long 13
+; CHECK: .long 14
+; CHECK: .long 15
 
 define <16 x i32> @shuffle_only1(<16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL: shuffle_only1:
   %res = shufflevector <16 x i32> %a, <16 x i32> %b, <16 x i32> < i32 15, i32 14, i32 13, i32 12, i32 11, i32 10, i32 9, i32 8, i32 7, i32 6, i32 5, i32 4, i32 3, i32 2, i32 1, i32 0 >
 
-  ; CHECK: load_v [[SO1_SHUFFLEVEC:v[0-9]+]], [[SO1_SHUFFLEVECCP]]
+  ; CHECK: load_v [[SO1_LANEID:v[0-9]+]], [[SO1_LANEIDCP]]
+  ; CHECK-NEXT: xor [[SO1_SHUFFLEVEC:v[0-9]+]], [[SO1_LANEID]], 15
   ; CHECK-NEXT: shuffle v0, v0, [[SO1_SHUFFLEVEC]]
   ; CHECK-NEXT: ret
 
@@ -127,27 +129,28 @@ define <16 x i32> @shuffle_only1(<16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL:
 }
 
 ; Shuffle only vector 2
-; CHECK: [[SO2_SHUFFLEVECCP:.LCPI[0-9]+_[0-9]+]]
-; CHECK: .long 15
-; CHECK: .long 14
-; CHECK: .long 13
-; CHECK: .long 12
-; CHECK: .long 11
-; CHECK: .long 10
-; CHECK: .long 9
-; CHECK: .long 8
-; CHECK: .long 7
-; CHECK: .long 6
-; CHECK: .long 5
-; CHECK: .long 4
-; CHECK: .long 3
-; CHECK: .long 2
-; CHECK: .long 1
+; CHECK: [[SO2_LANEIDCP:.LCPI[0-9]+_[0-9]+]]
 ; CHECK: .long 0
+; CHECK: .long 1
+; CHECK: .long 2
+; CHECK: .long 3
+; CHECK: .long 4
+; CHECK: .long 5
+; CHECK: .long 6
+; CHECK: .long 7
+; CHECK: .long 8
+; CHECK: .long 9
+; CHECK: .long 10
+; CHECK: .long 11
+; CHECK: .long 12
+; CHECK: .long 13
+; CHECK: .long 14
+; CHECK: .long 15
 define <16 x i32> @shuffle_only2(<16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL: shuffle_only2:
   %res = shufflevector <16 x i32> %a, <16 x i32> %b, <16 x i32> < i32 31, i32 30, i32 29, i32 28, i32 27, i32 26, i32 25, i32 24, i32 23, i32 22, i32 21, i32 20, i32 19, i32 18, i32 17, i32 16 >
 
-  ; CHECK: load_v [[SO2_SHUFFLEVEC:v[0-9]+]], [[SO2_SHUFFLEVECCP]]
+  ; CHECK: load_v [[SO2_LANEID:v[0-9]+]], [[SO2_LANEIDCP]]
+  ; CHECK-NEXT: xor [[SO2_SHUFFLEVEC:v[0-9]+]], [[SO2_LANEID]], 15
   ; CHECK-NEXT: shuffle v0, v1, [[SO2_SHUFFLEVEC]]
   ; CHECK-NEXT: ret
 
@@ -155,46 +158,113 @@ define <16 x i32> @shuffle_only2(<16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL:
 }
 
 ; Shuffle and mix vectors
-; CHECK: [[SM_SHUFFLEVECCP:.LCPI[0-9]+_[0-9]+]]
-; CHECK: .long 15
-; CHECK: .long 14
-; CHECK: .long 13
-; CHECK: .long 12
-; CHECK: .long 11
-; CHECK: .long 10
-; CHECK: .long 9
-; CHECK: .long 8
-; CHECK: .long 7
-; CHECK: .long 6
-; CHECK: .long 5
-; CHECK: .long 4
-; CHECK: .long 3
-; CHECK: .long 2
-; CHECK: .long 1
+; CHECK: [[SM_LANEIDCP:.LCPI[0-9]+_[0-9]+]]
 ; CHECK: .long 0
-; CHECK: [[SM_MASKCP:.LCPI[0-9]+_[0-9]+]]
-; CHECK: .long 43690
+; CHECK: .long 1
+; CHECK: .long 2
+; CHECK: .long 3
+; CHECK: .long 4
+; CHECK: .long 5
+; CHECK: .long 6
+; CHECK: .long 7
+; CHECK: .long 8
+; CHECK: .long 9
+; CHECK: .long 10
+; CHECK: .long 11
+; CHECK: .long 12
+; CHECK: .long 13
+; CHECK: .long 14
+; CHECK: .long 15
 
 define <16 x i32> @test_shuffle_mix(<16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL: test_shuffle_mix:
   %res = shufflevector <16 x i32> %a, <16 x i32> %b, <16 x i32> < i32 31, i32 14, i32 29, i32 12, i32 27, i32 10, i32 25, i32 8, i32 23, i32 6, i32 21, i32 4, i32 19, i32 2, i32 17, i32 0 >
 
-  ; CHECK: load_v [[SM_SHUFFLEVEC:v[0-9]+]], [[SM_SHUFFLEVECCP]]
-  ; CHECK: shuffle v0, v0, [[SM_SHUFFLEVEC]]
-  ; CHECK: load_32 [[SM_MASK:s[0-9]+]], [[SM_MASKCP]]
+  ; CHECK: load_v [[SM_LANEID:v[0-9]+]], [[SM_LANEIDCP]]
+  ; CHECK-DAG: xor [[SM_SHUFFLEVEC:v[0-9]+]], [[SM_LANEID]], 15
+  ; CHECK-DAG: move [[SM_MASK:s[0-9]+]], 10
+  ; CHECK-DAG: shl [[SM_MASK]], [[SM_MASK]], 12
+  ; CHECK-DAG: or [[SM_MASK]], [[SM_MASK]], 2730
+  ; CHECK-DAG: shuffle v0, v0, [[SM_SHUFFLEVEC]]
   ; CHECK: shuffle_mask {{v[0-9]+}}, [[SM_MASK]], v1, [[SM_SHUFFLEVEC]]
 
   ret <16 x i32> %res
 }
 
-; Ensure undef values are handled. Currently, they just map to lane zero, so this will look
-; like a single vector shuffle.
-define <16 x i32> @test_shuffle_undef(<16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL: test_shuffle_undef:
-  %res = shufflevector <16 x i32> %a, <16 x i32> %b, <16 x i32> <i32 undef, i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, i32 7, i32 8, i32 9, i32 8, i32 7, i32 6, i32 5, i32 4, i32 3>
+; Undefined lanes can take any value, so this still matches the rotate
+; pattern: (lane + 3) & 15.
+define <16 x i32> @test_rotate_undef(<16 x i32> %a) { ; CHECK-LABEL: test_rotate_undef:
+  %res = shufflevector <16 x i32> %a, <16 x i32> undef, <16 x i32> <i32 3, i32 undef, i32 5, i32 6, i32 7, i32 8, i32 9, i32 10, i32 11, i32 12, i32 13, i32 14, i32 15, i32 undef, i32 1, i32 2>
+
+  ; CHECK: load_v [[ROT_LANEID:v[0-9]+]],
+  ; CHECK: add_i [[ROT_SUM:v[0-9]+]], [[ROT_LANEID]], 3
+  ; CHECK: and [[ROT_SHUFFLEVEC:v[0-9]+]], [[ROT_SUM]], 15
+  ; CHECK: shuffle v0, v0, [[ROT_SHUFFLEVEC]]
+
+  ret <16 x i32> %res
+}
+
+; Interleave the low halves of two vectors.
+define <16 x i32> @test_interleave_lo(<16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL: test_interleave_lo:
+  %res = shufflevector <16 x i32> %a, <16 x i32> %b, <16 x i32> <i32 0, i32 16, i32 1, i32 17, i32 2, i32 18, i32 3, i32 19, i32 4, i32 20, i32 5, i32 21, i32 6, i32 22, i32 7, i32 23>
+
+  ; CHECK: load_v [[IL_LANEID:v[0-9]+]],
+  ; CHECK: shr [[IL_SHUFFLEVEC:v[0-9]+]], [[IL_LANEID]], 1
+  ; CHECK: shuffle_mask
+
+  ret <16 x i32> %res
+}
+
+; Select the odd lanes from the concatenation of both vectors
+define <16 x i32> @test_deinterleave_odd(<16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL: test_deinterleave_odd:
+  %res = shufflevector <16 x i32> %a, <16 x i32> %b, <16 x i32> <i32 1, i32 3, i32 5, i32 7, i32 9, i32 11, i32 13, i32 15, i32 17, i32 19, i32 21, i32 23, i32 25, i32 27, i32 29, i32 31>
+
+  ; CHECK: load_v [[DI_LANEID:v[0-9]+]],
+  ; CHECK: shl [[DI_SHIFTED:v[0-9]+]], [[DI_LANEID]], 1
+  ; CHECK: add_i [[DI_ODD:v[0-9]+]], [[DI_SHIFTED]], 1
+  ; CHECK: and [[DI_SHUFFLEVEC:v[0-9]+]], [[DI_ODD]], 15
+  ; CHECK: shuffle_mask
+
+  ret <16 x i32> %res
+}
 
-  ; CHECK: shuffle v0, v0, v
+; Both shuffles are computed from the same lane index vector, which is
+; only loaded once.
+define <16 x i32> @test_shared_lane_ids(<16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL: test_shared_lane_ids:
+  %rev = shufflevector <16 x i32> %a, <16 x i32> undef, <16 x i32> < i32 15, i32 14, i32 13, i32 12, i32 11, i32 10, i32 9, i32 8, i32 7, i32 6, i32 5, i32 4, i32 3, i32 2, i32 1, i32 0 >
+  %swap = shufflevector <16 x i32> %b, <16 x i32> undef, <16 x i32> < i32 1, i32 0, i32 3, i32 2, i32 5, i32 4, i32 7, i32 6, i32 9, i32 8, i32 11, i32 10, i32 13, i32 12, i32 15, i32 14 >
+  %res = add <16 x i32> %rev, %swap
+
+  ; CHECK: load_v [[SL_LANEID:v[0-9]+]],
+  ; CHECK-NOT: load_v
+  ; CHECK-DAG: xor {{v[0-9]+}}, [[SL_LANEID]], 15
+  ; CHECK-DAG: xor {{v[0-9]+}}, [[SL_LANEID]], 1
+  ; CHECK-NOT: load_v
+  ; CHECK: ret
 
   ret <16 x i32> %res
 }
 
+; Undefined lanes don't prevent detecting a splat.
+define <16 x i32> @test_splat_undef(<16 x i32> %a) { ; CHECK-LABEL: test_splat_undef:
+  %res = shufflevector <16 x i32> %a, <16 x i32> undef, <16 x i32> <i32 undef, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 undef, i32 5>
+
+  ; CHECK: getlane s0, v0, 5
+  ; CHECK: move v0, s0
+  ; CHECK-NOT: shuffle
 
+  ret <16 x i32> %res
+}
 
+; An arbitrary permutation still loads its index vector. Undefined lanes
+; keep their own lane number.
+; CHECK: [[UNDEF_SHUFFLEVECCP:.LCPI[0-9]+_[0-9]+]]
+; CHECK: .long 0
+; CHECK: .long 1
+define <16 x i32> @test_shuffle_undef(<16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL: test_shuffle_undef:
+  %res = shufflevector <16 x i32> %a, <16 x i32> %b, <16 x i32> <i32 undef, i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, i32 7, i32 8, i32 9, i32 8, i32 7, i32 6, i32 5, i32 4, i32 3>
+
+  ; CHECK: load_v [[UNDEF_SHUFFLEVEC:v[0-9]+]], [[UNDEF_SHUFFLEVECCP]]
+  ; CHECK: shuffle v0, v0, [[UNDEF_SHUFFLEVEC]]
+
+  ret <16 x i32> %res
+}
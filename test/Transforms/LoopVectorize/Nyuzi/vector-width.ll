@@ -0,0 +1,58 @@
+; RUN: opt < %s -loop-vectorize -S | FileCheck %s
+;
+; The vector unit has 16 x 32-bit lanes, so loops over 32-bit elements should
+; be vectorized with that width.
+;
+
+target datalayout = "e-m:e-p:32:32"
+target triple = "nyuzi-elf-none"
+
+; CHECK-LABEL: @scale_add(
+; CHECK: fmul <16 x float>
+; CHECK: fadd <16 x float>
+; CHECK: store <16 x float>
+define void @scale_add(float* noalias %dest, float* noalias %src, float %scale, i32 %n) {
+entry:
+  %cmp6 = icmp sgt i32 %n, 0
+  br i1 %cmp6, label %loop, label %exit
+
+loop:
+  %i = phi i32 [ %i.next, %loop ], [ 0, %entry ]
+  %src.ptr = getelementptr inbounds float, float* %src, i32 %i
+  %dest.ptr = getelementptr inbounds float, float* %dest, i32 %i
+  %a = load float, float* %src.ptr, align 4
+  %b = load float, float* %dest.ptr, align 4
+  %mul = fmul float %a, %scale
+  %add = fadd float %mul, %b
+  store float %add, float* %dest.ptr, align 4
+  %i.next = add nuw nsw i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+; CHECK-LABEL: @add_int(
+; CHECK: add nsw <16 x i32>
+define void @add_int(i32* noalias %dest, i32* noalias %a, i32* noalias %b, i32 %n) {
+entry:
+  %cmp6 = icmp sgt i32 %n, 0
+  br i1 %cmp6, label %loop, label %exit
+
+loop:
+  %i = phi i32 [ %i.next, %loop ], [ 0, %entry ]
+  %a.ptr = getelementptr inbounds i32, i32* %a, i32 %i
+  %b.ptr = getelementptr inbounds i32, i32* %b, i32 %i
+  %dest.ptr = getelementptr inbounds i32, i32* %dest, i32 %i
+  %a.val = load i32, i32* %a.ptr, align 4
+  %b.val = load i32, i32* %b.ptr, align 4
+  %sum = add nsw i32 %a.val, %b.val
+  store i32 %sum, i32* %dest.ptr, align 4
+  %i.next = add nuw nsw i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
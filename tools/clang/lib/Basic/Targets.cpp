@@ -8000,6 +8000,18 @@ public:
   virtual BuiltinVaListKind getBuiltinVaListKind() const override {
     return TargetInfo::VoidPtrBuiltinVaList;
   }
+
+  // preserve_most passes more vector arguments in registers and preserves
+  // most registers across calls, for small helpers called from kernels.
+  CallingConvCheckResult checkCallingConvention(CallingConv CC) const override {
+    switch (CC) {
+    case CC_C:
+    case CC_PreserveMost:
+      return CCCR_OK;
+    default:
+      return CCCR_Warning;
+    }
+  }
 };
 
 const char *const NyuziTargetInfo::GCCRegNames[] = {
@@ -7951,6 +7951,15 @@ Value *CodeGenFunction::EmitNyuziBuiltinExpr(unsigned BuiltinID,
     case Nyuzi::BI__builtin_nyuzi_write_control_reg:
       F = CGM.getIntrinsic(Intrinsic::nyuzi_write_control_reg);
       break;
+    case Nyuzi::BI__builtin_nyuzi_dflush:
+      F = CGM.getIntrinsic(Intrinsic::nyuzi_dflush);
+      break;
+    case Nyuzi::BI__builtin_nyuzi_dinvalidate:
+      F = CGM.getIntrinsic(Intrinsic::nyuzi_dinvalidate);
+      break;
+    case Nyuzi::BI__builtin_nyuzi_iinvalidate:
+      F = CGM.getIntrinsic(Intrinsic::nyuzi_iinvalidate);
+      break;
     case Nyuzi::BI__builtin_nyuzi_shufflei:
       F = CGM.getIntrinsic(Intrinsic::nyuzi_shufflei);
       break;
@@ -7987,6 +7996,12 @@ Value *CodeGenFunction::EmitNyuziBuiltinExpr(unsigned BuiltinID,
     case Nyuzi::BI__builtin_nyuzi_scatter_storef_masked:
       F = CGM.getIntrinsic(Intrinsic::nyuzi_scatter_storef_masked);
       break;
+    case Nyuzi::BI__builtin_nyuzi_scatter_atomic_addi:
+      F = CGM.getIntrinsic(Intrinsic::nyuzi_scatter_atomic_addi);
+      break;
+    case Nyuzi::BI__builtin_nyuzi_scatter_atomic_addf:
+      F = CGM.getIntrinsic(Intrinsic::nyuzi_scatter_atomic_addf);
+      break;
     case Nyuzi::BI__builtin_nyuzi_block_loadi_masked:
       F = CGM.getIntrinsic(Intrinsic::nyuzi_block_loadi_masked);
       break;
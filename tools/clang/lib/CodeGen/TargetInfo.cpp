@@ -6511,6 +6511,33 @@ void MSP430TargetCodeGenInfo::setTargetAttributes(const Decl *D,
   }
 }
 
+//===----------------------------------------------------------------------===//
+// Nyuzi ABI Implementation
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+class NyuziTargetCodeGenInfo : public TargetCodeGenInfo {
+public:
+  NyuziTargetCodeGenInfo(CodeGenTypes &CGT)
+    : TargetCodeGenInfo(new DefaultABIInfo(CGT)) {}
+  void setTargetAttributes(const Decl *D, llvm::GlobalValue *GV,
+                           CodeGen::CodeGenModule &M) const override;
+};
+
+}
+
+void NyuziTargetCodeGenInfo::setTargetAttributes(const Decl *D,
+                                                 llvm::GlobalValue *GV,
+                                             CodeGen::CodeGenModule &M) const {
+  const FunctionDecl *FD = dyn_cast_or_null<FunctionDecl>(D);
+  if (!FD || !FD->hasAttr<NyuziAtomicBackoffAttr>())
+    return;
+
+  // Read by NyuziTargetLowering::emitStoreConditional
+  cast<llvm::Function>(GV)->addFnAttr("nyuzi-atomic-backoff");
+}
+
 //===----------------------------------------------------------------------===//
 // MIPS ABI Implementation.  This works for both little-endian and
 // big-endian variants.
@@ -8474,6 +8501,9 @@ const TargetCodeGenInfo &CodeGenModule::getTargetCodeGenInfo() {
   case llvm::Triple::msp430:
     return SetCGInfo(new MSP430TargetCodeGenInfo(Types));
 
+  case llvm::Triple::nyuzi:
+    return SetCGInfo(new NyuziTargetCodeGenInfo(Types));
+
   case llvm::Triple::systemz: {
     bool HasVector = getTarget().getABI() == "vector";
     return SetCGInfo(new SystemZTargetCodeGenInfo(Types, HasVector));
@@ -0,0 +1,15 @@
+// RUN: %clang_cc1 -triple nyuzi-none-none -emit-llvm -o - %s | FileCheck %s
+
+// CHECK: define i32 @backoff_add({{.*}}) [[BACKOFF:#[0-9]+]]
+int __attribute__((nyuzi_atomic_backoff)) backoff_add(volatile int *lockvar)
+{
+	return __sync_fetch_and_add(lockvar, 1);
+}
+
+// CHECK: define i32 @plain_add(
+int plain_add(volatile int *lockvar)
+{
+	return __sync_fetch_and_add(lockvar, 1);
+}
+
+// CHECK: attributes [[BACKOFF]] = { {{.*}}"nyuzi-atomic-backoff"
@@ -6,7 +6,6 @@ int atomic_add(volatile int *lockvar)
 	return __sync_fetch_and_and(lockvar, 1);
 
 	// CHECK: load_sync [[SCRATCH1:s[0-9]+]], (s0)
-	// CHECK: move {{s[0-9]+}}, [[SCRATCH1]]
 	// CHECK: and [[SCRATCH2:s[0-9]+]], [[SCRATCH1]],
 	// CHECK: store_sync [[SCRATCH2]], (s0)
 	// CHECK: bz [[SCRATCH2]],
@@ -30,12 +29,11 @@ void atomic_cmp_swap(volatile int *lockvar)
 	while (__sync_val_compare_and_swap(lockvar, old, old + 1) != old);
 
 	// CHECK:   load_sync
-	// CHECK:   cmpne_i [[CMPRES:s[0-9]+]]
-	// CHECK:   bnz [[CMPRES]],
+	// CHECK:   cmp{{eq|ne}}_i [[CMPRES:s[0-9]+]]
+	// CHECK:   b{{n?z}} [[CMPRES]],
 
-	// CHECK:   move [[SUCCESS:s[0-9]+]]
-	// CHECK:   store_sync [[SUCCESS]]
-	// CHECK:   bz [[SUCCESS]],
+	// CHECK:   store_sync [[SUCCESS:s[0-9]+]]
+	// CHECK:   b{{n?z}} [[SUCCESS]],
 }
 
 // CHECK: atomic_test_set:
@@ -44,8 +42,8 @@ void atomic_test_set(volatile int *lockvar)
 	while (!__sync_lock_test_and_set(lockvar, 1))
 		;
 
-	// CHECK: load_sync [[SCRATCH1:s[0-9]+]], (s0)
-	// CHECK: move {{s[0-9]+}}, [[SCRATCH1]]
+	// CHECK: load_sync {{s[0-9]+}}, (s0)
+	// CHECK: move [[SCRATCH1:s[0-9]+]], 1
 	// CHECK: store_sync [[SCRATCH1]], (s0)
 	// CHECK: bz [[SCRATCH1]],
 }
@@ -9,6 +9,30 @@ int test_write_control_reg(int value)	// CHECK: test_write_control_reg:
 	// CHECK: setcr s{{[0-9]+}}, 5
 }
 
+void test_dflush(void *ptr)	// CHECK: test_dflush:
+{
+	__builtin_nyuzi_dflush(ptr);
+	// CHECK: dflush s0
+}
+
+void test_dinvalidate(void *ptr)	// CHECK: test_dinvalidate:
+{
+	__builtin_nyuzi_dinvalidate(ptr);
+	// CHECK: dinvalidate s0
+}
+
+void test_iinvalidate(void *ptr)	// CHECK: test_iinvalidate:
+{
+	__builtin_nyuzi_iinvalidate(ptr);
+	// CHECK: iinvalidate s0
+}
+
+void test_prefetch(const int *ptr)	// CHECK: test_prefetch:
+{
+	__builtin_prefetch(ptr + 16);
+	// CHECK: load_u8 s{{[0-9]+}}, 64(s0)
+}
+
 int test_read_control_reg(int value)	// CHECK: test_read_control_reg:
 {
 	return __builtin_nyuzi_read_control_reg(7);
@@ -72,6 +96,24 @@ void test_scatter_storef_masked(veci16_t ptr, vecf16_t value, int mask) // CHECK
 	// CHECK: store_scat_mask v1, s0, (v0)
 }
 
+void test_scatter_atomic_addi(veci16_t ptr, veci16_t value) // CHECK: test_scatter_atomic_addi
+{
+	__builtin_nyuzi_scatter_atomic_addi(ptr, value);
+
+	// CHECK: load_sync
+	// CHECK: add_i
+	// CHECK: store_sync
+}
+
+void test_scatter_atomic_addf(veci16_t ptr, vecf16_t value) // CHECK: test_scatter_atomic_addf
+{
+	__builtin_nyuzi_scatter_atomic_addf(ptr, value);
+
+	// CHECK: load_sync
+	// CHECK: add_f
+	// CHECK: store_sync
+}
+
 veci16_t test_block_loadi_masked(veci16_t *ptr, int mask)	// CHECK: test_block_loadi_masked:
 {
 	return __builtin_nyuzi_block_loadi_masked(ptr, mask);
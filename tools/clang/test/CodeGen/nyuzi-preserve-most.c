@@ -0,0 +1,16 @@
+// RUN: %clang_cc1 -triple nyuzi-none-none -emit-llvm -o - %s | FileCheck %s
+
+typedef int veci16_t __attribute__((ext_vector_type(16)));
+
+// CHECK: define preserve_mostcc <16 x i32> @shade(
+veci16_t __attribute__((preserve_most)) shade(veci16_t a, veci16_t b)
+{
+	return a + b;
+}
+
+// CHECK: define <16 x i32> @kernel(
+veci16_t kernel(veci16_t a, veci16_t b)
+{
+	// CHECK: call preserve_mostcc <16 x i32> @shade(
+	return shade(a, b) + b;
+}
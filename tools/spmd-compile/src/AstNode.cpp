@@ -3,45 +3,137 @@
 
 using namespace llvm;
 
-Value *SubAst::generate(SPMDBuilder &Builder) {
-  Value *Op1Val = Op1->generate(Builder);
-  Value *Op2Val = Op2->generate(Builder);
+// The usual arithmetic conversions from C: if either operand is float the
+// other is converted to float, otherwise unsigned wins over signed.
+ValueType getCommonType(ValueType Type1, ValueType Type2) {
+  if (Type1 == ValueType::Float || Type2 == ValueType::Float)
+    return ValueType::Float;
 
+  if (Type1 == ValueType::UInt || Type2 == ValueType::UInt)
+    return ValueType::UInt;
+
+  return ValueType::Int;
+}
+
+static void generateOperands(SPMDBuilder &Builder, AstNode *Op1, AstNode *Op2,
+                             ValueType Type, Value *&Op1Val, Value *&Op2Val) {
+  Op1Val = Builder.convert(Op1->generate(Builder), Op1->getType(), Type);
+  Op2Val = Builder.convert(Op2->generate(Builder), Op2->getType(), Type);
+}
+
+Value *SubAst::generate(SPMDBuilder &Builder) {
+  Value *Op1Val, *Op2Val;
+  generateOperands(Builder, Op1, Op2, getType(), Op1Val, Op2Val);
   return Builder.createSub(Op1Val, Op2Val);
 }
 
-Value *AddAst::generate(SPMDBuilder &Builder) {
-  Value *Op1Val = Op1->generate(Builder);
-  Value *Op2Val = Op2->generate(Builder);
+ValueType SubAst::getType() const {
+  return getCommonType(Op1->getType(), Op2->getType());
+}
+
+bool SubAst::isUniform() const { return Op1->isUniform() && Op2->isUniform(); }
 
+Value *AddAst::generate(SPMDBuilder &Builder) {
+  Value *Op1Val, *Op2Val;
+  generateOperands(Builder, Op1, Op2, getType(), Op1Val, Op2Val);
   return Builder.createAdd(Op1Val, Op2Val);
 }
 
-Value *MulAst::generate(SPMDBuilder &Builder) {
-  Value *Op1Val = Op1->generate(Builder);
-  Value *Op2Val = Op2->generate(Builder);
+ValueType AddAst::getType() const {
+  return getCommonType(Op1->getType(), Op2->getType());
+}
+
+bool AddAst::isUniform() const { return Op1->isUniform() && Op2->isUniform(); }
 
+bool AddAst::isContiguousIndex(AstNode *&Offset) {
+  AstNode *Inner;
+  if (Op1->isContiguousIndex(Inner) && !Inner && Op2->isUniform()) {
+    Offset = Op2;
+    return true;
+  }
+
+  if (Op2->isContiguousIndex(Inner) && !Inner && Op1->isUniform()) {
+    Offset = Op1;
+    return true;
+  }
+
+  return false;
+}
+
+Value *MulAst::generate(SPMDBuilder &Builder) {
+  Value *Op1Val, *Op2Val;
+  generateOperands(Builder, Op1, Op2, getType(), Op1Val, Op2Val);
   return Builder.createMul(Op1Val, Op2Val);
 }
 
+ValueType MulAst::getType() const {
+  return getCommonType(Op1->getType(), Op2->getType());
+}
+
+bool MulAst::isUniform() const { return Op1->isUniform() && Op2->isUniform(); }
+
 Value *DivAst::generate(SPMDBuilder &Builder) {
-  Value *Op1Val = Op1->generate(Builder);
-  Value *Op2Val = Op2->generate(Builder);
+  Value *Op1Val, *Op2Val;
+  generateOperands(Builder, Op1, Op2, getType(), Op1Val, Op2Val);
+  return Builder.createDiv(Op1Val, Op2Val, getType());
+}
 
-  return Builder.createDiv(Op1Val, Op2Val);
+ValueType DivAst::getType() const {
+  return getCommonType(Op1->getType(), Op2->getType());
 }
 
+bool DivAst::isUniform() const { return Op1->isUniform() && Op2->isUniform(); }
+
 Value *AssignAst::generate(SPMDBuilder &Builder) {
   Symbol *Sym = static_cast<VariableAst *>(Lhs)->Sym;
   if (Sym->Val == nullptr)
     Sym->Val = Builder.createLocalVariable(Sym->Name.c_str(),
-      Builder.sFloatType);
+      Sym->Type, Sym->IsUniform);
+
+  Value *NewValue =
+      Builder.convert(Rhs->generate(Builder), Rhs->getType(), Sym->Type);
+  return Builder.assignLocalVariable(Sym->Val, NewValue, Sym->Type);
+}
 
-  return Builder.assignLocalVariable(Sym->Val,
-                                     Rhs->generate(Builder));
+bool AssignAst::markVaryingVariables(bool VaryingControlFlow) {
+  Symbol *Sym = static_cast<VariableAst *>(Lhs)->Sym;
+  if (Sym->IsUniform && (VaryingControlFlow || !Rhs->isUniform())) {
+    Sym->IsUniform = false;
+    return true;
+  }
+
+  return false;
 }
 
 Value *IfAst::generate(SPMDBuilder &Builder) {
+  if (Cond->isUniform()) {
+    // All lanes take the same path, so branch directly without pushing a
+    // mask. Varying code nested inside may still change it, so it is reset
+    // where the paths join.
+    llvm::BasicBlock *ThenBB = Builder.createBasicBlock("then");
+    llvm::BasicBlock *EndifBB = Builder.createBasicBlock("endif");
+    llvm::BasicBlock *ElseBB =
+        Else ? Builder.createBasicBlock("elsebody") : EndifBB;
+
+    SPMDBuilder::MaskState State = Builder.saveMaskState();
+    bool MayReturn = Then->hasVaryingReturn();
+    Builder.conditionalBranch(Cond->generate(Builder), ThenBB, ElseBB);
+    Builder.startBasicBlock(ThenBB);
+    Then->generate(Builder);
+    Builder.branch(EndifBB);
+    if (Else) {
+      Builder.startBasicBlock(ElseBB);
+      Builder.restoreMaskState(State, false);
+      Else->generate(Builder);
+      MayReturn |= Else->hasVaryingReturn();
+      Builder.branch(EndifBB);
+    }
+
+    Builder.startBasicBlock(EndifBB);
+    Builder.restoreMaskState(State, MayReturn);
+    return nullptr;
+  }
+
   Builder.pushMask(Cond->generate(Builder));
   if (Else) {
     llvm::BasicBlock *ThenBB = Builder.createBasicBlock("then");
@@ -80,63 +172,149 @@ Value *IfAst::generate(SPMDBuilder &Builder) {
   return nullptr;
 }
 
-Value *WhileAst::generate(SPMDBuilder &Builder) {
+bool IfAst::markVaryingVariables(bool VaryingControlFlow) {
+  bool Varying = VaryingControlFlow || !Cond->isUniform();
+  bool Changed = Then && Then->markVaryingVariables(Varying);
+  if (Else)
+    Changed |= Else->markVaryingVariables(Varying);
+
+  return Changed;
+}
+
+bool IfAst::hasVaryingReturn() const {
+  return (Then && Then->hasVaryingReturn()) ||
+         (Else && Else->hasVaryingReturn());
+}
+
+// Shared by while and for loops. If the condition is uniform, all lanes
+// leave the loop on the same iteration, so it is a plain scalar loop.
+// The top of the loop is also reached from the end of the body, so the mask
+// is reset there, and lanes that returned in the body must stay off.
+static void generateLoop(SPMDBuilder &Builder, AstNode *Cond, AstNode *Body) {
   llvm::BasicBlock *LoopTopBB = Builder.createBasicBlock("looptop");
   llvm::BasicBlock *LoopBodyBB = Builder.createBasicBlock("loopbody");
   llvm::BasicBlock *LoopEndBB = Builder.createBasicBlock("loopend");
 
   // Loop check
+  SPMDBuilder::MaskState State = Builder.saveMaskState();
+  bool MayReturn = Body->hasVaryingReturn();
   Builder.branch(LoopTopBB);
   Builder.startBasicBlock(LoopTopBB);
+  Builder.restoreMaskState(State, MayReturn);
   Value *LoopCond = Cond->generate(Builder);
-  Builder.pushMask(LoopCond);
-  Builder.shortCircuitZeroMask(LoopEndBB, LoopBodyBB);
+  bool IsUniform = Cond->isUniform();
+  if (IsUniform)
+    Builder.conditionalBranch(LoopCond, LoopBodyBB, LoopEndBB);
+  else {
+    Builder.pushMask(LoopCond);
+    Builder.shortCircuitZeroMask(LoopEndBB, LoopBodyBB);
+  }
 
   // Loop body
   Builder.startBasicBlock(LoopBodyBB);
   Body->generate(Builder);
   Builder.branch(LoopTopBB);
   Builder.startBasicBlock(LoopEndBB);
-  Builder.popMask();
-  return nullptr;
+  if (IsUniform)
+    Builder.restoreMaskState(State, MayReturn);
+  else
+    Builder.popMask();
 }
 
-Value *ForAst::generate(SPMDBuilder &Builder) {
-  llvm::BasicBlock *LoopTopBB = Builder.createBasicBlock("looptop");
-  llvm::BasicBlock *LoopBodyBB = Builder.createBasicBlock("loopbody");
-  llvm::BasicBlock *LoopEndBB = Builder.createBasicBlock("loopend");
+Value *WhileAst::generate(SPMDBuilder &Builder) {
+  generateLoop(Builder, Cond, Body);
+  return nullptr;
+}
 
-  Init->generate(Builder);
+bool WhileAst::markVaryingVariables(bool VaryingControlFlow) {
+  return Body &&
+         Body->markVaryingVariables(VaryingControlFlow || !Cond->isUniform());
+}
 
-  // Loop check
-  Builder.branch(LoopTopBB);
-  Builder.startBasicBlock(LoopTopBB);
-  Value *LoopCond = Cond->generate(Builder);
-  Builder.pushMask(LoopCond);
-  Builder.shortCircuitZeroMask(LoopEndBB, LoopBodyBB);
+bool WhileAst::hasVaryingReturn() const {
+  return Body && Body->hasVaryingReturn();
+}
 
-  // Loop body
-  Builder.startBasicBlock(LoopBodyBB);
-  Body->generate(Builder);
-  Builder.branch(LoopTopBB);
-  Builder.startBasicBlock(LoopEndBB);
-  Builder.popMask();
+Value *ForAst::generate(SPMDBuilder &Builder) {
+  Init->generate(Builder);
+  generateLoop(Builder, Cond, Body);
   return nullptr;
 }
 
+bool ForAst::markVaryingVariables(bool VaryingControlFlow) {
+  // The initializer runs once before the loop, so it is only under varying
+  // control flow if the loop itself is.
+  bool Changed = Init->markVaryingVariables(VaryingControlFlow);
+  Changed |=
+      Body->markVaryingVariables(VaryingControlFlow || !Cond->isUniform());
+  return Changed;
+}
+
+bool ForAst::hasVaryingReturn() const { return Body->hasVaryingReturn(); }
+
 Value *VariableAst::generate(SPMDBuilder &Builder) {
   if (Sym->Val == nullptr)
     Sym->Val = Builder.createLocalVariable(Sym->Name.c_str(),
-      Builder.sFloatType);
+      Sym->Type, Sym->IsUniform);
 
   return Builder.readLocalVariable(Sym->Val);
 }
 
+bool VariableAst::isUniform() const { return Sym->IsUniform; }
+
+bool VariableAst::isContiguousIndex(AstNode *&Offset) {
+  if (!Sym->ForeachBase)
+    return false;
+
+  Offset = Sym->ForeachBase;
+  return true;
+}
+
+// Arrays and structs can only be used as a whole when passing them to a
+// function, so they don't have a value type.
+ValueType VariableAst::getType() const {
+  if (Sym->IsPointer || Sym->Struct)
+    return ValueType::Void;
+
+  return Sym->Type;
+}
+
+// The parser creates floating point predicates. Map them to integer
+// comparisons if the operands are integers.
+static CmpInst::Predicate getIntPredicate(CmpInst::Predicate Pred,
+                                          bool IsUnsigned) {
+  switch (Pred) {
+  case CmpInst::FCMP_UEQ:
+    return CmpInst::ICMP_EQ;
+  case CmpInst::FCMP_UNE:
+    return CmpInst::ICMP_NE;
+  case CmpInst::FCMP_UGT:
+    return IsUnsigned ? CmpInst::ICMP_UGT : CmpInst::ICMP_SGT;
+  case CmpInst::FCMP_UGE:
+    return IsUnsigned ? CmpInst::ICMP_UGE : CmpInst::ICMP_SGE;
+  case CmpInst::FCMP_ULT:
+    return IsUnsigned ? CmpInst::ICMP_ULT : CmpInst::ICMP_SLT;
+  case CmpInst::FCMP_ULE:
+    return IsUnsigned ? CmpInst::ICMP_ULE : CmpInst::ICMP_SLE;
+  default:
+    llvm_unreachable("Unknown comparison type");
+  }
+}
+
 Value *CompareAst::generate(SPMDBuilder &Builder) {
-  Value *Op1Val = Op1->generate(Builder);
-  Value *Op2Val = Op2->generate(Builder);
+  ValueType OperandType = getCommonType(Op1->getType(), Op2->getType());
+  Value *Op1Val, *Op2Val;
+  generateOperands(Builder, Op1, Op2, OperandType, Op1Val, Op2Val);
 
-  return Builder.createCompare(Type, Op1Val, Op2Val);
+  CmpInst::Predicate Pred = Type;
+  if (OperandType != ValueType::Float)
+    Pred = getIntPredicate(Type, OperandType == ValueType::UInt);
+
+  return Builder.createCompare(Pred, Op1Val, Op2Val);
+}
+
+bool CompareAst::isUniform() const {
+  return Op1->isUniform() && Op2->isUniform();
 }
 
 Value *SequenceAst::generate(SPMDBuilder &Builder) {
@@ -148,12 +326,132 @@ Value *SequenceAst::generate(SPMDBuilder &Builder) {
   return nullptr;
 }
 
+bool SequenceAst::markVaryingVariables(bool VaryingControlFlow) {
+  bool Changed = Stmt && Stmt->markVaryingVariables(VaryingControlFlow);
+  if (Next)
+    Changed |= Next->markVaryingVariables(VaryingControlFlow);
+
+  return Changed;
+}
+
+bool SequenceAst::hasVaryingReturn() const {
+  return (Stmt && Stmt->hasVaryingReturn()) ||
+         (Next && Next->hasVaryingReturn());
+}
+
 Value *ReturnAst::generate(SPMDBuilder &Builder) {
-  Value *RetVal = RetNode->generate(Builder);
+  Value *RetVal = nullptr;
+  if (RetNode)
+    RetVal = Builder.convert(RetNode->generate(Builder), RetNode->getType(),
+                             Builder.getReturnType());
+
   Builder.createReturn(RetVal);
   return RetVal;
 }
 
+bool ReturnAst::markVaryingVariables(bool VaryingControlFlow) {
+  IsVarying = VaryingControlFlow;
+  return false;
+}
+
+Value *ForeachAst::generate(SPMDBuilder &Builder) {
+  Value *StartVal = Builder.convert(Start->generate(Builder), Start->getType(),
+                                    ValueType::Int);
+  Value *EndVal =
+      Builder.convert(End->generate(Builder), End->getType(), ValueType::Int);
+
+  Symbol *BaseSym = Index->ForeachBase->getSymbol();
+  Index->Val = Builder.createLocalVariable(Index->Name.c_str(), ValueType::Int);
+  BaseSym->Val = Builder.createLocalVariable(BaseSym->Name.c_str(),
+                                             ValueType::Int, true);
+
+  Builder.startForeach(StartVal, EndVal, Index->Val, BaseSym->Val);
+  if (Body)
+    Body->generate(Builder);
+
+  Builder.endForeach();
+  return nullptr;
+}
+
+bool ForeachAst::markVaryingVariables(bool VaryingControlFlow) {
+  // Lanes past the end of the range are masked off in the last chunk.
+  return Body && Body->markVaryingVariables(true);
+}
+
+Value *CallAst::generate(SPMDBuilder &Builder) {
+  std::vector<Value *> ArgVals;
+  for (unsigned Idx = 0; Idx < Args.size(); Idx++) {
+    Symbol *Param = Func->Params[Idx];
+    if (Param->IsPointer)
+      ArgVals.push_back(Args[Idx]->getSymbol()->Val);
+    else if (Param->Struct) {
+      // Pass each field as a separate argument.
+      for (auto FieldSym : Args[Idx]->getSymbol()->Fields) {
+        VariableAst Field(FieldSym);
+        ArgVals.push_back(Field.generate(Builder));
+      }
+    } else {
+      ArgVals.push_back(Builder.convert(Args[Idx]->generate(Builder),
+                                        Args[Idx]->getType(), Param->Type));
+    }
+  }
+
+  return Builder.createCall(Func, ArgVals);
+}
+
 Value *ConstantAst::generate(SPMDBuilder &Builder) {
-  return Builder.createConstant(Value);
+  return Builder.createConstant(Value, Type);
+}
+
+Value *LogicalAst::generate(SPMDBuilder &Builder) {
+  Value *Op1Val = Op1->generate(Builder);
+  if (Op == Not)
+    return Builder.createNot(Op1Val);
+
+  Value *Op2Val = Op2->generate(Builder);
+  if (Op == And)
+    return Builder.createAnd(Op1Val, Op2Val);
+
+  return Builder.createOr(Op1Val, Op2Val);
+}
+
+bool LogicalAst::isUniform() const {
+  return Op1->isUniform() && (!Op2 || Op2->isUniform());
+}
+
+Value *ProgramIndexAst::generate(SPMDBuilder &Builder) {
+  return Builder.createProgramIndex();
+}
+
+bool ProgramIndexAst::isContiguousIndex(AstNode *&Offset) {
+  Offset = nullptr;
+  return true;
+}
+
+Value *SubscriptAst::generate(SPMDBuilder &Builder) {
+  AstNode *Offset;
+  if (Index->isContiguousIndex(Offset)) {
+    Value *OffsetVal = Offset ? Offset->generate(Builder) : nullptr;
+    return Builder.createBlockLoad(Base->Val, OffsetVal);
+  }
+
+  return Builder.createLoad(Base->Val, Index->generate(Builder));
+}
+
+bool SubscriptAst::isUniform() const { return Index->isUniform(); }
+
+void SubscriptAst::generateStore(SPMDBuilder &Builder, Value *NewValue) {
+  AstNode *Offset;
+  if (Index->isContiguousIndex(Offset)) {
+    Value *OffsetVal = Offset ? Offset->generate(Builder) : nullptr;
+    Builder.createBlockStore(Base->Val, OffsetVal, NewValue);
+  } else
+    Builder.createStore(Base->Val, Index->generate(Builder), NewValue);
+}
+
+Value *StoreAst::generate(SPMDBuilder &Builder) {
+  Value *NewValue =
+      Builder.convert(Rhs->generate(Builder), Rhs->getType(), Lhs->getType());
+  Lhs->generateStore(Builder, NewValue);
+  return NewValue;
 }
@@ -4,10 +4,39 @@
 #include "SPMDBuilder.h"
 #include "Symbol.h"
 
+ValueType getCommonType(ValueType Type1, ValueType Type2);
+
 class AstNode {
 public:
   virtual llvm::Value *generate(SPMDBuilder &) = 0;
   virtual ~AstNode() = default;
+
+  /// An expression is uniform if it has the same value in every lane. Uniform
+  /// values are computed with scalar instructions, and uniform conditions
+  /// branch directly instead of updating the mask.
+  virtual bool isUniform() const { return false; }
+
+  /// Type of the value this expression computes (Void for statements).
+  virtual ValueType getType() const { return ValueType::Void; }
+
+  /// Clear IsUniform on variables that are assigned a varying value, or that
+  /// are assigned under varying control flow (where only some lanes would be
+  /// updated). Returns true if any variable changed, in which case this needs
+  /// to be called again, since expressions that use it may now be varying.
+  virtual bool markVaryingVariables(bool VaryingControlFlow) { return false; }
+
+  /// Returns true if this contains a return under varying control flow. Only
+  /// those clear lanes from the return mask, so the mask can't change in code
+  /// without one. Valid after markVaryingVariables.
+  virtual bool hasVaryingReturn() const { return false; }
+
+  /// Returns true if this expression is programIndex plus a uniform offset,
+  /// which means lanes access consecutive elements. Offset is set to the
+  /// offset expression, or nullptr if there isn't one.
+  virtual bool isContiguousIndex(AstNode *&Offset) { return false; }
+
+  /// If this is a reference to a variable, return its symbol.
+  virtual Symbol *getSymbol() { return nullptr; }
 };
 
 class SubAst : public AstNode {
@@ -15,6 +44,8 @@ public:
   SubAst(AstNode *_Op1, AstNode *_Op2) : Op1(_Op1), Op2(_Op2) {}
 
   virtual llvm::Value *generate(SPMDBuilder &);
+  virtual bool isUniform() const;
+  virtual ValueType getType() const;
 
 private:
   AstNode *Op1;
@@ -26,6 +57,9 @@ public:
   AddAst(AstNode *_Op1, AstNode *_Op2) : Op1(_Op1), Op2(_Op2) {}
 
   virtual llvm::Value *generate(SPMDBuilder &);
+  virtual bool isUniform() const;
+  virtual ValueType getType() const;
+  virtual bool isContiguousIndex(AstNode *&Offset);
 
 private:
   AstNode *Op1;
@@ -37,6 +71,8 @@ public:
   MulAst(AstNode *_Op1, AstNode *_Op2) : Op1(_Op1), Op2(_Op2) {}
 
   virtual llvm::Value *generate(SPMDBuilder &);
+  virtual bool isUniform() const;
+  virtual ValueType getType() const;
 
 private:
   AstNode *Op1;
@@ -48,6 +84,8 @@ public:
   DivAst(AstNode *_Op1, AstNode *_Op2) : Op1(_Op1), Op2(_Op2) {}
 
   virtual llvm::Value *generate(SPMDBuilder &);
+  virtual bool isUniform() const;
+  virtual ValueType getType() const;
 
 private:
   AstNode *Op1;
@@ -59,6 +97,7 @@ public:
   AssignAst(AstNode *_Lhs, AstNode *_Rhs) : Lhs(_Lhs), Rhs(_Rhs) {}
 
   virtual llvm::Value *generate(SPMDBuilder &);
+  virtual bool markVaryingVariables(bool VaryingControlFlow);
 
 private:
   AstNode *Lhs;
@@ -70,6 +109,8 @@ public:
   SequenceAst(AstNode *_Stmt, AstNode *_Next) : Stmt(_Stmt), Next(_Next) {}
 
   virtual llvm::Value *generate(SPMDBuilder &);
+  virtual bool markVaryingVariables(bool VaryingControlFlow);
+  virtual bool hasVaryingReturn() const;
 
 private:
   AstNode *Stmt;
@@ -82,6 +123,8 @@ public:
       : Cond(_Cond), Then(_Then), Else(_Else) {}
 
   virtual llvm::Value *generate(SPMDBuilder &);
+  virtual bool markVaryingVariables(bool VaryingControlFlow);
+  virtual bool hasVaryingReturn() const;
 
 private:
   AstNode *Cond;
@@ -94,6 +137,8 @@ public:
   WhileAst(AstNode *_Cond, AstNode *_Body) : Cond(_Cond), Body(_Body) {}
 
   virtual llvm::Value *generate(SPMDBuilder &);
+  virtual bool markVaryingVariables(bool VaryingControlFlow);
+  virtual bool hasVaryingReturn() const;
 
 private:
   AstNode *Cond;
@@ -106,6 +151,8 @@ public:
     AstNode *_Body) : Init(_Init), Cond(_Cond), Body(new SequenceAst(_Body, _Incr)) {}
 
   virtual llvm::Value *generate(SPMDBuilder &);
+  virtual bool markVaryingVariables(bool VaryingControlFlow);
+  virtual bool hasVaryingReturn() const;
 
 private:
   AstNode *Init;
@@ -118,6 +165,10 @@ public:
   VariableAst(Symbol *_Sym) : Sym(_Sym) {}
 
   virtual llvm::Value *generate(SPMDBuilder &);
+  virtual bool isUniform() const;
+  virtual ValueType getType() const;
+  virtual Symbol *getSymbol() { return Sym; }
+  virtual bool isContiguousIndex(AstNode *&Offset);
 
 private:
   Symbol *Sym;
@@ -130,6 +181,8 @@ public:
       : Type(_Type), Op1(_Op1), Op2(_Op2) {}
 
   virtual llvm::Value *generate(SPMDBuilder &);
+  virtual bool isUniform() const;
+  virtual ValueType getType() const { return ValueType::Bool; }
 
 private:
   llvm::CmpInst::Predicate Type;
@@ -142,19 +195,109 @@ public:
   ReturnAst(AstNode *_RetNode) : RetNode(_RetNode) {}
 
   virtual llvm::Value *generate(SPMDBuilder &);
+  virtual bool markVaryingVariables(bool VaryingControlFlow);
+  virtual bool hasVaryingReturn() const { return IsVarying; }
 
 private:
   AstNode *RetNode;
+  bool IsVarying = false;
+};
+
+/// The lane number, 0-15.
+class ProgramIndexAst : public AstNode {
+public:
+  virtual llvm::Value *generate(SPMDBuilder &);
+  virtual bool isContiguousIndex(AstNode *&Offset);
+  virtual ValueType getType() const { return ValueType::Int; }
+};
+
+/// Read an element of an array parameter.
+class SubscriptAst : public AstNode {
+public:
+  SubscriptAst(Symbol *_Base, AstNode *_Index) : Base(_Base), Index(_Index) {}
+
+  virtual llvm::Value *generate(SPMDBuilder &);
+  virtual bool isUniform() const;
+  virtual ValueType getType() const { return Base->Type; }
+  void generateStore(SPMDBuilder &, llvm::Value *NewValue);
+
+private:
+  Symbol *Base;
+  AstNode *Index;
+};
+
+/// Write an element of an array parameter.
+class StoreAst : public AstNode {
+public:
+  StoreAst(SubscriptAst *_Lhs, AstNode *_Rhs) : Lhs(_Lhs), Rhs(_Rhs) {}
+
+  virtual llvm::Value *generate(SPMDBuilder &);
+
+private:
+  SubscriptAst *Lhs;
+  AstNode *Rhs;
+};
+
+/// Run Body for each index in [Start, End), 16 at a time, with the chunks
+/// divided between hardware threads.
+class ForeachAst : public AstNode {
+public:
+  ForeachAst(Symbol *_Index, AstNode *_Start, AstNode *_End, AstNode *_Body)
+      : Index(_Index), Start(_Start), End(_End), Body(_Body) {}
+
+  virtual llvm::Value *generate(SPMDBuilder &);
+  virtual bool markVaryingVariables(bool VaryingControlFlow);
+
+private:
+  Symbol *Index;
+  AstNode *Start;
+  AstNode *End;
+  AstNode *Body;
+};
+
+/// Call another SPMD function.
+class CallAst : public AstNode {
+public:
+  CallAst(FunctionDef *_Func, const std::vector<AstNode *> &_Args)
+      : Func(_Func), Args(_Args) {}
+
+  virtual llvm::Value *generate(SPMDBuilder &);
+  virtual ValueType getType() const { return Func->ReturnType; }
+
+private:
+  FunctionDef *Func;
+  std::vector<AstNode *> Args;
 };
 
 class ConstantAst : public AstNode {
 public:
-  ConstantAst(float _Value) : Value(_Value) {}
+  ConstantAst(double _Value, ValueType _Type) : Value(_Value), Type(_Type) {}
+
+  virtual llvm::Value *generate(SPMDBuilder &);
+  virtual bool isUniform() const { return true; }
+  virtual ValueType getType() const { return Type; }
+
+private:
+  double Value;
+  ValueType Type;
+};
+
+/// &&, || and ! on bools.
+class LogicalAst : public AstNode {
+public:
+  enum Opcode { And, Or, Not };
+
+  LogicalAst(Opcode _Op, AstNode *_Op1, AstNode *_Op2)
+      : Op(_Op), Op1(_Op1), Op2(_Op2) {}
 
   virtual llvm::Value *generate(SPMDBuilder &);
+  virtual bool isUniform() const;
+  virtual ValueType getType() const { return ValueType::Bool; }
 
 private:
-  float Value;
+  Opcode Op;
+  AstNode *Op1;
+  AstNode *Op2;
 };
 
 #endif
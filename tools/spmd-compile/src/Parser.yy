@@ -14,6 +14,12 @@ int yyerror(const char *error);
 int yywrap();
 int yylex();
 Symbol *lookupSymbol(const char *name);
+static Symbol *newSymbol();
+static Symbol *createStructSymbol(const char *Name, StructDef *Type);
+static Function *generateFunction(FunctionDef *Func, AstNode *Body, bool IsMasked);
+static AstNode *createCall(const char *Name, vector<AstNode*> *Args);
+static bool isNumeric(AstNode *Node);
+static bool canAssign(ValueType DestType, AstNode *Value);
 
 int ErrorCount;
 extern int CurrentLine;
@@ -21,8 +27,13 @@ typedef map<string, Symbol*> Scope;
 static vector<Scope> ScopeStack;
 SPMDBuilder *Builder;
 string FunctionName;
-static vector<string> ArgumentNames;
 static vector<Symbol*> ArgumentSyms;
+static vector<Symbol*> FunctionSyms;
+static map<string, FunctionDef*> Functions;
+static map<string, StructDef*> StructTypes;
+static StructDef *CurrentStruct;
+static ValueType CurrentReturnType;
+static int ForeachDepth;
 
 %}
 
@@ -31,6 +42,7 @@ static vector<Symbol*> ArgumentSyms;
 %token TOK_IDENTIFIER
 %token TOK_STRING
 %token TOK_NUMBER
+%token TOK_FLOAT_NUMBER
 %token TOK_IF
 %token TOK_THEN
 %token TOK_ELSE
@@ -40,48 +52,149 @@ static vector<Symbol*> ArgumentSyms;
 %token TOK_EQUALS
 %token TOK_NOT_EQUAL
 %token TOK_FLOAT
+%token TOK_INT
+%token TOK_UINT
+%token TOK_BOOL
+%token TOK_STRUCT
+%token TOK_TRUE
+%token TOK_FALSE
+%token TOK_VOID
 %token TOK_RETURN
 %token TOK_LOGICAL_AND
 %token TOK_LOGICAL_OR
+%token TOK_PROGRAM_INDEX
+%token TOK_FOREACH
+%token TOK_IN
+%token TOK_RANGE
 
 %left TOK_OR
 %left TOK_AND
+%left TOK_LOGICAL_OR
+%left TOK_LOGICAL_AND
+%left TOK_EQUALS TOK_NOT_EQUAL
+%left '<' '>'
 %left TOK_INCR
 %left TOK_DECR
 %left	'+' '-'
 %left 	'*' '/' '%'
+%right '!'
 
 %union {
 	AstNode *node;
 	float numVal;
+	int intVal;
+	ValueType valueType;
+	std::vector<AstNode*> *nodeList;
 	char strval[1024];
 }
 
 %type <node> expr statement stmtseq ifstmt forstmt whilestmt assignstmt
-%type <node> variable vardecl returnstmt
-%type <numVal> TOK_NUMBER
+%type <node> foreachstmt
+%type <node> variable vardecl returnstmt arrayref
+%type <valueType> typename rettype
+%type <node> call
+%type <nodeList> arglist
+%type <intVal> TOK_NUMBER
+%type <numVal> TOK_FLOAT_NUMBER
 %type <strval> TOK_STRING TOK_IDENTIFIER
 
 %%
-module			:		funcdecl
+module			:		decls
 				;
 
-funcdecl		:		TOK_FLOAT TOK_IDENTIFIER enter_scope '(' parameters ')'
-						'{' stmtseq leave_scope '}'
+decls			:		decls decl
+				|		decl
+				;
+
+decl			:		structdecl
+				|		funcdecl
+				;
+
+structdecl		:		TOK_STRUCT TOK_IDENTIFIER '{'
+						{
+							if (StructTypes.count($2))
+							{
+								yyerror("Redeclared struct");
+								YYERROR;
+							}
+
+							CurrentStruct = new StructDef;
+							CurrentStruct->Name = $2;
+							StructTypes[$2] = CurrentStruct;
+						}
+						fieldlist '}' ';'
+				;
+
+fieldlist		:		fieldlist fielddecl
+				|		fielddecl
+				;
+
+fielddecl		:		typename TOK_IDENTIFIER ';'
+						{
+							CurrentStruct->Fields.push_back(make_pair(string($2), $1));
+						}
+				;
+
+typename		:		TOK_FLOAT
+						{
+							$$ = ValueType::Float;
+						}
+				|		TOK_INT
 						{
-							FunctionName = $2;
-							Builder->startFunction($2, ArgumentNames);
-							Function::arg_iterator AI = Builder->getFuncArguments();
+							$$ = ValueType::Int;
+						}
+				|		TOK_UINT
+						{
+							$$ = ValueType::UInt;
+						}
+				|		TOK_BOOL
+						{
+							$$ = ValueType::Bool;
+						}
+				;
+
+rettype			:		typename
+				|		TOK_VOID
+						{
+							$$ = ValueType::Void;
+						}
+				;
+
+funcdecl		:		rettype TOK_IDENTIFIER enter_scope
+						{
+							CurrentReturnType = $1;
+						}
+						'(' parameters ')' '{' stmtseq leave_scope '}'
+						{
+							if (Functions.count($2))
+							{
+								yyerror("Redeclared function");
+								YYERROR;
+							}
+
+							FunctionDef *Func = new FunctionDef;
+							Func->Name = $2;
+							Func->ReturnType = $1;
+							Func->Params = ArgumentSyms;
 							for (auto Sym : ArgumentSyms)
 							{
-								Sym->Val = Builder->createLocalVariable(Sym->Name.c_str(), Builder->sFloatType);
-								Builder->assignLocalVariable(Sym->Val, &*AI);
-								AI++;
+								if (Sym->Struct)
+									Func->ArgSyms.insert(Func->ArgSyms.end(), Sym->Fields.begin(), Sym->Fields.end());
+								else
+									Func->ArgSyms.push_back(Sym);
 							}
 
-							$8->generate(*Builder);
-							Builder->endFunction();
-							ArgumentNames.clear();
+							// Iterate until no more variables become varying,
+							// since each one can make others that depend on it
+							// varying too.
+							while ($9 && $9->markVaryingVariables(false))
+								;
+
+							generateFunction(Func, $9, false);
+							Func->MaskedFunc = generateFunction(Func, $9, true);
+							Functions[$2] = Func;
+							ArgumentSyms.clear();
+							FunctionSyms.clear();
 						}
 				;
 
@@ -93,23 +206,71 @@ paramlist		:		paramlist ',' paramdecl
 				|		paramdecl
 				;
 
-paramdecl		:		TOK_FLOAT TOK_IDENTIFIER
+paramdecl		:		typename TOK_IDENTIFIER
 						{
-							ArgumentNames.push_back($2);
-							Symbol *Sym = new Symbol;
+							Symbol *Sym = newSymbol();
 							Sym->Name = $2;
+							Sym->Type = $1;
+							Sym->IsUniform = false;	// Each lane has its own value
 							ScopeStack.back()[$2] = Sym;
 							ArgumentSyms.push_back(Sym);
 						}
+				|		typename '*' TOK_IDENTIFIER
+						{
+							if ($1 == ValueType::Bool)
+							{
+								yyerror("Arrays of bool are not supported");
+								YYERROR;
+							}
+
+							Symbol *Sym = newSymbol();
+							Sym->Name = $3;
+							Sym->Type = $1;
+							Sym->IsPointer = true;
+							ScopeStack.back()[$3] = Sym;
+							ArgumentSyms.push_back(Sym);
+						}
+				|		typename TOK_IDENTIFIER '[' ']'
+						{
+							if ($1 == ValueType::Bool)
+							{
+								yyerror("Arrays of bool are not supported");
+								YYERROR;
+							}
+
+							Symbol *Sym = newSymbol();
+							Sym->Name = $2;
+							Sym->Type = $1;
+							Sym->IsPointer = true;
+							ScopeStack.back()[$2] = Sym;
+							ArgumentSyms.push_back(Sym);
+						}
+				|		TOK_STRUCT TOK_IDENTIFIER TOK_IDENTIFIER
+						{
+							if (!StructTypes.count($2))
+							{
+								yyerror("Undefined struct");
+								YYERROR;
+							}
+
+							// Each field is passed as a separate argument
+							Symbol *Sym = createStructSymbol($3, StructTypes[$2]);
+							for (auto Field : Sym->Fields)
+								Field->IsUniform = false;
+
+							ArgumentSyms.push_back(Sym);
+						}
 				;
 
 /* Statement types */
 statement		:		ifstmt
 				|		forstmt
+				|		foreachstmt
 				|		whilestmt
 				|		returnstmt ';'
 				|		assignstmt ';'
 				|		vardecl ';'
+				|		call ';'
 				|		'{' enter_scope stmtseq leave_scope '}'
 						{
 							$$ = $3;
@@ -126,45 +287,182 @@ statement		:		ifstmt
 
 returnstmt		:		TOK_RETURN expr
 						{
+							if (ForeachDepth > 0)
+							{
+								yyerror("Return inside foreach");
+								YYERROR;
+							}
+
+							if (!canAssign(CurrentReturnType, $2))
+							{
+								yyerror("Return value has the wrong type");
+								YYERROR;
+							}
+
 							$$ = new ReturnAst($2);
 						}
+				|		TOK_RETURN
+						{
+							if (ForeachDepth > 0)
+							{
+								yyerror("Return inside foreach");
+								YYERROR;
+							}
+
+							if (CurrentReturnType != ValueType::Void)
+							{
+								yyerror("Missing return value");
+								YYERROR;
+							}
+
+							$$ = new ReturnAst(nullptr);
+						}
 
 forstmt			:		TOK_FOR '(' assignstmt ';' expr ';' assignstmt ')' statement
 						{
+							if ($5->getType() != ValueType::Bool)
+							{
+								yyerror("Condition must be a bool");
+								YYERROR;
+							}
+
 							$$ = new ForAst($3, $5, $7, $9);
 						}
 				;
 
+foreachstmt		:		TOK_FOREACH '(' TOK_IDENTIFIER TOK_IN expr TOK_RANGE expr ')'
+						{
+							if (!isNumeric($5) || !isNumeric($7))
+							{
+								yyerror("Invalid range type");
+								YYERROR;
+							}
+
+							if (ForeachDepth > 0)
+							{
+								yyerror("Nested foreach");
+								YYERROR;
+							}
+
+							ForeachDepth++;
+							ScopeStack.push_back(Scope());
+
+							// The index of lane 0, which every lane's index
+							// is relative to.
+							Symbol *Base = newSymbol();
+							Base->Name = string($3) + ".base";
+							Base->Type = ValueType::Int;
+
+							Symbol *Index = newSymbol();
+							Index->Name = $3;
+							Index->Type = ValueType::Int;
+							Index->IsUniform = false;
+							Index->ForeachBase = new VariableAst(Base);
+							ScopeStack.back()[$3] = Index;
+							$<node>$ = new VariableAst(Index);
+						}
+						statement
+						{
+							ScopeStack.pop_back();
+							ForeachDepth--;
+							$$ = new ForeachAst($<node>9->getSymbol(), $5, $7, $10);
+						}
+				;
+
 whilestmt		:		TOK_WHILE '(' expr ')' statement
 						{
+							if ($3->getType() != ValueType::Bool)
+							{
+								yyerror("Condition must be a bool");
+								YYERROR;
+							}
+
 							$$ = new WhileAst($3, $5);
 						}
 
 ifstmt			:		TOK_IF '(' expr ')' statement TOK_ELSE statement
 						{
+							if ($3->getType() != ValueType::Bool)
+							{
+								yyerror("Condition must be a bool");
+								YYERROR;
+							}
+
 							$$ = new IfAst($3, $5, $7);
 						}
 				|		TOK_IF '(' expr ')' statement
 						{
+							if ($3->getType() != ValueType::Bool)
+							{
+								yyerror("Condition must be a bool");
+								YYERROR;
+							}
+
 							$$ = new IfAst($3, $5, nullptr);
 						}
 				;
 
 assignstmt		:		variable '=' expr
 						{
+							if ($1->getSymbol()->ForeachBase)
+							{
+								yyerror("Assignment to foreach variable");
+								YYERROR;
+							}
+
+							if (!canAssign($1->getType(), $3))
+							{
+								yyerror("Assigned value has the wrong type");
+								YYERROR;
+							}
+
 							$$ = new AssignAst($1, $3);
 						}
 				|		variable TOK_INCR
 						{
-							$$ = new AssignAst($1, new AddAst($1, new ConstantAst(1)));
+							if ($1->getSymbol()->ForeachBase)
+							{
+								yyerror("Assignment to foreach variable");
+								YYERROR;
+							}
+
+							if (!isNumeric($1))
+							{
+								yyerror("Invalid operand type");
+								YYERROR;
+							}
+
+							$$ = new AssignAst($1, new AddAst($1, new ConstantAst(1, ValueType::Int)));
 						}
 				|		variable TOK_DECR
 						{
-							$$ = new AssignAst($1, new SubAst($1, new ConstantAst(1)));
+							if ($1->getSymbol()->ForeachBase)
+							{
+								yyerror("Assignment to foreach variable");
+								YYERROR;
+							}
+
+							if (!isNumeric($1))
+							{
+								yyerror("Invalid operand type");
+								YYERROR;
+							}
+
+							$$ = new AssignAst($1, new SubAst($1, new ConstantAst(1, ValueType::Int)));
+						}
+				|		arrayref '=' expr
+						{
+							if (!canAssign($1->getType(), $3))
+							{
+								yyerror("Assigned value has the wrong type");
+								YYERROR;
+							}
+
+							$$ = new StoreAst(static_cast<SubscriptAst*>($1), $3);
 						}
 				;
 
-vardecl			:		TOK_FLOAT TOK_IDENTIFIER
+vardecl			:		typename TOK_IDENTIFIER
 						{
 							if (lookupSymbol($2))
 							{
@@ -173,29 +471,55 @@ vardecl			:		TOK_FLOAT TOK_IDENTIFIER
 							}
 							else
 							{
-								Symbol *Sym = new Symbol;
+								Symbol *Sym = newSymbol();
 								Sym->Val = nullptr;	// will be filled in later
+								Sym->Name = $2;
+								Sym->Type = $1;
 								ScopeStack.back()[$2] = Sym;
 							}
 
 							$$ = nullptr;
 						}
-				|		TOK_FLOAT TOK_IDENTIFIER '=' expr
+				|		typename TOK_IDENTIFIER '=' expr
 						{
 							if (lookupSymbol($2))
 							{
 								yyerror("Redeclared symbol");
 								YYERROR;
 							}
+							else if (!canAssign($1, $4))
+							{
+								yyerror("Assigned value has the wrong type");
+								YYERROR;
+							}
 							else
 							{
-								Symbol *Sym = new Symbol;
+								Symbol *Sym = newSymbol();
 								Sym->Val = nullptr;	// will be filled in later
+								Sym->Name = $2;
+								Sym->Type = $1;
 								AstNode *Var = new VariableAst(Sym);
 								ScopeStack.back()[$2] = Sym;
 								$$ = new AssignAst(Var, $4);
 							}
 						}
+				|		TOK_STRUCT TOK_IDENTIFIER TOK_IDENTIFIER
+						{
+							if (!StructTypes.count($2))
+							{
+								yyerror("Undefined struct");
+								YYERROR;
+							}
+
+							if (lookupSymbol($3))
+							{
+								yyerror("Redeclared symbol");
+								YYERROR;
+							}
+
+							createStructSymbol($3, StructTypes[$2]);
+							$$ = nullptr;
+						}
 				;
 
 
@@ -220,45 +544,167 @@ stmtseq			:		statement stmtseq
 
 expr			:		expr '>' expr
 						{
+							if (!isNumeric($1) || !isNumeric($3))
+							{
+								yyerror("Invalid operand types");
+								YYERROR;
+							}
+
 							$$ = new CompareAst(CmpInst::FCMP_UGT, $1, $3);
 						}
 				|		expr '<' expr
 						{
+							if (!isNumeric($1) || !isNumeric($3))
+							{
+								yyerror("Invalid operand types");
+								YYERROR;
+							}
+
 							$$ = new CompareAst(CmpInst::FCMP_ULT, $1, $3);
 						}
 				|		expr TOK_EQUALS expr
 						{
+							if (!isNumeric($1) || !isNumeric($3))
+							{
+								yyerror("Invalid operand types");
+								YYERROR;
+							}
+
 							$$ = new CompareAst(CmpInst::FCMP_UEQ, $1, $3);
 						}
 				|		expr TOK_NOT_EQUAL expr
 						{
+							if (!isNumeric($1) || !isNumeric($3))
+							{
+								yyerror("Invalid operand types");
+								YYERROR;
+							}
+
 							$$ = new CompareAst(CmpInst::FCMP_UNE, $1, $3);
 						}
 				|		expr '+' expr
 						{
+							if (!isNumeric($1) || !isNumeric($3))
+							{
+								yyerror("Invalid operand types");
+								YYERROR;
+							}
+
 							$$ = new AddAst($1, $3);
 						}
 				|		expr '-' expr
 						{
+							if (!isNumeric($1) || !isNumeric($3))
+							{
+								yyerror("Invalid operand types");
+								YYERROR;
+							}
+
 							$$ = new SubAst($1, $3);
 						}
 				|		expr '*' expr
 						{
+							if (!isNumeric($1) || !isNumeric($3))
+							{
+								yyerror("Invalid operand types");
+								YYERROR;
+							}
+
 							$$ = new MulAst($1, $3);
 						}
 				|		expr '/' expr
 						{
+							if (!isNumeric($1) || !isNumeric($3))
+							{
+								yyerror("Invalid operand types");
+								YYERROR;
+							}
+
 							$$ = new DivAst($1, $3);
 						}
+				|		expr TOK_LOGICAL_AND expr
+						{
+							if ($1->getType() != ValueType::Bool || $3->getType() != ValueType::Bool)
+							{
+								yyerror("Invalid operand types");
+								YYERROR;
+							}
+
+							$$ = new LogicalAst(LogicalAst::And, $1, $3);
+						}
+				|		expr TOK_LOGICAL_OR expr
+						{
+							if ($1->getType() != ValueType::Bool || $3->getType() != ValueType::Bool)
+							{
+								yyerror("Invalid operand types");
+								YYERROR;
+							}
+
+							$$ = new LogicalAst(LogicalAst::Or, $1, $3);
+						}
+				|		'!' expr
+						{
+							if ($2->getType() != ValueType::Bool)
+							{
+								yyerror("Invalid operand type");
+								YYERROR;
+							}
+
+							$$ = new LogicalAst(LogicalAst::Not, $2, nullptr);
+						}
 				|		'(' expr ')'
 						{
 							$$ = $2;
 						}
 				|		TOK_NUMBER
 						{
-							$$ = new ConstantAst($1);
+							$$ = new ConstantAst($1, ValueType::Int);
+						}
+				|		TOK_FLOAT_NUMBER
+						{
+							$$ = new ConstantAst($1, ValueType::Float);
+						}
+				|		TOK_TRUE
+						{
+							$$ = new ConstantAst(1, ValueType::Bool);
+						}
+				|		TOK_FALSE
+						{
+							$$ = new ConstantAst(0, ValueType::Bool);
+						}
+				|		TOK_PROGRAM_INDEX
+						{
+							$$ = new ProgramIndexAst;
 						}
 				|		variable
+				|		arrayref
+				|		call
+				;
+
+call			:		TOK_IDENTIFIER '(' arglist ')'
+						{
+							$$ = createCall($1, $3);
+							if ($$ == nullptr)
+								YYERROR;
+						}
+				|		TOK_IDENTIFIER '(' ')'
+						{
+							$$ = createCall($1, new vector<AstNode*>);
+							if ($$ == nullptr)
+								YYERROR;
+						}
+				;
+
+arglist			:		arglist ',' expr
+						{
+							$1->push_back($3);
+							$$ = $1;
+						}
+				|		expr
+						{
+							$$ = new vector<AstNode*>;
+							$$->push_back($1);
+						}
 				;
 
 variable		:		TOK_IDENTIFIER
@@ -270,8 +716,66 @@ variable		:		TOK_IDENTIFIER
 								YYERROR;
 							}
 
+							// Whole arrays and structs can be passed to functions.
+							// Any other use is rejected because they don't have a
+							// value type.
 							$$ = new VariableAst(Sym);
 						}
+				|		TOK_IDENTIFIER '.' TOK_IDENTIFIER
+						{
+							Symbol *Sym = lookupSymbol($1);
+							if (Sym == nullptr)
+							{
+								yyerror("Undefined variable");
+								YYERROR;
+							}
+
+							if (!Sym->Struct)
+							{
+								yyerror("Field access on a value that is not a struct");
+								YYERROR;
+							}
+
+							Symbol *FieldSym = nullptr;
+							for (unsigned i = 0; i < Sym->Fields.size(); i++)
+							{
+								if (Sym->Struct->Fields[i].first == $3)
+									FieldSym = Sym->Fields[i];
+							}
+
+							if (FieldSym == nullptr)
+							{
+								yyerror("Undefined field");
+								YYERROR;
+							}
+
+							$$ = new VariableAst(FieldSym);
+						}
+				;
+
+arrayref		:		TOK_IDENTIFIER '[' expr ']'
+						{
+							Symbol *Sym = lookupSymbol($1);
+							if (Sym == nullptr)
+							{
+								yyerror("Undefined variable");
+								YYERROR;
+							}
+
+							if (!Sym->IsPointer)
+							{
+								yyerror("Subscripted value is not an array");
+								YYERROR;
+							}
+
+							if (!isNumeric($3))
+							{
+								yyerror("Invalid index type");
+								YYERROR;
+							}
+
+							$$ = new SubscriptAst(Sym, $3);
+						}
 				;
 
 %%
@@ -306,3 +810,120 @@ Symbol *lookupSymbol(const char *name)
 
 	return nullptr;
 }
+
+// All symbols in the current function are tracked so their storage can be
+// reset before the function is generated again.
+static Symbol *newSymbol()
+{
+	Symbol *Sym = new Symbol;
+	FunctionSyms.push_back(Sym);
+	return Sym;
+}
+
+static Symbol *createStructSymbol(const char *Name, StructDef *Type)
+{
+	Symbol *Sym = newSymbol();
+	Sym->Name = Name;
+	Sym->Struct = Type;
+	for (auto &Field : Type->Fields)
+	{
+		Symbol *FieldSym = newSymbol();
+		FieldSym->Name = string(Name) + "." + Field.first;
+		FieldSym->Type = Field.second;
+		Sym->Fields.push_back(FieldSym);
+	}
+
+	ScopeStack.back()[Name] = Sym;
+	return Sym;
+}
+
+static bool isNumeric(AstNode *Node)
+{
+	ValueType Type = Node->getType();
+	return Type == ValueType::Float || Type == ValueType::Int
+		|| Type == ValueType::UInt;
+}
+
+// Numeric types are converted implicitly, but bools can only be assigned
+// to bools.
+static bool canAssign(ValueType DestType, AstNode *Value)
+{
+	if (DestType == ValueType::Void)
+		return false;
+
+	if (DestType == ValueType::Bool)
+		return Value->getType() == ValueType::Bool;
+
+	return isNumeric(Value);
+}
+
+static Function *generateFunction(FunctionDef *Func, AstNode *Body, bool IsMasked)
+{
+	for (auto Sym : FunctionSyms)
+	{
+		if (!Sym->Struct)
+			Sym->Val = nullptr;
+	}
+
+	Function *F = Builder->startFunction(Func->Name.c_str(), Func->ReturnType,
+		Func->ArgSyms, IsMasked);
+	Function::arg_iterator AI = Builder->getFuncArguments();
+	for (auto Sym : Func->ArgSyms)
+	{
+		if (Sym->IsPointer)
+			Sym->Val = &*AI;
+		else
+		{
+			Sym->Val = Builder->createLocalVariable(Sym->Name.c_str(), Sym->Type);
+			Builder->assignLocalVariable(Sym->Val, &*AI, Sym->Type);
+		}
+
+		AI++;
+	}
+
+	if (Body)
+		Body->generate(*Builder);
+
+	Builder->endFunction();
+	return F;
+}
+
+static AstNode *createCall(const char *Name, vector<AstNode*> *Args)
+{
+	auto FuncIt = Functions.find(Name);
+	if (FuncIt == Functions.end())
+	{
+		yyerror("Undefined function");
+		return nullptr;
+	}
+
+	FunctionDef *Func = FuncIt->second;
+	if (Args->size() != Func->Params.size())
+	{
+		yyerror("Wrong number of arguments");
+		return nullptr;
+	}
+
+	for (unsigned i = 0; i < Args->size(); i++)
+	{
+		Symbol *Param = Func->Params[i];
+		Symbol *ArgSym = (*Args)[i]->getSymbol();
+		bool Valid;
+		if (Param->IsPointer)
+			Valid = ArgSym && ArgSym->IsPointer && ArgSym->Type == Param->Type;
+		else if (Param->Struct)
+			Valid = ArgSym && ArgSym->Struct == Param->Struct;
+		else
+			Valid = canAssign(Param->Type, (*Args)[i]);
+
+		if (!Valid)
+		{
+			yyerror("Argument has the wrong type");
+			return nullptr;
+		}
+	}
+
+	AstNode *Call = new CallAst(Func, *Args);
+	delete Args;
+	return Call;
+}
@@ -1,65 +1,136 @@
 #include "SPMDBuilder.h"
 #include "llvm/IR/Intrinsics.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 
 using namespace llvm;
 
+// Every thread with an ID below this must run a kernel with a foreach loop,
+// and no others may.
+static cl::opt<unsigned> NumThreads(
+    "threads",
+    cl::desc("Number of hardware threads that run kernels with foreach loops"),
+    cl::init(4));
+
 SPMDBuilder::SPMDBuilder(Module *Mod, LLVMContext &_Context)
     : Context(_Context), Builder(_Context), MainModule(Mod), CurrentFunction(nullptr) {
   VMixFInt = llvm::Intrinsic::getDeclaration(
       MainModule, (llvm::Intrinsic::ID)Intrinsic::nyuzi_vector_mixf, None);
-  sFloatType = Type::getFloatTy(Context);
+  VMixIInt = llvm::Intrinsic::getDeclaration(
+      MainModule, (llvm::Intrinsic::ID)Intrinsic::nyuzi_vector_mixi, None);
 }
 
 SPMDBuilder::~SPMDBuilder() {}
 
-void SPMDBuilder::startFunction(const char *Name,
-                                const std::vector<std::string> &ArgNames) {
-  Type *VecF = VectorType::get(sFloatType, 16);
-  std::vector<Type *> Params(ArgNames.size(), VecF);
-  FunctionType *FT = FunctionType::get(VecF, Params, false);
-  CurrentFunction = Function::Create(FT, Function::ExternalLinkage, Name,
-    MainModule);
+Function *SPMDBuilder::startFunction(const char *Name, ValueType _ReturnType,
+                                     const std::vector<Symbol *> &Args,
+                                     bool IsMasked) {
+  std::vector<Type *> Params;
+  if (IsMasked)
+    Params.push_back(Builder.getInt32Ty());
+
+  for (auto Arg : Args) {
+    // Pointers are shared by all lanes.
+    if (Arg->IsPointer)
+      Params.push_back(PointerType::getUnqual(getLLVMType(Arg->Type, true)));
+    else
+      Params.push_back(getLLVMType(Arg->Type, false));
+  }
+
+  ReturnType = _ReturnType;
+  FunctionType *FT =
+      FunctionType::get(getLLVMType(ReturnType, false), Params, false);
+  if (IsMasked)
+    CurrentFunction = Function::Create(FT, Function::InternalLinkage,
+      std::string(Name) + ".masked", MainModule);
+  else
+    CurrentFunction = Function::Create(FT, Function::ExternalLinkage, Name,
+      MainModule);
 
   BasicBlock *EntryBB = BasicBlock::Create(Context, "entry",
     CurrentFunction);
   startBasicBlock(EntryBB);
 
-  unsigned Idx = 0;
-  for (Function::arg_iterator AI = CurrentFunction->arg_begin();
-       Idx != ArgNames.size(); ++AI, ++Idx) {
-    AI->setName(ArgNames[Idx]);
+  Function::arg_iterator AI = CurrentFunction->arg_begin();
+  Value *CallerMask = nullptr;
+  if (IsMasked) {
+    CallerMask = &*AI++;
+    CallerMask->setName("mask");
   }
 
-  ReturnValuePtr = createLocalVariable("return_value", sFloatType);
+  for (unsigned Idx = 0; Idx != Args.size(); ++AI, ++Idx)
+    AI->setName(Args[Idx]->Name);
+
+  if (ReturnType != ValueType::Void)
+    ReturnValuePtr = createLocalVariable("return_value", ReturnType);
+  else
+    ReturnValuePtr = nullptr;
 
   // ReturnMask indicates which lanes have returned values. Each bit is
   // 1 if the lane is still active (hasn't returned) and 0 if it has returned.
+  // Lanes that weren't active in the caller start out as returned, so
+  // returns in this function only need to wait for the caller's lanes.
   ReturnMaskPtr = Builder.CreateAlloca(Type::getInt32Ty(Context), 0, "return_mask");
-  Builder.CreateStore(ConstantInt::get(Type::getInt32Ty(Context), 0xffffLL), ReturnMaskPtr);
+  if (IsMasked) {
+    Builder.CreateStore(CallerMask, ReturnMaskPtr);
+    ActiveLanes = CallerMask;
+  } else {
+    Builder.CreateStore(ConstantInt::get(Type::getInt32Ty(Context), 0xffffLL), ReturnMaskPtr);
+    ActiveLanes = nullptr;
+  }
 
-  ActiveLanes = nullptr;
+  IsMaskedFunction = IsMasked;
+  return CurrentFunction;
 }
 
 void SPMDBuilder::endFunction() {
   assert(MaskStack.empty());
 
-  // XXX this is either redundant, or creates an implicit return value.
-  // Probably not the right thing to do.
-//  Builder.CreateRet(readLocalVariable(ReturnValuePtr));
+  // A return at the top level leaves an empty block behind it (and a
+  // function may not return on all paths). Terminate it.
+  if (!Builder.GetInsertBlock()->getTerminator())
+    emitRet();
+
+  // Calls are made with the active mask in a scalar register, but every live
+  // vector register in the caller must be spilled around them. That costs
+  // more than a small function body, so always inline those.
+  if (IsMaskedFunction) {
+    unsigned Size = 0;
+    for (auto &BB : *CurrentFunction)
+      Size += BB.size();
+
+    if (Size <= kMaxInlineSize)
+      CurrentFunction->addFnAttr(Attribute::AlwaysInline);
+  }
 }
 
 llvm::Function::arg_iterator SPMDBuilder::getFuncArguments() {
-  return CurrentFunction->arg_begin();
+  Function::arg_iterator AI = CurrentFunction->arg_begin();
+  if (IsMaskedFunction)
+    ++AI; // Skip mask
+
+  return AI;
+}
+
+void SPMDBuilder::emitRet() {
+  if (ReturnValuePtr)
+    Builder.CreateRet(readLocalVariable(ReturnValuePtr));
+  else
+    Builder.CreateRetVoid();
 }
 
 void SPMDBuilder::createReturn(llvm::Value *ReturnValue) {
-  assignLocalVariable(ReturnValuePtr, ReturnValue);
+  if (ReturnValue)
+    assignLocalVariable(ReturnValuePtr, ReturnValue, ReturnType);
+
   if (MaskStack.empty()) {
     // All lanes are returning because this isn't predicated.
     // Jump directly to end
-    Builder.CreateRet(readLocalVariable(ReturnValuePtr));
+    emitRet();
+
+    // Any following code is unreachable, but still needs a block to go in.
+    startBasicBlock(createBasicBlock("afterreturn"));
   } else {
     assert(ActiveLanes);
 
@@ -77,7 +148,7 @@ void SPMDBuilder::createReturn(llvm::Value *ReturnValue) {
     llvm::BasicBlock *ReturnBlock = createBasicBlock("doreturn");
     Builder.CreateCondBr(ExitCond, ReturnBlock, NextBlock);
     startBasicBlock(ReturnBlock);
-    Builder.CreateRet(readLocalVariable(ReturnValuePtr));
+    emitRet();
 
     // All lanes haven't exited yet
     startBasicBlock(NextBlock);
@@ -90,8 +161,182 @@ void SPMDBuilder::createReturn(llvm::Value *ReturnValue) {
   }
 }
 
-llvm::Value *SPMDBuilder::createLocalVariable(const char *Name, Type *Type) {
-  return Builder.CreateAlloca(VectorType::get(Type, 16), 0, Name);
+void SPMDBuilder::startForeach(Value *Start, Value *End, Value *IndexPtr,
+                               Value *BasePtr) {
+  assert(!ForeachTopBB && "foreach loops can't be nested");
+
+  // The range is expected to be the same in all lanes.
+  if (Start->getType()->isVectorTy())
+    Start = Builder.CreateExtractElement(Start, Builder.getInt32(0));
+
+  if (End->getType()->isVectorTy())
+    End = Builder.CreateExtractElement(End, Builder.getInt32(0));
+
+  // Shared by all threads. The last thread to finish the loop resets the
+  // counters, then advances the generation to release the others, so the
+  // kernel can be run again.
+  ForeachNextChunk = new GlobalVariable(
+      *MainModule, Builder.getInt32Ty(), false, GlobalValue::InternalLinkage,
+      Builder.getInt32(0), "foreach.next");
+  ForeachFinished = new GlobalVariable(
+      *MainModule, Builder.getInt32Ty(), false, GlobalValue::InternalLinkage,
+      Builder.getInt32(0), "foreach.finished");
+  ForeachGeneration = new GlobalVariable(
+      *MainModule, Builder.getInt32Ty(), false, GlobalValue::InternalLinkage,
+      Builder.getInt32(0), "foreach.generation");
+
+  // Control register 0 is the thread ID. Each thread starts with its own
+  // chunk so they don't all contend for the counter at once. The hardware
+  // can't report how many threads are running, so a thread outside the
+  // expected range stops here. A missing thread can't be detected: its
+  // chunk would be skipped and the others would wait for it forever.
+  Function *ReadControlReg =
+      Intrinsic::getDeclaration(MainModule, Intrinsic::nyuzi_read_control_reg);
+  Value *ThreadId =
+      Builder.CreateCall(ReadControlReg, Builder.getInt32(0), "thread_id");
+  BasicBlock *BadThreadBB = createBasicBlock("foreachbadthread");
+  BasicBlock *StartBB = createBasicBlock("foreachstart");
+  conditionalBranch(
+      Builder.CreateICmpUGE(ThreadId, Builder.getInt32(NumThreads)),
+      BadThreadBB, StartBB);
+  startBasicBlock(BadThreadBB);
+  Builder.CreateCall(Intrinsic::getDeclaration(MainModule, Intrinsic::trap));
+  Builder.CreateUnreachable();
+
+  startBasicBlock(StartBB);
+  ForeachChunkPtr = Builder.CreateAlloca(Builder.getInt32Ty(), 0, "chunk");
+  Builder.CreateStore(ThreadId, ForeachChunkPtr);
+
+  ForeachTopBB = createBasicBlock("foreachtop");
+  BasicBlock *BodyBB = createBasicBlock("foreachbody");
+  ForeachDoneBB = createBasicBlock("foreachdone");
+  branch(ForeachTopBB);
+  startBasicBlock(ForeachTopBB);
+  Value *Chunk = Builder.CreateLoad(ForeachChunkPtr);
+  Value *Base = Builder.CreateAdd(Start, Builder.CreateShl(Chunk, 4), "base");
+  conditionalBranch(Builder.CreateICmpSLT(Base, End), BodyBB, ForeachDoneBB);
+
+  startBasicBlock(BodyBB);
+  Builder.CreateStore(Base, BasePtr);
+  Value *Index = Builder.CreateAdd(Builder.CreateVectorSplat(16, Base),
+                                   createProgramIndex(), "index");
+  Builder.CreateStore(Index, IndexPtr);
+
+  // Mask off the lanes past the end in the last chunk.
+  pushMask(createCompare(CmpInst::ICMP_SLT, Index,
+                         Builder.CreateVectorSplat(16, End)));
+}
+
+void SPMDBuilder::endForeach() {
+  assert(ForeachTopBB);
+  popMask();
+
+  // Chunks below NumThreads were taken by thread ID. The counter hands out
+  // the rest. It only hands out work; the generation orders it against the
+  // reset, so this doesn't need to be stronger than monotonic.
+  Value *Ticket = Builder.CreateAtomicRMW(AtomicRMWInst::Add, ForeachNextChunk,
+                                          Builder.getInt32(1),
+                                          AtomicOrdering::Monotonic);
+  Builder.CreateStore(Builder.CreateAdd(Ticket, Builder.getInt32(NumThreads)),
+                      ForeachChunkPtr);
+  branch(ForeachTopBB);
+
+  // Wait for all threads to finish, like a barrier. The generation must be
+  // read before this thread is counted, otherwise the last thread could
+  // advance it first and this one would wait for the next run. Counting is
+  // acquire/release, so the last thread sees the other threads' stores.
+  startBasicBlock(ForeachDoneBB);
+  LoadInst *Generation = Builder.CreateLoad(ForeachGeneration, "generation");
+  Generation->setAtomic(AtomicOrdering::Acquire);
+  Generation->setAlignment(4);
+  Value *Finished = Builder.CreateAtomicRMW(
+      AtomicRMWInst::Add, ForeachFinished, Builder.getInt32(1),
+      AtomicOrdering::AcquireRelease);
+  BasicBlock *ResetBB = createBasicBlock("foreachreset");
+  BasicBlock *WaitBB = createBasicBlock("foreachwait");
+  BasicBlock *ContinueBB = createBasicBlock("foreachend");
+  conditionalBranch(
+      Builder.CreateICmpEQ(Finished, Builder.getInt32(NumThreads - 1)),
+      ResetBB, WaitBB);
+
+  // No other thread touches the counters until the new generation is
+  // released.
+  startBasicBlock(ResetBB);
+  StoreInst *ResetNext =
+      Builder.CreateStore(Builder.getInt32(0), ForeachNextChunk);
+  ResetNext->setAtomic(AtomicOrdering::Monotonic);
+  ResetNext->setAlignment(4);
+  StoreInst *ResetFinished =
+      Builder.CreateStore(Builder.getInt32(0), ForeachFinished);
+  ResetFinished->setAtomic(AtomicOrdering::Monotonic);
+  ResetFinished->setAlignment(4);
+  StoreInst *Release = Builder.CreateStore(
+      Builder.CreateAdd(Generation, Builder.getInt32(1)), ForeachGeneration);
+  Release->setAtomic(AtomicOrdering::Release);
+  Release->setAlignment(4);
+  branch(ContinueBB);
+
+  startBasicBlock(WaitBB);
+  LoadInst *Current = Builder.CreateLoad(ForeachGeneration);
+  Current->setAtomic(AtomicOrdering::Acquire);
+  Current->setAlignment(4);
+  conditionalBranch(Builder.CreateICmpEQ(Current, Generation), WaitBB,
+                    ContinueBB);
+
+  startBasicBlock(ContinueBB);
+
+  ForeachTopBB = nullptr;
+  ForeachDoneBB = nullptr;
+}
+
+Value *SPMDBuilder::createCall(FunctionDef *Func, ArrayRef<Value *> Args) {
+  assert(Args.size() == Func->ArgSyms.size());
+  SmallVector<Value *, 8> CallArgs;
+  CallArgs.push_back(getActiveMask());
+  for (unsigned Idx = 0; Idx < Args.size(); Idx++) {
+    Symbol *Param = Func->ArgSyms[Idx];
+    if (Param->IsPointer)
+      CallArgs.push_back(Args[Idx]);
+    else if (Param->Type == ValueType::Bool)
+      CallArgs.push_back(promoteToMask(Args[Idx]));
+    else
+      CallArgs.push_back(promoteToVector(Args[Idx]));
+  }
+
+  return Builder.CreateCall(Func->MaskedFunc, CallArgs);
+}
+
+Type *SPMDBuilder::getLLVMType(ValueType Type, bool IsUniform) {
+  llvm::Type *ElementType;
+  switch (Type) {
+  case ValueType::Void:
+    return Builder.getVoidTy();
+
+  case ValueType::Float:
+    ElementType = Builder.getFloatTy();
+    break;
+
+  case ValueType::Int:
+  case ValueType::UInt:
+    ElementType = Builder.getInt32Ty();
+    break;
+
+  case ValueType::Bool:
+    return IsUniform ? Builder.getInt1Ty() : Builder.getInt32Ty();
+
+  default:
+    llvm_unreachable("Value has no storage type");
+  }
+
+  if (IsUniform)
+    return ElementType;
+
+  return VectorType::get(ElementType, 16);
+}
+
+llvm::Value *SPMDBuilder::createLocalVariable(const char *Name, ValueType Type,
+                                              bool IsUniform) {
+  return Builder.CreateAlloca(getLLVMType(Type, IsUniform), 0, Name);
 }
 
 llvm::Value *SPMDBuilder::readLocalVariable(llvm::Value *VariablePtr) {
@@ -99,15 +344,41 @@ llvm::Value *SPMDBuilder::readLocalVariable(llvm::Value *VariablePtr) {
 }
 
 llvm::Value *SPMDBuilder::assignLocalVariable(Value *VariablePtr,
-                                              Value *NewValue) {
+                                              Value *NewValue,
+                                              ValueType Type) {
   assert(VariablePtr);
   assert(NewValue);
 
+  // Uniform variables are never assigned under a varying mask, so there is
+  // no need to preserve inactive lanes.
+  bool IsUniform = cast<AllocaInst>(VariablePtr)->getAllocatedType() ==
+                   getLLVMType(Type, true);
+  if (IsUniform) {
+    Builder.CreateStore(NewValue, VariablePtr);
+    return NewValue;
+  }
+
+  if (Type == ValueType::Bool) {
+    // Each bit in the mask is a lane.
+    NewValue = promoteToMask(NewValue);
+    if (ActiveLanes) {
+      Value *OldValue = Builder.CreateLoad(VariablePtr);
+      Value *InactiveLanes = Builder.CreateNot(ActiveLanes);
+      NewValue = Builder.CreateOr(Builder.CreateAnd(NewValue, ActiveLanes),
+                                  Builder.CreateAnd(OldValue, InactiveLanes));
+    }
+
+    Builder.CreateStore(NewValue, VariablePtr);
+    return NewValue;
+  }
+
+  NewValue = promoteToVector(NewValue);
   if (ActiveLanes) {
     // Need to predicate this instruction
     Value *OldValue = Builder.CreateLoad(VariablePtr);
     Value *Ops[] = {ActiveLanes, NewValue, OldValue};
-    Value *Blended = Builder.CreateCall(VMixFInt, Ops);
+    Function *MixFunc = Type == ValueType::Float ? VMixFInt : VMixIInt;
+    Value *Blended = Builder.CreateCall(MixFunc, Ops);
     Builder.CreateStore(Blended, VariablePtr);
   } else {
     assert(MaskStack.empty());
@@ -174,6 +445,27 @@ void SPMDBuilder::invertLastPushedMask() {
   MaskStack.push_back(NewTop);
 }
 
+SPMDBuilder::MaskState SPMDBuilder::saveMaskState() const {
+  MaskState State = {ActiveLanes, MaskStack.size()};
+  return State;
+}
+
+void SPMDBuilder::restoreMaskState(const MaskState &State,
+                                   bool LanesMayHaveReturned) {
+  assert(MaskStack.size() == State.Depth);
+
+  if (!LanesMayHaveReturned)
+    ActiveLanes = State.ActiveLanes;
+  else if (State.ActiveLanes)
+    ActiveLanes = Builder.CreateAnd(State.ActiveLanes,
+                                    Builder.CreateLoad(ReturnMaskPtr));
+  else
+    ActiveLanes = Builder.CreateLoad(ReturnMaskPtr);
+
+  if (!MaskStack.empty())
+    MaskStack.back().CombinedMask = ActiveLanes;
+}
+
 void SPMDBuilder::shortCircuitZeroMask(llvm::BasicBlock *SkipTo,
                                        llvm::BasicBlock *Next) {
   assert(!MaskStack.empty());
@@ -186,8 +478,65 @@ void SPMDBuilder::shortCircuitZeroMask(llvm::BasicBlock *SkipTo,
 
 void SPMDBuilder::branch(llvm::BasicBlock *Dest) { Builder.CreateBr(Dest); }
 
+void SPMDBuilder::conditionalBranch(llvm::Value *Cond, llvm::BasicBlock *True,
+                                    llvm::BasicBlock *False) {
+  assert(Cond->getType()->isIntegerTy(1));
+  Builder.CreateCondBr(Cond, True, False);
+}
+
+Value *SPMDBuilder::promoteToVector(Value *Val) {
+  if (Val->getType()->isVectorTy())
+    return Val;
+
+  return Builder.CreateVectorSplat(16, Val);
+}
+
+Value *SPMDBuilder::promoteToMask(Value *Val) {
+  if (!Val->getType()->isIntegerTy(1))
+    return Val;
+
+  return Builder.CreateSelect(Val, Builder.getInt32(0xffff),
+                              Builder.getInt32(0));
+}
+
+Value *SPMDBuilder::convert(Value *Val, ValueType From, ValueType To) {
+  if (From == To)
+    return Val;
+
+  assert(From != ValueType::Bool && To != ValueType::Bool &&
+         "bool can't be converted");
+  bool IsUniform = !Val->getType()->isVectorTy();
+  Type *DestType = getLLVMType(To, IsUniform);
+  if (From == ValueType::Float)
+    return To == ValueType::Int ? Builder.CreateFPToSI(Val, DestType)
+                                : Builder.CreateFPToUI(Val, DestType);
+
+  if (To == ValueType::Float)
+    return From == ValueType::Int ? Builder.CreateSIToFP(Val, DestType)
+                                  : Builder.CreateUIToFP(Val, DestType);
+
+  // int <-> uint is just a reinterpretation.
+  return Val;
+}
+
+void SPMDBuilder::matchOperands(Value *&Lhs, Value *&Rhs) {
+  if (Lhs->getType()->isVectorTy() != Rhs->getType()->isVectorTy()) {
+    Lhs = promoteToVector(Lhs);
+    Rhs = promoteToVector(Rhs);
+  }
+}
+
 Value *SPMDBuilder::createCompare(CmpInst::Predicate Type, Value *lhs,
                                   Value *rhs) {
+  // Comparing two uniform values yields a scalar condition.
+  if (!lhs->getType()->isVectorTy() && !rhs->getType()->isVectorTy()) {
+    if (CmpInst::isFPPredicate(Type))
+      return Builder.CreateFCmp(Type, lhs, rhs, "cond");
+
+    return Builder.CreateICmp(Type, lhs, rhs, "cond");
+  }
+
+  matchOperands(lhs, rhs);
   unsigned IntrinsicId;
   switch (Type) {
   case CmpInst::FCMP_OEQ:
@@ -233,7 +582,7 @@ Value *SPMDBuilder::createCompare(CmpInst::Predicate Type, Value *lhs,
     break;
 
   case CmpInst::ICMP_UGE:
-    IntrinsicId = Intrinsic::nyuzi_mask_cmpi_ugt;
+    IntrinsicId = Intrinsic::nyuzi_mask_cmpi_uge;
     break;
 
   case CmpInst::ICMP_ULT:
@@ -275,19 +624,68 @@ Value *SPMDBuilder::createCompare(CmpInst::Predicate Type, Value *lhs,
 }
 
 Value *SPMDBuilder::createSub(Value *Lhs, Value *Rhs) {
-  return Builder.CreateFSub(Lhs, Rhs);
+  matchOperands(Lhs, Rhs);
+  if (Lhs->getType()->isFPOrFPVectorTy())
+    return Builder.CreateFSub(Lhs, Rhs);
+
+  return Builder.CreateSub(Lhs, Rhs);
 }
 
 Value *SPMDBuilder::createAdd(Value *Lhs, Value *Rhs) {
-  return Builder.CreateFAdd(Lhs, Rhs);
+  matchOperands(Lhs, Rhs);
+  if (Lhs->getType()->isFPOrFPVectorTy())
+    return Builder.CreateFAdd(Lhs, Rhs);
+
+  return Builder.CreateAdd(Lhs, Rhs);
 }
 
 Value *SPMDBuilder::createMul(Value *Lhs, Value *Rhs) {
-  return Builder.CreateFMul(Lhs, Rhs);
+  matchOperands(Lhs, Rhs);
+  if (Lhs->getType()->isFPOrFPVectorTy())
+    return Builder.CreateFMul(Lhs, Rhs);
+
+  return Builder.CreateMul(Lhs, Rhs);
+}
+
+Value *SPMDBuilder::createDiv(Value *Lhs, Value *Rhs, ValueType Type) {
+  matchOperands(Lhs, Rhs);
+  switch (Type) {
+  case ValueType::Float:
+    return Builder.CreateFDiv(Lhs, Rhs);
+  case ValueType::Int:
+    return Builder.CreateSDiv(Lhs, Rhs);
+  case ValueType::UInt:
+    return Builder.CreateUDiv(Lhs, Rhs);
+  default:
+    llvm_unreachable("Invalid type for divide");
+  }
 }
 
-Value *SPMDBuilder::createDiv(Value *Lhs, Value *Rhs) {
-  return Builder.CreateFDiv(Lhs, Rhs);
+// Uniform bools are i1s and varying ones are masks. If one operand is
+// varying, the result is too.
+Value *SPMDBuilder::createAnd(Value *Lhs, Value *Rhs) {
+  if (Lhs->getType() != Rhs->getType()) {
+    Lhs = promoteToMask(Lhs);
+    Rhs = promoteToMask(Rhs);
+  }
+
+  return Builder.CreateAnd(Lhs, Rhs);
+}
+
+Value *SPMDBuilder::createOr(Value *Lhs, Value *Rhs) {
+  if (Lhs->getType() != Rhs->getType()) {
+    Lhs = promoteToMask(Lhs);
+    Rhs = promoteToMask(Rhs);
+  }
+
+  return Builder.CreateOr(Lhs, Rhs);
+}
+
+Value *SPMDBuilder::createNot(Value *Val) {
+  if (Val->getType()->isIntegerTy(1))
+    return Builder.CreateNot(Val);
+
+  return Builder.CreateXor(Val, 0xffff);
 }
 
 BasicBlock *SPMDBuilder::createBasicBlock(const char *name) {
@@ -296,14 +694,163 @@ BasicBlock *SPMDBuilder::createBasicBlock(const char *name) {
 
 void SPMDBuilder::startBasicBlock(BasicBlock *BB) {
   // Add a branch at the end of the last block if needed
-  if (Builder.GetInsertBlock() && !Builder.GetInsertBlock()->empty()
-    && !std::prev(Builder.GetInsertPoint())->isTerminator())
+  if (Builder.GetInsertBlock() && !Builder.GetInsertBlock()->getTerminator())
     Builder.CreateBr(BB);
 
   Builder.SetInsertPoint(BB);
 }
 
-Value *SPMDBuilder::createConstant(float Value) {
-  return Builder.CreateVectorSplat(
-      16, ConstantFP::get(Context, APFloat(Value)), "const");
+Value *SPMDBuilder::createConstant(double Value, ValueType Type) {
+  // Constants are uniform. They are splatted when combined with a varying
+  // value.
+  switch (Type) {
+  case ValueType::Float:
+    return ConstantFP::get(Builder.getFloatTy(), Value);
+  case ValueType::Int:
+  case ValueType::UInt:
+    return Builder.getInt32(static_cast<uint32_t>(static_cast<int64_t>(Value)));
+  case ValueType::Bool:
+    return Builder.getInt1(Value != 0);
+  default:
+    llvm_unreachable("Invalid constant type");
+  }
+}
+
+Value *SPMDBuilder::createProgramIndex() {
+  SmallVector<Constant *, 16> Lanes;
+  for (int Lane = 0; Lane < 16; Lane++)
+    Lanes.push_back(Builder.getInt32(Lane));
+
+  return ConstantVector::get(Lanes);
+}
+
+Value *SPMDBuilder::getActiveMask() {
+  if (ActiveLanes)
+    return ActiveLanes;
+
+  return ConstantInt::get(Type::getInt32Ty(Context), 0xffff);
+}
+
+Value *SPMDBuilder::convertToIndex(Value *Index) {
+  if (!Index->getType()->isFPOrFPVectorTy())
+    return Index;
+
+  Type *IntType = Type::getInt32Ty(Context);
+  if (Index->getType()->isVectorTy())
+    IntType = VectorType::get(IntType, 16);
+
+  return Builder.CreateFPToSI(Index, IntType, "index");
+}
+
+// Compute a vector with the address of element Index[lane] of the array
+// for each lane.
+Value *SPMDBuilder::getElementAddresses(Value *Base, Value *Index) {
+  Value *ByteOffsets = Builder.CreateShl(convertToIndex(Index), 2);
+  Value *BaseAddr = Builder.CreatePtrToInt(Base, Type::getInt32Ty(Context));
+  return Builder.CreateAdd(Builder.CreateVectorSplat(16, BaseAddr),
+                           ByteOffsets, "addrs");
+}
+
+static bool isFloatArray(Value *Base) {
+  return Base->getType()->getPointerElementType()->isFloatTy();
+}
+
+Value *SPMDBuilder::isBlockAligned(Value *Ptr) {
+  Value *Addr = Builder.CreatePtrToInt(Ptr, Type::getInt32Ty(Context));
+  Value *Misalignment = Builder.CreateAnd(Addr, 63);
+  return Builder.CreateICmpEQ(Misalignment, Builder.getInt32(0), "aligned");
+}
+
+Value *SPMDBuilder::createLoad(Value *Base, Value *Index) {
+  if (!Index->getType()->isVectorTy())
+    return Builder.CreateLoad(Builder.CreateGEP(Base, convertToIndex(Index)));
+
+  Function *GatherFunc = Intrinsic::getDeclaration(
+      MainModule, isFloatArray(Base) ? Intrinsic::nyuzi_gather_loadf_masked
+                                     : Intrinsic::nyuzi_gather_loadi_masked);
+  Value *Ops[] = {getElementAddresses(Base, Index), getActiveMask()};
+  return Builder.CreateCall(GatherFunc, Ops);
+}
+
+void SPMDBuilder::createStore(Value *Base, Value *Index, Value *NewValue) {
+  if (!Index->getType()->isVectorTy() && !NewValue->getType()->isVectorTy()) {
+    Builder.CreateStore(NewValue,
+                        Builder.CreateGEP(Base, convertToIndex(Index)));
+    return;
+  }
+
+  Function *ScatterFunc = Intrinsic::getDeclaration(
+      MainModule, isFloatArray(Base)
+                      ? Intrinsic::nyuzi_scatter_storef_masked
+                      : Intrinsic::nyuzi_scatter_storei_masked);
+  Value *Ops[] = {getElementAddresses(Base, promoteToVector(Index)),
+                  promoteToVector(NewValue), getActiveMask()};
+  Builder.CreateCall(ScatterFunc, Ops);
+}
+
+Value *SPMDBuilder::createBlockLoad(Value *Base, Value *Offset) {
+  Value *Ptr = Offset ? Builder.CreateGEP(Base, convertToIndex(Offset)) : Base;
+  Value *Mask = getActiveMask();
+  BasicBlock *BlockBB = createBasicBlock("blockload");
+  BasicBlock *GatherBB = createBasicBlock("gatherload");
+  BasicBlock *DoneBB = createBasicBlock("loaddone");
+  Builder.CreateCondBr(isBlockAligned(Ptr), BlockBB, GatherBB);
+
+  startBasicBlock(BlockBB);
+  Function *BlockFunc = Intrinsic::getDeclaration(
+      MainModule, isFloatArray(Base) ? Intrinsic::nyuzi_block_loadf_masked
+                                     : Intrinsic::nyuzi_block_loadi_masked);
+  Type *BlockPtrType =
+      PointerType::getUnqual(VectorType::get(Type::getInt32Ty(Context), 16));
+  Value *BlockOps[] = {Builder.CreateBitCast(Ptr, BlockPtrType), Mask};
+  Value *BlockVal = Builder.CreateCall(BlockFunc, BlockOps);
+  Builder.CreateBr(DoneBB);
+
+  startBasicBlock(GatherBB);
+  Function *GatherFunc = Intrinsic::getDeclaration(
+      MainModule, isFloatArray(Base) ? Intrinsic::nyuzi_gather_loadf_masked
+                                     : Intrinsic::nyuzi_gather_loadi_masked);
+  Value *GatherOps[] = {getElementAddresses(Ptr, createProgramIndex()), Mask};
+  Value *GatherVal = Builder.CreateCall(GatherFunc, GatherOps);
+  Builder.CreateBr(DoneBB);
+
+  startBasicBlock(DoneBB);
+  PHINode *Result = Builder.CreatePHI(BlockVal->getType(), 2);
+  Result->addIncoming(BlockVal, BlockBB);
+  Result->addIncoming(GatherVal, GatherBB);
+  return Result;
+}
+
+void SPMDBuilder::createBlockStore(Value *Base, Value *Offset,
+                                   Value *NewValue) {
+  Value *Ptr = Offset ? Builder.CreateGEP(Base, convertToIndex(Offset)) : Base;
+  Value *Mask = getActiveMask();
+  NewValue = promoteToVector(NewValue);
+  BasicBlock *BlockBB = createBasicBlock("blockstore");
+  BasicBlock *ScatterBB = createBasicBlock("scatterstore");
+  BasicBlock *DoneBB = createBasicBlock("storedone");
+  Builder.CreateCondBr(isBlockAligned(Ptr), BlockBB, ScatterBB);
+
+  startBasicBlock(BlockBB);
+  Function *BlockFunc = Intrinsic::getDeclaration(
+      MainModule, isFloatArray(Base) ? Intrinsic::nyuzi_block_storef_masked
+                                     : Intrinsic::nyuzi_block_storei_masked);
+  Type *BlockPtrType =
+      PointerType::getUnqual(VectorType::get(Type::getInt32Ty(Context), 16));
+  Value *BlockOps[] = {Builder.CreateBitCast(Ptr, BlockPtrType), NewValue,
+                       Mask};
+  Builder.CreateCall(BlockFunc, BlockOps);
+  Builder.CreateBr(DoneBB);
+
+  startBasicBlock(ScatterBB);
+  Function *ScatterFunc = Intrinsic::getDeclaration(
+      MainModule, isFloatArray(Base)
+                      ? Intrinsic::nyuzi_scatter_storef_masked
+                      : Intrinsic::nyuzi_scatter_storei_masked);
+  Value *ScatterOps[] = {getElementAddresses(Ptr, createProgramIndex()),
+                         NewValue, Mask};
+  Builder.CreateCall(ScatterFunc, ScatterOps);
+  Builder.CreateBr(DoneBB);
+
+  startBasicBlock(DoneBB);
 }
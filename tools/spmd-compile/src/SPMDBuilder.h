@@ -1,6 +1,7 @@
 #ifndef __SPMD_BUILDER_H
 #define __SPMD_BUILDER_H
 
+#include "Symbol.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Module.h"
 
@@ -8,21 +9,51 @@ class SPMDBuilder {
 public:
   SPMDBuilder(llvm::Module *Mod, llvm::LLVMContext &Context);
   ~SPMDBuilder();
-  void startFunction(const char *name,
-                     const std::vector<std::string> &ArgNames);
+  /// Each function is generated twice: an exported version that runs with
+  /// all lanes enabled, and an internal masked version for calls from SPMD
+  /// code, which takes the caller's active mask as a hidden first argument.
+  llvm::Function *startFunction(const char *name, ValueType ReturnType,
+                                const std::vector<Symbol *> &Args,
+                                bool IsMasked);
   void endFunction();
   llvm::Function::arg_iterator getFuncArguments();
 
   void createReturn(llvm::Value *ReturnValue);
-
-  llvm::Value *createLocalVariable(const char *Name, llvm::Type*);
+  ValueType getReturnType() const { return ReturnType; }
+
+  /// Start a foreach loop over [Start, End). The range is split into chunks
+  /// of 16. Each hardware thread starts with the chunk matching its thread
+  /// ID, then takes more from a shared atomic counter until they run out.
+  /// This expects exactly as many threads as the -threads option, and traps
+  /// if the thread ID is out of range. No thread leaves the loop until all
+  /// have finished. Each iteration stores the index of lane 0 to BasePtr and
+  /// the index of every lane to IndexPtr, and masks off lanes past the end of
+  /// the range.
+  void startForeach(llvm::Value *Start, llvm::Value *End,
+                    llvm::Value *IndexPtr, llvm::Value *BasePtr);
+  void endForeach();
+
+  /// Call the masked version of a function, passing the current active mask.
+  llvm::Value *createCall(FunctionDef *Func,
+                          llvm::ArrayRef<llvm::Value *> Args);
+
+  /// Return the IR type used to hold a value. Uniform values are scalars,
+  /// varying ones are vectors with a value for each lane (or a mask for
+  /// bool).
+  llvm::Type *getLLVMType(ValueType Type, bool IsUniform);
+
+  llvm::Value *createLocalVariable(const char *Name, ValueType Type,
+                                   bool IsUniform = false);
 
   llvm::Value *readLocalVariable(llvm::Value *);
 
   /// Copy the value of the expression NewValue into the given variable (an
   /// alloca), Applying a mask if one is active.
   llvm::Value *assignLocalVariable(llvm::Value *Variable,
-                                   llvm::Value *NewValue);
+                                   llvm::Value *NewValue, ValueType Type);
+
+  /// Convert between numeric types, with C semantics.
+  llvm::Value *convert(llvm::Value *Val, ValueType From, ValueType To);
 
   /// Save the current mask (if present), and it with the new mask, then cause
   /// the new one to affect all subsequent emitted instructions
@@ -35,28 +66,82 @@ public:
   /// Start the else clause of an if statement
   void invertLastPushedMask();
 
+  /// The mask at the start of a branch or loop on a uniform condition.
+  struct MaskState {
+    llvm::Value *ActiveLanes;
+    unsigned Depth;
+  };
+
+  MaskState saveMaskState() const;
+
+  /// Reset the mask at the start of a block that uniform control flow joins
+  /// (or the start of a uniform else clause), since the mask computed on one
+  /// path doesn't dominate it. If lanes may have returned since the state was
+  /// saved, the mask is rebuilt from the return mask.
+  void restoreMaskState(const MaskState &State, bool LanesMayHaveReturned);
+
   /// Emit a branch to skip the block if no mask bits are set.
   void shortCircuitZeroMask(llvm::BasicBlock *SkipTo, llvm::BasicBlock *Next);
 
   void branch(llvm::BasicBlock *Dest);
 
+  /// Branch on a uniform (scalar) condition.
+  void conditionalBranch(llvm::Value *Cond, llvm::BasicBlock *True,
+                         llvm::BasicBlock *False);
+
   llvm::Value *createCompare(llvm::CmpInst::Predicate type, llvm::Value *lhs,
                              llvm::Value *rhs);
 
   llvm::Value *createSub(llvm::Value *lhs, llvm::Value *rhs);
   llvm::Value *createAdd(llvm::Value *lhs, llvm::Value *rhs);
   llvm::Value *createMul(llvm::Value *lhs, llvm::Value *rhs);
-  llvm::Value *createDiv(llvm::Value *lhs, llvm::Value *rhs);
+  llvm::Value *createDiv(llvm::Value *lhs, llvm::Value *rhs, ValueType Type);
+
+  /// Logical operations on bools.
+  llvm::Value *createAnd(llvm::Value *lhs, llvm::Value *rhs);
+  llvm::Value *createOr(llvm::Value *lhs, llvm::Value *rhs);
+  llvm::Value *createNot(llvm::Value *Val);
 
   llvm::BasicBlock *createBasicBlock(const char *Name);
 
   void startBasicBlock(llvm::BasicBlock *Block);
 
-  llvm::Value *createConstant(float value);
+  llvm::Value *createConstant(double Value, ValueType Type);
+
+  /// Return a vector with the lane number in each lane.
+  llvm::Value *createProgramIndex();
 
-  llvm::Type *sFloatType;
+  /// Read Base[Index]. A uniform index does a scalar load, otherwise the
+  /// active lanes are gathered.
+  llvm::Value *createLoad(llvm::Value *Base, llvm::Value *Index);
+  void createStore(llvm::Value *Base, llvm::Value *Index,
+                   llvm::Value *NewValue);
+
+  /// Access Base[programIndex + Offset], where Offset is uniform (or null
+  /// for no offset). This uses a block load/store if the address is vector
+  /// aligned, and falls back to gather/scatter if it isn't.
+  llvm::Value *createBlockLoad(llvm::Value *Base, llvm::Value *Offset);
+  void createBlockStore(llvm::Value *Base, llvm::Value *Offset,
+                        llvm::Value *NewValue);
 
 private:
+  /// Splat a scalar to all lanes if the other operand is a vector.
+  llvm::Value *promoteToVector(llvm::Value *Val);
+  void matchOperands(llvm::Value *&Lhs, llvm::Value *&Rhs);
+
+  /// Convert a uniform bool to a mask with all lanes set to its value.
+  llvm::Value *promoteToMask(llvm::Value *Val);
+
+  /// Mask of lanes that are active, all of them if not in conditional code.
+  llvm::Value *getActiveMask();
+  llvm::Value *convertToIndex(llvm::Value *Index);
+  llvm::Value *getElementAddresses(llvm::Value *Base, llvm::Value *Index);
+  llvm::Value *isBlockAligned(llvm::Value *Ptr);
+  void emitRet();
+
+  /// Masked functions with at most this many instructions are always inlined.
+  static const unsigned kMaxInlineSize = 100;
+
   struct MaskStackEntry {
     // These entries point to the allocas that store the values.
     llvm::Value *ThisMask;
@@ -71,7 +156,18 @@ private:
   llvm::Function *CurrentFunction;
   llvm::Value *ReturnValuePtr;
   llvm::Value *ReturnMaskPtr;
+  ValueType ReturnType;
+  bool IsMaskedFunction;
+
+  // State for the foreach loop being generated. These can't be nested.
+  llvm::BasicBlock *ForeachTopBB = nullptr;
+  llvm::BasicBlock *ForeachDoneBB = nullptr;
+  llvm::Value *ForeachChunkPtr;
+  llvm::GlobalVariable *ForeachNextChunk;
+  llvm::GlobalVariable *ForeachFinished;
+  llvm::GlobalVariable *ForeachGeneration;
   llvm::Function *VMixFInt;
+  llvm::Function *VMixIInt;
 };
 
 #endif
@@ -9,8 +9,12 @@
 %%
 
 \/\/[^\n]*					{	/* Skip Comments */ }
-[0-9]*					{
-							yylval.numVal = atoi(yytext);
+[0-9]+\.[0-9]+			{
+							yylval.numVal = atof(yytext);
+							return TOK_FLOAT_NUMBER;
+						}
+[0-9]+					{
+							yylval.intVal = strtoul(yytext, nullptr, 10);
 							return TOK_NUMBER;
 						}
 
@@ -31,17 +35,28 @@
 
 "++"                    { return TOK_INCR; }
 "--"                    { return TOK_DECR; }
+".."					{ return TOK_RANGE; }
 
 [\.\+\-\/\*/=\%()><:;,\[\]\{\}\!\&\~\!]	{	return yytext[0];	}
 
 
 float 					{ return TOK_FLOAT; }
+int						{ return TOK_INT; }
+uint					{ return TOK_UINT; }
+bool					{ return TOK_BOOL; }
+void					{ return TOK_VOID; }
+struct					{ return TOK_STRUCT; }
+true					{ return TOK_TRUE; }
+false					{ return TOK_FALSE; }
 if						{ return TOK_IF; }
 else					{ return TOK_ELSE; }
 end						{ return TOK_END; }
 for                     { return TOK_FOR; }
+foreach					{ return TOK_FOREACH; }
+in						{ return TOK_IN; }
 while					{ return TOK_WHILE; }
 return					{ return TOK_RETURN; }
+programIndex			{ return TOK_PROGRAM_INDEX; }
 
 [A-Za-z_][A-Za-z_0-9]*	{
 							strcpy( yylval.strval, yytext );
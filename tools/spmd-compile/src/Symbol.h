@@ -3,10 +3,56 @@
 
 #include "llvm/IR/IRBuilder.h"
 #include <string>
+#include <vector>
+
+// Element type of a value. Varying values are 16 element vectors of these,
+// except bool, which is a lane mask (an i32 with one bit per lane).
+enum class ValueType { Void, Float, Int, UInt, Bool };
+
+class AstNode;
+
+struct StructDef {
+  std::string Name;
+  std::vector<std::pair<std::string, ValueType>> Fields;
+};
 
 struct Symbol {
-  llvm::Value *Val;
+  llvm::Value *Val = nullptr;
   std::string Name;
+  ValueType Type = ValueType::Float;
+
+  // True if this variable has the same value in every lane, in which case it
+  // is stored in a scalar register. Set by AstNode::markVaryingVariables.
+  bool IsUniform = true;
+
+  // Array parameter. Val is the (uniform) base address and Type is the
+  // element type.
+  bool IsPointer = false;
+
+  // Struct variables don't have storage themselves. Each field is a separate
+  // variable, in the same order as Struct->Fields.
+  StructDef *Struct = nullptr;
+  std::vector<Symbol *> Fields;
+
+  // For a foreach loop variable, an expression for the uniform index in
+  // lane 0. Lane N is always this plus N, so accesses indexed by the loop
+  // variable are contiguous. The variable can't be assigned.
+  AstNode *ForeachBase = nullptr;
+};
+
+struct FunctionDef {
+  std::string Name;
+  ValueType ReturnType;
+
+  // Parameters as declared.
+  std::vector<Symbol *> Params;
+
+  // One per IR argument. Struct parameters are expanded into their fields.
+  std::vector<Symbol *> ArgSyms;
+
+  // The version of the function that is called from SPMD code. It takes the
+  // caller's active mask as a hidden first argument.
+  llvm::Function *MaskedFunc = nullptr;
 };
 
 #endif
@@ -2,6 +2,7 @@
 #include "SPMDBuilder.h"
 #include "llvm/ADT/Triple.h"
 #include "llvm/Analysis/Passes.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
 #include "llvm/CodeGen/CommandFlags.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/IR/DataLayout.h"
@@ -21,6 +22,7 @@
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/IPO/AlwaysInliner.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
 #include "llvm/Transforms/Scalar.h"
 #include <cctype>
@@ -66,7 +68,11 @@ bool generateTargetCode(Module *TheModule, raw_fd_ostream &Output) {
   TargetMachine &Target = *target.get();
   TheModule->setDataLayout(Target.createDataLayout());
 
+  // The optimization passes would otherwise use the default cost model.
+  PM.add(createTargetTransformInfoWrapperPass(Target.getTargetIRAnalysis()));
+
   PassManagerBuilder PMBuilder;
+  PMBuilder.Inliner = createAlwaysInlinerLegacyPass();
   PMBuilder.populateModulePassManager(PM);
 
   TargetMachine::CodeGenFileType FileType = OutputSource
@@ -104,6 +110,9 @@ int main(int argc, const char *argv[]) {
   if (!parse(TheModule, TheContext))
     return 1;
 
+  if (verifyModule(*TheModule, &errs()))
+    return 1;
+
   if (OutputOption == "")
   {
     OutputPath = InputFilename;
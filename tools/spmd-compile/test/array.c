@@ -0,0 +1,20 @@
+// RUN: spmd-compile %s -o - -S | FileCheck %s
+
+// Consecutive lanes access consecutive elements, so this uses block
+// loads and stores when the address is aligned and gather/scatter when it
+// isn't. The index into 'lut' is arbitrary, so it is always a gather.
+
+float f(float *src, float lut[], float *dest, float index)
+{
+    float i;
+
+    // CHECK-DAG: load_v_mask
+    // CHECK-DAG: load_gath_mask
+    // CHECK-DAG: store_v_mask
+    // CHECK-DAG: store_scat_mask
+    for (i = 0; i < 64; i = i + 16)
+        dest[programIndex + i] = lut[index] * src[programIndex + i];
+
+    return 0;
+}
+
@@ -0,0 +1,32 @@
+// RUN: spmd-compile %s -o - -S | FileCheck %s
+
+// Calls pass the caller's active mask to the callee, which only updates the
+// lanes that were active. Small functions are inlined.
+
+float clamp(float value, float max)
+{
+    if (value > max)
+        return max;
+
+    return value;
+}
+
+// CHECK-LABEL: f:
+float f(float a, float b)
+{
+    float result = 0;
+
+    // CHECK: cmpgt_f [[CALLERMASK:s[0-9]+]], v0, v1
+    // CHECK-NOT: call
+    if (a > b)
+        result = clamp(a - b, 1);
+
+    // The inlined body only returns in lanes that were active in the caller.
+    // CHECK: cmpgt_f [[CALLEEMASK:s[0-9]+]]
+    // CHECK: and [[COMBINED:s[0-9]+]], [[CALLEEMASK]], [[CALLERMASK]]
+    // CHECK: move_mask v{{[0-9]+}}, [[COMBINED]], v{{[0-9]+}}
+    // CHECK-NOT: call
+    // CHECK: ret
+    return result;
+}
+
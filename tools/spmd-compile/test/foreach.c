@@ -0,0 +1,19 @@
+// RUN: spmd-compile %s -o - -S | FileCheck %s
+
+// Each thread starts with the chunk of 16 elements matching its thread ID,
+// then takes more from a shared counter, and waits for the others at the end
+// of the loop. The loop variable is contiguous across lanes, so 'data[i]'
+// uses block loads and stores when aligned.
+
+void scale(float *data, int count, float factor)
+{
+    // CHECK-DAG: getcr s{{[0-9]+}}, 0
+    // CHECK-DAG: call abort
+    // CHECK-DAG: load_v_mask
+    // CHECK-DAG: store_v_mask
+    // CHECK-DAG: load_sync
+    // CHECK-DAG: store_sync
+    // CHECK-DAG: membar
+    foreach (i in 0..count)
+        data[i] = data[i] * factor;
+}
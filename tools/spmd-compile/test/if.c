@@ -2,20 +2,19 @@
 
 float ifstmt(float a, float b)
 {
-    // CHECK: load_32
+    // The mask of all lanes is built once and shared by the blocks below
+    // CHECK-DAG: move [[ALL:s[0-9]+]], 15
+    // CHECK-DAG: cmpgt_f [[PRED:s[0-9]+]], v0,
+    // CHECK: or [[ALL]], [[ALL]], 4095
 
     float retval = 0;
 	if (a > 0) {
-        // CHECK: cmpgt_f
-        // CHECK: bz s{{[0-9]+}}, [[LABEL1:\.LBB[0-9]_[0-9]+]]
+        // CHECK: bz [[PRED]], [[LABEL1:\.LBB[0-9]_[0-9]+]]
         retval = a - b;
-    	// CHECK: move
-    	// CHECK: sub_f_mask
-    	// CHECK: load_32
-    	// CHECK: and
-    	// CHECK: cmpeq_i
-    	// CHECK: bnz s{{[0-9]+}}, [[LABEL2:\.LBB[0-9]_[0-9]+]]
+    	// CHECK: sub_f_mask {{v[0-9]+}}, [[PRED]]
     	// CHECK: xor
+    	// CHECK: and {{s[0-9]+}}, {{s[0-9]+}}, [[ALL]]
+    	// CHECK: bz s{{[0-9]+}}, [[LABEL2:\.LBB[0-9]_[0-9]+]]
     	// CHECK: b [[LABEL3:\.LBB[0-9]_[0-9]+]]
 	} else {
         // CHECK: [[LABEL1]]
@@ -26,10 +25,9 @@ float ifstmt(float a, float b)
     }
 
     // CHECK: [[LABEL2]]
-    // CHECK: load_32
-    // CHECK: move_mask
+    // CHECK-NOT: shl
+    // CHECK: move_mask {{v[0-9]+}}, [[ALL]]
     // CHECK: ret
 
     return retval;
 }
-
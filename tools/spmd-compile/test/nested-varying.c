@@ -0,0 +1,75 @@
+// RUN: spmd-compile %s -emit-llvm -o - | FileCheck %s
+
+// Varying if statements nested in uniform control flow. The mask computed
+// inside doesn't dominate the code after the uniform branch or loop, so it
+// is reset there. Only a varying return changes it for the code that
+// follows.
+
+float loop_if(float a)
+{
+    float x = 0;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        if (a > 1)
+            x = x + 1;
+    }
+
+    x = x + a;
+    return x;
+}
+
+// CHECK-LABEL: define <16 x float> @loop_if(
+// CHECK: loopend:
+// CHECK-NEXT: load
+// CHECK-NEXT: load
+// CHECK-NEXT: fadd
+// CHECK-NEXT: store
+
+float loop_return(float a)
+{
+    float x = 0;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        if (a > 1)
+            x = x + 1;
+
+        if (a > i)
+            return x;
+    }
+
+    x = x + a;
+    return x;
+}
+
+// Lanes that returned stay off on the next iteration and after the loop.
+// CHECK-LABEL: define <16 x float> @loop_return(
+// CHECK: looptop:
+// CHECK-NEXT: [[TOPMASK:%[0-9]+]] = load i32, i32* %return_mask
+// CHECK: %pred = call i32 @llvm.nyuzi.__builtin_nyuzi_mask_cmpf_gt
+// CHECK-NEXT: and i32 %pred, [[TOPMASK]]
+// CHECK: loopend:
+// CHECK-NEXT: [[ENDMASK:%[0-9]+]] = load i32, i32* %return_mask
+// CHECK: call <16 x float> @llvm.nyuzi.__builtin_nyuzi_vector_mixf(i32 [[ENDMASK]]
+
+float if_if(float a)
+{
+    float x = 0;
+    int n = 3;
+
+    if (n > 0) {
+        if (a > 1)
+            x = 1;
+    }
+
+    x = x + a;
+    return x;
+}
+
+// CHECK-LABEL: define <16 x float> @if_if(
+// CHECK: endif:
+// CHECK-NEXT: load
+// CHECK-NEXT: load
+// CHECK-NEXT: fadd
+// CHECK-NEXT: store
@@ -21,40 +21,26 @@ float nestedif(float a, float b)
     return retval;
 }
 
-// CHECK: 	cmpgt_f
-// CHECK: 	bz s{{[0-9]+}}, [[LABEL1:\.LBB[0-9]_[0-9]+]]
-// CHECK: 	cmpgt_f
-// CHECK: 	and
-// CHECK: 	bz s{{[0-9]+}}, [[LABEL3:\.LBB[0-9]_[0-9]+]]
-// CHECK: 	move
-// CHECK: 	sub_f_mask
-// CHECK: 	b [[LABEL11:\.LBB[0-9]_[0-9]+]]
+// The inner if statements are converted to predicated instructions, so only
+// the outer one branches.
+// CHECK: cmpgt_f [[OUTER:s[0-9]+]], v0, v1
+// CHECK: bz [[OUTER]], [[LABEL1:\.LBB[0-9]_[0-9]+]]
+// CHECK: cmpgt_f
+// CHECK-NOT: bz
+// CHECK-NOT: bnz
+// CHECK: sub_f_mask {{v[0-9]+}}, {{s[0-9]+}}, v0, v1
+// CHECK-NOT: bz
+// CHECK-NOT: bnz
+// CHECK: move_mask {{v[0-9]+}}, {{s[0-9]+}}, v1
+// CHECK: bz s{{[0-9]+}}, [[LABEL4:\.LBB[0-9]_[0-9]+]]
 // CHECK: [[LABEL1]]:
-// CHECK: 	move
-// CHECK: 	b [[LABEL5:\.LBB[0-9]_[0-9]+]]
-// CHECK: [[LABEL3]]:
-// CHECK: 	move
-// CHECK: [[LABEL11]]:
-// CHECK: 	xor
-// CHECK: 	and
-// CHECK: 	and
-// CHECK: 	bz s{{[0-9]+}}, [[LABEL4:\.LBB[0-9]_[0-9]+]]
-// CHECK: 	move_mask
+// CHECK: cmpgt_f
+// CHECK-NOT: bz
+// CHECK-NOT: bnz
+// CHECK: sub_f_mask {{v[0-9]+}}, {{s[0-9]+}}, v1, v0
+// CHECK-NOT: bz
+// CHECK-NOT: bnz
+// CHECK: move_mask {{v[0-9]+}}, {{s[0-9]+}}, v0
 // CHECK: [[LABEL4]]:
-// CHECK: 	xor
-// CHECK: 	bz s{{[0-9]+}}, [[LABEL9:\.LBB[0-9]_[0-9]+]]
-// CHECK: [[LABEL5]]:
-// CHECK: 	cmpgt_f
-// CHECK: 	and
-// CHECK: 	bz s{{[0-9]+}}, [[LABEL7:\.LBB[0-9]_[0-9]+]]
-// CHECK: 	sub_f_mask
-// CHECK: [[LABEL7]]:
-// CHECK: 	xor
-// CHECK: 	and
-// CHECK: 	bz s{{[0-9]+}}, [[LABEL9]]
-// CHECK: 	move_mask
-// CHECK: [[LABEL9]]:
-// CHECK: 	move_mask
-// CHECK: 	ret
-
-
+// CHECK: move_mask v0,
+// CHECK: ret
@@ -10,8 +10,8 @@ float returnstmt(float a, float count)
         return a;
 
         // CHECK: move_mask
-    	// CHECK: load_32
-    	// CHECK: and
+    	// CHECK: or [[ALL:s[0-9]+]], [[ALL]], 4095
+    	// CHECK: and {{s[0-9]+}}, {{s[0-9]+}}, [[ALL]]
     	// CHECK: cmpeq_i
     	// CHECK: bnz s{{[0-9]+}}, [[LABEL2:\.LBB[0-9]_[0-9]+]]
         // CHECK: xor
@@ -22,7 +22,6 @@ float returnstmt(float a, float count)
 
     return count + 1;
     // CHECK: [[LABEL3]]
-    // CHECK: load_32
     // CHECK: add_f_mask
     // CHECK: [[LABEL2]]
     // CHECK: ret
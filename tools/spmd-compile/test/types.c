@@ -0,0 +1,28 @@
+// RUN: spmd-compile %s -o - -S | FileCheck %s
+
+// Integer math and indexing use integer vector instructions directly, with
+// no conversions to and from float.
+
+struct Point {
+    int x;
+    int y;
+};
+
+int f(struct Point p, int *data, uint limit)
+{
+    int sum = 0;
+    bool inside = p.x > 0 && p.y > 0;
+
+    // CHECK-NOT: itof
+    // CHECK-NOT: ftoi
+    // CHECK-DAG: cmpgt_i
+    // CHECK-DAG: cmpgt_u
+    // CHECK-DAG: load_gath_mask
+    // CHECK-DAG: mull_i
+    if (inside && limit > 4)
+        sum = data[p.x + p.y] * p.x;
+
+    // CHECK: ret
+    return sum;
+}
+
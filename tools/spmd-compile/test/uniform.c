@@ -0,0 +1,22 @@
+// RUN: spmd-compile %s -o - -S | FileCheck %s
+
+// The loop counter only depends on constants, so the loop is scalar and
+// doesn't need to update the mask.
+
+float f(float a)
+{
+    int i;
+    float product = 1;
+
+    // CHECK-NOT: _mask
+    for (i = 0; i < 1000; i++) {
+        product = product * a;
+        // CHECK: mul_f v{{[0-9]+}}, v{{[0-9]+}}, v{{[0-9]+}}
+        // CHECK: cmplt_i s{{[0-9]+}}, s{{[0-9]+}},
+    }
+
+    // CHECK-NOT: _mask
+    return product;
+    // CHECK: ret
+}
+